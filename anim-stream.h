@@ -0,0 +1,690 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ANIM_STREAM_H
+#define ANIM_STREAM_H
+
+/*
+ * The binary animation trace: what AnimationInterface writes as NetAnim
+ * XML, as compact records.
+ *
+ *     AnimStreamHeader, once
+ *     records, one after the other
+ *
+ * A record is its type (one byte, AnimRecordType), then for the updates
+ * the time since the previous record, then its fields in the order of the
+ * AnimRecordType comments:
+ *
+ *     ids, counts    unsigned LEB128 varint
+ *     times          zigzag varint, in nanoseconds; the packet times are
+ *                    relative to the time of their record
+ *     coordinates    double, 8 bytes, host byte order
+ *     colors         3 bytes
+ *     strings        varint id in the string table, 0 for ""
+ *
+ * Every string is written once, in an ANIM_STRING record just before the
+ * first record that uses it, and gets the next id; an ANIM_STRING_RESET
+ * empties the table (the writer does it when the table is full, so a run
+ * full of distinct packet prints does not grow it forever).
+ *
+ * AnimStreamWriter writes it through an AsyncTraceFile, so a ".gz" file is
+ * compressed by the I/O thread as it goes.  BinaryAnimation
+ * (binary-animation.h) feeds it from a simulation, AnimStreamReader
+ * (trace-reader.h) reads it and tools/anim-to-xml turns it back into the
+ * XML NetAnim loads.
+ *
+ * This file does not depend on ns-3; its ".gz" files need zlib (see trace-io.h).
+ */
+
+#include "trace-io.h"
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum AnimRecordType
+{
+  ANIM_STRING = 1,              //!< length, bytes: the next string id
+  ANIM_STRING_RESET = 2,        //!< the string table starts over
+  /* declarations, no time */
+  ANIM_NODE = 3,                //!< node, sysId, x, y
+  ANIM_LINK = 4,                //!< from, to, fromDescription, toDescription, description (point-to-point)
+  ANIM_NONP2P_LINK = 5,         //!< node, address ("ip~mac"), channelType
+  ANIM_RESOURCE = 6,            //!< resource, path
+  ANIM_COUNTER = 7,             //!< counter, name, counterType (one byte, AnimCounterType)
+  /* updates */
+  ANIM_POSITION = 8,            //!< node, x, y
+  ANIM_COLOR = 9,               //!< node, r, g, b
+  ANIM_SIZE = 10,               //!< node, width, height
+  ANIM_DESCRIPTION = 11,        //!< node, description
+  ANIM_IMAGE = 12,              //!< node, resource
+  ANIM_COUNTER_VALUE = 13,      //!< counter, node, value
+  ANIM_LINK_DESCRIPTION = 14,   //!< from, to, description
+  ANIM_PACKET = 15,             //!< from, to, fbTx, lbTx, fbRx, lbRx, meta (wired, one per receiver)
+  ANIM_WIFI_TX = 16,            //!< uid, from, fbTx, meta
+  ANIM_WIFI_RX = 17,            //!< uid, to, fbRx
+  ANIM_MOTION = 18,             //!< node, x, y, vx, vy: a position the node moves on from
+  ANIM_NODE_UPDATE = 19,        //!< node, fields (one byte, AnimNodeField bits), then those present
+  ANIM_DESCRIPTIONS = 20,       //!< description, count, nodes: the same description for each node
+  ANIM_LINK_DESCRIPTIONS = 21   //!< description, count, from and to of each link: the same for each
+};
+
+/**
+ * The fields of an ANIM_NODE_UPDATE, in the order they follow it:
+ * several changes to a node at the same time, in one record.
+ */
+enum AnimNodeField
+{
+  ANIM_FIELD_COLOR = 1,         //!< r, g, b
+  ANIM_FIELD_SIZE = 2,          //!< width, height
+  ANIM_FIELD_DESCRIPTION = 4,   //!< description
+  ANIM_FIELD_IMAGE = 8,         //!< resource
+  ANIM_FIELD_COUNTERS = 16      //!< count, then counter and value for each
+};
+
+enum AnimCounterType
+{
+  ANIM_COUNTER_UINT32 = 0,
+  ANIM_COUNTER_DOUBLE = 1
+};
+
+static const uint32_t ANIM_STREAM_VERSION = 1;
+
+struct AnimStreamHeader
+{
+  char magic[8];                //!< "NS3ANIM\0"
+  uint32_t version;             //!< ANIM_STREAM_VERSION
+  uint32_t reserved;
+};
+
+/**
+ * \brief One record of the binary animation trace, decoded.
+ *
+ * Only the fields of its type are set; the strings are resolved.
+ */
+struct AnimRecord
+{
+  uint8_t type;                 //!< one of AnimRecordType, never ANIM_STRING*
+  int64_t timeNs;               //!< the time of the record; of the last update for declarations
+  uint32_t id;                  //!< node, from, resource or counter
+  uint32_t to;                  //!< to, sysId, resource of ANIM_IMAGE, node of ANIM_COUNTER_VALUE
+  uint64_t uid;                 //!< the animation uid of a wifi packet
+  double x;                     //!< x, width, counter value
+  double y;                     //!< y, height
+  double vx, vy;                //!< the velocity of ANIM_MOTION, in m/s
+  uint8_t r, g, b;
+  uint8_t counterType;
+  int64_t fbTx, lbTx, fbRx, lbRx;
+  std::string text;             //!< description, meta, path, name, address, fromDescription
+  std::string text2;            //!< channelType, toDescription
+  std::string text3;            //!< the description of ANIM_LINK
+};
+
+/**
+ * \brief The changes to one node at one time, for AnimStreamWriter::NodeUpdate ().
+ */
+struct AnimNodeUpdate
+{
+  AnimNodeUpdate ();
+  /// Sets value as the new value of counter, replacing an earlier one.
+  void SetCounter (uint32_t counter, double value);
+
+  uint8_t fields;               //!< AnimNodeField bits
+  uint8_t r, g, b;
+  double width, height;
+  std::string description;
+  uint32_t image;
+  std::vector<std::pair<uint32_t, double> > counters;  //!< counter and value
+};
+
+/**
+ * \brief Writes the binary animation trace through the trace I/O thread.
+ *
+ * The updates must come in time order (the simulation's); the
+ * declarations may come at any time.
+ */
+class AnimStreamWriter
+{
+public:
+  AnimStreamWriter ();
+
+  bool Open (std::string filename, TraceIoThread *io);
+  bool IsOpen (void) const;
+  /// Strings kept in the table before it is reset, at least 3; 65536 by default.
+  void SetMaxStrings (uint32_t maxStrings);
+
+  void Node (uint32_t node, uint32_t sysId, double x, double y);
+  void Link (uint32_t from, uint32_t to, const std::string &fromDescription,
+             const std::string &toDescription, const std::string &description);
+  void NonP2pLink (uint32_t node, const std::string &address, const std::string &channelType);
+  void Resource (uint32_t resource, const std::string &path);
+  void Counter (uint32_t counter, const std::string &name, uint8_t counterType);
+
+  void Position (int64_t timeNs, uint32_t node, double x, double y);
+  /// A position the node moves on from at velocity (vx, vy), until its next one.
+  void Motion (int64_t timeNs, uint32_t node, double x, double y, double vx, double vy);
+  void Color (int64_t timeNs, uint32_t node, uint8_t r, uint8_t g, uint8_t b);
+  void Size (int64_t timeNs, uint32_t node, double width, double height);
+  void Description (int64_t timeNs, uint32_t node, const std::string &description);
+  void Image (int64_t timeNs, uint32_t node, uint32_t resource);
+  void CounterValue (int64_t timeNs, uint32_t counter, uint32_t node, double value);
+  void LinkDescription (int64_t timeNs, uint32_t from, uint32_t to, const std::string &description);
+  /// A wired packet as one receiver got it; meta is "" without packet metadata.
+  void Packet (int64_t timeNs, uint32_t from, uint32_t to, int64_t fbTx, int64_t lbTx,
+               int64_t fbRx, int64_t lbRx, const std::string &meta);
+  void WifiTx (int64_t timeNs, uint64_t uid, uint32_t from, int64_t fbTx, const std::string &meta);
+  void WifiRx (int64_t timeNs, uint64_t uid, uint32_t to, int64_t fbRx);
+  /// The changes to a node at a time: an ANIM_NODE_UPDATE, or the record of the one change.
+  void NodeUpdate (int64_t timeNs, uint32_t node, const AnimNodeUpdate &update);
+  /// The same description for several nodes, in one record.
+  void Descriptions (int64_t timeNs, const std::vector<uint32_t> &nodes, const std::string &description);
+  /// The same description for several links, (from, to), in one record.
+  void LinkDescriptions (int64_t timeNs, const std::vector<std::pair<uint32_t, uint32_t> > &links,
+                         const std::string &description);
+
+  void Flush (void);
+  void Close (void);
+  /// Bytes written so far, before compression.
+  uint64_t GetOffset (void) const;
+
+private:
+  /// Reset the table unless it can take strings more strings.
+  void MakeRoom (uint32_t strings);
+  /// The id of s, writing it first if it is not in the table; MakeRoom () first.
+  uint64_t Intern (const std::string &s);
+  void Begin (uint8_t type);
+  void BeginUpdate (uint8_t type, int64_t timeNs);
+  void PutVarint (uint64_t value);
+  void PutSigned (int64_t value);
+  void PutDouble (double value);
+  void End (void);
+
+  AsyncTraceFile m_file;
+  std::unordered_map<std::string, uint32_t> m_strings;
+  uint32_t m_maxStrings;
+  int64_t m_lastTime;
+  std::vector<uint8_t> m_record;
+};
+
+/// Zigzag: small magnitudes, either sign, give small varints.
+inline uint64_t
+AnimZigzag (int64_t value)
+{
+  return (uint64_t (value) << 1) ^ uint64_t (value >> 63);
+}
+
+inline int64_t
+AnimUnzigzag (uint64_t value)
+{
+  return int64_t (value >> 1) ^ -int64_t (value & 1);
+}
+
+
+inline
+AnimNodeUpdate::AnimNodeUpdate ()
+  : fields (0),
+    r (0), g (0), b (0),
+    width (0), height (0),
+    image (0)
+{
+}
+
+inline void
+AnimNodeUpdate::SetCounter (uint32_t counter, double value)
+{
+  fields |= ANIM_FIELD_COUNTERS;
+  for (std::vector<std::pair<uint32_t, double> >::iterator i = counters.begin (); i != counters.end (); ++i)
+    {
+      if (i->first == counter)
+        {
+          i->second = value;
+          return;
+        }
+    }
+  counters.push_back (std::make_pair (counter, value));
+}
+
+inline
+AnimStreamWriter::AnimStreamWriter ()
+  : m_maxStrings (65536),
+    m_lastTime (0)
+{
+}
+
+inline bool
+AnimStreamWriter::Open (std::string filename, TraceIoThread *io)
+{
+  if (!m_file.Open (filename, io))
+    {
+      return false;
+    }
+  m_strings.clear ();
+  m_lastTime = 0;
+  AnimStreamHeader header;
+  std::memset (&header, 0, sizeof (header));
+  std::memcpy (header.magic, "NS3ANIM", 8);
+  header.version = ANIM_STREAM_VERSION;
+  m_file.Write (&header, sizeof (header));
+  return true;
+}
+
+inline bool
+AnimStreamWriter::IsOpen (void) const
+{
+  return m_file.IsOpen ();
+}
+
+inline void
+AnimStreamWriter::SetMaxStrings (uint32_t maxStrings)
+{
+  m_maxStrings = maxStrings > 3 ? maxStrings : 3;
+}
+
+inline void
+AnimStreamWriter::MakeRoom (uint32_t strings)
+{
+  if (m_strings.size () + strings > m_maxStrings)
+    {
+      Begin (ANIM_STRING_RESET);
+      End ();
+      m_strings.clear ();
+    }
+}
+
+inline uint64_t
+AnimStreamWriter::Intern (const std::string &s)
+{
+  if (s.empty ())
+    {
+      return 0;
+    }
+  std::unordered_map<std::string, uint32_t>::const_iterator it = m_strings.find (s);
+  if (it != m_strings.end ())
+    {
+      return it->second;
+    }
+  Begin (ANIM_STRING);
+  PutVarint (s.size ());
+  End ();
+  m_file.Write (s.data (), s.size ());
+  uint32_t id = m_strings.size () + 1;
+  m_strings[s] = id;
+  return id;
+}
+
+inline void
+AnimStreamWriter::Begin (uint8_t type)
+{
+  m_record.clear ();
+  m_record.push_back (type);
+}
+
+inline void
+AnimStreamWriter::BeginUpdate (uint8_t type, int64_t timeNs)
+{
+  Begin (type);
+  PutSigned (timeNs - m_lastTime);
+  m_lastTime = timeNs;
+}
+
+inline void
+AnimStreamWriter::PutVarint (uint64_t value)
+{
+  while (value >= 0x80)
+    {
+      m_record.push_back (uint8_t (value | 0x80));
+      value >>= 7;
+    }
+  m_record.push_back (uint8_t (value));
+}
+
+inline void
+AnimStreamWriter::PutSigned (int64_t value)
+{
+  PutVarint (AnimZigzag (value));
+}
+
+inline void
+AnimStreamWriter::PutDouble (double value)
+{
+  uint8_t bytes[sizeof (double)];
+  std::memcpy (bytes, &value, sizeof (double));
+  m_record.insert (m_record.end (), bytes, bytes + sizeof (double));
+}
+
+inline void
+AnimStreamWriter::End (void)
+{
+  m_file.Write (m_record.data (), m_record.size ());
+}
+
+inline void
+AnimStreamWriter::Node (uint32_t node, uint32_t sysId, double x, double y)
+{
+  Begin (ANIM_NODE);
+  PutVarint (node);
+  PutVarint (sysId);
+  PutDouble (x);
+  PutDouble (y);
+  End ();
+}
+
+inline void
+AnimStreamWriter::Link (uint32_t from, uint32_t to, const std::string &fromDescription,
+                        const std::string &toDescription, const std::string &description)
+{
+  MakeRoom (3);
+  uint64_t ids[3] = { Intern (fromDescription), Intern (toDescription), Intern (description) };
+  Begin (ANIM_LINK);
+  PutVarint (from);
+  PutVarint (to);
+  for (int i = 0; i < 3; i++)
+    {
+      PutVarint (ids[i]);
+    }
+  End ();
+}
+
+inline void
+AnimStreamWriter::NonP2pLink (uint32_t node, const std::string &address, const std::string &channelType)
+{
+  MakeRoom (2);
+  uint64_t addressId = Intern (address);
+  uint64_t channelId = Intern (channelType);
+  Begin (ANIM_NONP2P_LINK);
+  PutVarint (node);
+  PutVarint (addressId);
+  PutVarint (channelId);
+  End ();
+}
+
+inline void
+AnimStreamWriter::Resource (uint32_t resource, const std::string &path)
+{
+  MakeRoom (1);
+  uint64_t pathId = Intern (path);
+  Begin (ANIM_RESOURCE);
+  PutVarint (resource);
+  PutVarint (pathId);
+  End ();
+}
+
+inline void
+AnimStreamWriter::Counter (uint32_t counter, const std::string &name, uint8_t counterType)
+{
+  MakeRoom (1);
+  uint64_t nameId = Intern (name);
+  Begin (ANIM_COUNTER);
+  PutVarint (counter);
+  PutVarint (nameId);
+  m_record.push_back (counterType);
+  End ();
+}
+
+inline void
+AnimStreamWriter::Position (int64_t timeNs, uint32_t node, double x, double y)
+{
+  BeginUpdate (ANIM_POSITION, timeNs);
+  PutVarint (node);
+  PutDouble (x);
+  PutDouble (y);
+  End ();
+}
+
+inline void
+AnimStreamWriter::Motion (int64_t timeNs, uint32_t node, double x, double y, double vx, double vy)
+{
+  BeginUpdate (ANIM_MOTION, timeNs);
+  PutVarint (node);
+  PutDouble (x);
+  PutDouble (y);
+  PutDouble (vx);
+  PutDouble (vy);
+  End ();
+}
+
+inline void
+AnimStreamWriter::Color (int64_t timeNs, uint32_t node, uint8_t r, uint8_t g, uint8_t b)
+{
+  BeginUpdate (ANIM_COLOR, timeNs);
+  PutVarint (node);
+  m_record.push_back (r);
+  m_record.push_back (g);
+  m_record.push_back (b);
+  End ();
+}
+
+inline void
+AnimStreamWriter::Size (int64_t timeNs, uint32_t node, double width, double height)
+{
+  BeginUpdate (ANIM_SIZE, timeNs);
+  PutVarint (node);
+  PutDouble (width);
+  PutDouble (height);
+  End ();
+}
+
+inline void
+AnimStreamWriter::Description (int64_t timeNs, uint32_t node, const std::string &description)
+{
+  MakeRoom (1);
+  uint64_t descriptionId = Intern (description);
+  BeginUpdate (ANIM_DESCRIPTION, timeNs);
+  PutVarint (node);
+  PutVarint (descriptionId);
+  End ();
+}
+
+inline void
+AnimStreamWriter::Image (int64_t timeNs, uint32_t node, uint32_t resource)
+{
+  BeginUpdate (ANIM_IMAGE, timeNs);
+  PutVarint (node);
+  PutVarint (resource);
+  End ();
+}
+
+inline void
+AnimStreamWriter::CounterValue (int64_t timeNs, uint32_t counter, uint32_t node, double value)
+{
+  BeginUpdate (ANIM_COUNTER_VALUE, timeNs);
+  PutVarint (counter);
+  PutVarint (node);
+  PutDouble (value);
+  End ();
+}
+
+inline void
+AnimStreamWriter::LinkDescription (int64_t timeNs, uint32_t from, uint32_t to, const std::string &description)
+{
+  MakeRoom (1);
+  uint64_t descriptionId = Intern (description);
+  BeginUpdate (ANIM_LINK_DESCRIPTION, timeNs);
+  PutVarint (from);
+  PutVarint (to);
+  PutVarint (descriptionId);
+  End ();
+}
+
+inline void
+AnimStreamWriter::Packet (int64_t timeNs, uint32_t from, uint32_t to, int64_t fbTx, int64_t lbTx,
+                          int64_t fbRx, int64_t lbRx, const std::string &meta)
+{
+  MakeRoom (1);
+  uint64_t metaId = Intern (meta);
+  BeginUpdate (ANIM_PACKET, timeNs);
+  PutVarint (from);
+  PutVarint (to);
+  PutSigned (fbTx - timeNs);
+  PutSigned (lbTx - timeNs);
+  PutSigned (fbRx - timeNs);
+  PutSigned (lbRx - timeNs);
+  PutVarint (metaId);
+  End ();
+}
+
+inline void
+AnimStreamWriter::WifiTx (int64_t timeNs, uint64_t uid, uint32_t from, int64_t fbTx, const std::string &meta)
+{
+  MakeRoom (1);
+  uint64_t metaId = Intern (meta);
+  BeginUpdate (ANIM_WIFI_TX, timeNs);
+  PutVarint (uid);
+  PutVarint (from);
+  PutSigned (fbTx - timeNs);
+  PutVarint (metaId);
+  End ();
+}
+
+inline void
+AnimStreamWriter::WifiRx (int64_t timeNs, uint64_t uid, uint32_t to, int64_t fbRx)
+{
+  BeginUpdate (ANIM_WIFI_RX, timeNs);
+  PutVarint (uid);
+  PutVarint (to);
+  PutSigned (fbRx - timeNs);
+  End ();
+}
+
+inline void
+AnimStreamWriter::NodeUpdate (int64_t timeNs, uint32_t node, const AnimNodeUpdate &update)
+{
+  switch (update.fields)
+    {
+    case 0:
+      return;
+    case ANIM_FIELD_COLOR:
+      Color (timeNs, node, update.r, update.g, update.b);
+      return;
+    case ANIM_FIELD_SIZE:
+      Size (timeNs, node, update.width, update.height);
+      return;
+    case ANIM_FIELD_DESCRIPTION:
+      Description (timeNs, node, update.description);
+      return;
+    case ANIM_FIELD_IMAGE:
+      Image (timeNs, node, update.image);
+      return;
+    case ANIM_FIELD_COUNTERS:
+      if (update.counters.size () == 1)
+        {
+          CounterValue (timeNs, update.counters[0].first, node, update.counters[0].second);
+          return;
+        }
+      break;
+    }
+  MakeRoom (1);
+  uint64_t descriptionId = update.fields & ANIM_FIELD_DESCRIPTION ? Intern (update.description) : 0;
+  BeginUpdate (ANIM_NODE_UPDATE, timeNs);
+  PutVarint (node);
+  m_record.push_back (update.fields);
+  if (update.fields & ANIM_FIELD_COLOR)
+    {
+      m_record.push_back (update.r);
+      m_record.push_back (update.g);
+      m_record.push_back (update.b);
+    }
+  if (update.fields & ANIM_FIELD_SIZE)
+    {
+      PutDouble (update.width);
+      PutDouble (update.height);
+    }
+  if (update.fields & ANIM_FIELD_DESCRIPTION)
+    {
+      PutVarint (descriptionId);
+    }
+  if (update.fields & ANIM_FIELD_IMAGE)
+    {
+      PutVarint (update.image);
+    }
+  if (update.fields & ANIM_FIELD_COUNTERS)
+    {
+      PutVarint (update.counters.size ());
+      for (std::vector<std::pair<uint32_t, double> >::const_iterator i = update.counters.begin ();
+           i != update.counters.end (); ++i)
+        {
+          PutVarint (i->first);
+          PutDouble (i->second);
+        }
+    }
+  End ();
+}
+
+inline void
+AnimStreamWriter::Descriptions (int64_t timeNs, const std::vector<uint32_t> &nodes, const std::string &description)
+{
+  if (nodes.size () == 1)
+    {
+      Description (timeNs, nodes[0], description);
+      return;
+    }
+  MakeRoom (1);
+  uint64_t descriptionId = Intern (description);
+  BeginUpdate (ANIM_DESCRIPTIONS, timeNs);
+  PutVarint (descriptionId);
+  PutVarint (nodes.size ());
+  for (std::vector<uint32_t>::const_iterator i = nodes.begin (); i != nodes.end (); ++i)
+    {
+      PutVarint (*i);
+    }
+  End ();
+}
+
+inline void
+AnimStreamWriter::LinkDescriptions (int64_t timeNs, const std::vector<std::pair<uint32_t, uint32_t> > &links,
+                                    const std::string &description)
+{
+  if (links.size () == 1)
+    {
+      LinkDescription (timeNs, links[0].first, links[0].second, description);
+      return;
+    }
+  MakeRoom (1);
+  uint64_t descriptionId = Intern (description);
+  BeginUpdate (ANIM_LINK_DESCRIPTIONS, timeNs);
+  PutVarint (descriptionId);
+  PutVarint (links.size ());
+  for (std::vector<std::pair<uint32_t, uint32_t> >::const_iterator i = links.begin (); i != links.end (); ++i)
+    {
+      PutVarint (i->first);
+      PutVarint (i->second);
+    }
+  End ();
+}
+
+inline void
+AnimStreamWriter::Flush (void)
+{
+  m_file.Flush ();
+}
+
+inline void
+AnimStreamWriter::Close (void)
+{
+  m_file.Close ();
+  m_strings.clear ();
+}
+
+inline uint64_t
+AnimStreamWriter::GetOffset (void) const
+{
+  return m_file.GetOffset ();
+}
+
+#endif /* ANIM_STREAM_H */
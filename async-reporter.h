@@ -0,0 +1,193 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ASYNC_REPORTER_H
+#define ASYNC_REPORTER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief Moves report output off the simulator thread.
+ *
+ * The simulator thread (the only producer) copies the formatted text into a
+ * lock-free single-producer/single-consumer byte ring; a background thread
+ * (the only consumer) drains the ring to stdout or a file and flushes it
+ * every flushInterval milliseconds.  The producer only blocks when the ring
+ * is full, so nothing is ever dropped.
+ */
+class AsyncReporter
+{
+public:
+  /**
+   * \param filename "-" for stdout
+   * \param capacity size of the ring, in bytes
+   * \param flushInterval milliseconds between two flushes of the output
+   */
+  AsyncReporter (std::string filename = "-", uint32_t capacity = 1 << 20, uint32_t flushInterval = 200);
+  ~AsyncReporter ();
+
+  bool IsOpen (void) const;
+  void Write (const char *data, size_t size);
+  void Write (const std::string &text);
+  /// Drain everything, flush and stop the output thread.
+  void Close (void);
+
+private:
+  AsyncReporter (const AsyncReporter &);
+  AsyncReporter &operator= (const AsyncReporter &);
+
+  void Drain (void);
+
+  FILE *m_file;
+  std::vector<char> m_ring;
+  uint32_t m_flushInterval;
+  std::atomic<uint64_t> m_head;     //!< bytes written by the producer
+  std::atomic<uint64_t> m_tail;     //!< bytes consumed by the output thread
+  std::atomic<bool> m_closing;
+  std::thread m_thread;
+};
+
+
+inline
+AsyncReporter::AsyncReporter (std::string filename, uint32_t capacity, uint32_t flushInterval)
+  : m_ring (capacity > 0 ? capacity : 1),
+    m_flushInterval (flushInterval),
+    m_head (0),
+    m_tail (0),
+    m_closing (false)
+{
+  m_file = (filename == "-") ? stdout : std::fopen (filename.c_str (), "w");
+  if (m_file == 0)
+    {
+      return;
+    }
+  m_thread = std::thread (&AsyncReporter::Drain, this);
+}
+
+inline
+AsyncReporter::~AsyncReporter ()
+{
+  Close ();
+}
+
+inline bool
+AsyncReporter::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline void
+AsyncReporter::Write (const char *data, size_t size)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  const uint64_t capacity = m_ring.size ();
+  uint64_t head = m_head.load (std::memory_order_relaxed);
+  while (size > 0)
+    {
+      uint64_t free = capacity - (head - m_tail.load (std::memory_order_acquire));
+      if (free == 0)
+        {
+          /* ring full: wait for the output thread */
+          std::this_thread::yield ();
+          continue;
+        }
+      uint64_t n = size < free ? size : free;
+      uint64_t offset = head % capacity;
+      uint64_t first = (capacity - offset) < n ? (capacity - offset) : n;
+      std::memcpy (&m_ring[offset], data, first);
+      std::memcpy (&m_ring[0], data + first, n - first);
+      head += n;
+      data += n;
+      size -= n;
+      m_head.store (head, std::memory_order_release);
+    }
+}
+
+inline void
+AsyncReporter::Write (const std::string &text)
+{
+  Write (text.data (), text.size ());
+}
+
+inline void
+AsyncReporter::Close (void)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  m_closing.store (true, std::memory_order_release);
+  m_thread.join ();
+  if (m_file != stdout)
+    {
+      std::fclose (m_file);
+    }
+  m_file = 0;
+}
+
+inline void
+AsyncReporter::Drain (void)
+{
+  typedef std::chrono::steady_clock Clock;
+  const uint64_t capacity = m_ring.size ();
+  Clock::time_point lastFlush = Clock::now ();
+  bool dirty = false;
+  while (true)
+    {
+      bool closing = m_closing.load (std::memory_order_acquire);
+      uint64_t tail = m_tail.load (std::memory_order_relaxed);
+      uint64_t head = m_head.load (std::memory_order_acquire);
+      if (head != tail)
+        {
+          uint64_t offset = tail % capacity;
+          uint64_t n = head - tail;
+          if (n > capacity - offset)
+            {
+              n = capacity - offset;
+            }
+          std::fwrite (&m_ring[offset], 1, n, m_file);
+          m_tail.store (tail + n, std::memory_order_release);
+          dirty = true;
+        }
+      else if (closing)
+        {
+          break;
+        }
+      else
+        {
+          std::this_thread::sleep_for (std::chrono::milliseconds (1));
+        }
+      if (dirty && Clock::now () - lastFlush >= std::chrono::milliseconds (m_flushInterval))
+        {
+          std::fflush (m_file);
+          lastFlush = Clock::now ();
+          dirty = false;
+        }
+    }
+  std::fflush (m_file);
+}
+
+#endif /* ASYNC_REPORTER_H */
@@ -0,0 +1,997 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BINARY_ANIMATION_H
+#define BINARY_ANIMATION_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/point-to-point-module.h"
+
+#include "anim-stream.h"
+#include "position-decimator.h"
+
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief The NetAnim animation as a binary animation trace (anim-stream.h).
+ *
+ * Takes the place of AnimationInterface for the calls the scripts here
+ * make: the same trace sources (wifi PHY, csma and point-to-point devices,
+ * course changes plus a mobility poll) and the same elements, but each one
+ * is a few bytes of varints instead of a line of XML, every string (the
+ * packet prints above all) is written once and then referenced by id, and
+ * the file is compressed by a background thread as it is written when its
+ * name ends in ".gz".
+ *
+ * SetPositionDecimation () thins out the positions (position-decimator.h):
+ * by default every course change and every poll that finds a node moved
+ * is written, as AnimationInterface does.
+ *
+ * An update that does not change the node, link or counter is not
+ * written, and the changes to a node at the same time go out as one
+ * record at the end of the event: a script refreshing its counters and
+ * colors every 100 ms only costs what actually changes.  A description
+ * given to several nodes or links at once is one record for all of them,
+ * and like every string it is written once and then referenced by id.
+ *
+ * The updates made before the start (time 0) go into the setup instead
+ * of being written at once, so a color set in the script is not replaced
+ * by the default red.  SetRotation () splits a long run into files that
+ * load on their own.
+ *
+ * tools/anim-to-xml turns the trace into the XML NetAnim loads.
+ *
+ * The file is closed from Simulator::Destroy (), so the object must live
+ * until then.
+ */
+class BinaryAnimation
+{
+public:
+  enum CounterType
+  {
+    UINT32_COUNTER,
+    DOUBLE_COUNTER
+  };
+
+  /// Write to filename, compressed when it ends in ".gz".
+  BinaryAnimation (std::string filename);
+  ~BinaryAnimation ();
+
+  /// As AnimationInterface::SetConstantPosition ().
+  static void SetConstantPosition (Ptr<Node> n, double x, double y, double z = 0);
+  /// Write the print of every packet (Packet::EnablePrinting ()).
+  void EnablePacketMetadata (bool enable = true);
+  /// How often the positions are checked besides the course changes; 250 ms by default.
+  void SetMobilityPollInterval (Time t);
+  /**
+   * Write a position of a node only when it is at least minInterval after
+   * the last one and minDistance away from it; with a tolerance of zero or
+   * more, the positions go with the velocity and are only written once a
+   * node strays that far from the straight line it was last put on.
+   */
+  void SetPositionDecimation (Time minInterval, double minDistance, double tolerance = -1);
+  /**
+   * Start a new file every period of simulated time, and whenever the
+   * current one reaches maxBytes (before compression); zero turns either
+   * off.  Set before the simulation starts; maxBytes should be well above
+   * the size of the setup, which every file repeats.
+   *
+   * For "dir/name.anim.gz" the files are "dir/name-0.anim.gz",
+   * "dir/name-1.anim.gz", ... and "dir/name.index" lists them, a line per
+   * file: its number, first and last time in seconds, bytes and name.
+   * Every file starts with the whole setup and the current state of the
+   * nodes, so each one loads on its own.
+   */
+  void SetRotation (Time period, uint64_t maxBytes = 0);
+
+  void UpdateNodeDescription (Ptr<Node> n, std::string descr);
+  void UpdateNodeDescription (uint32_t nodeId, std::string descr);
+  void UpdateNodeColor (Ptr<Node> n, uint8_t r, uint8_t g, uint8_t b);
+  void UpdateNodeColor (uint32_t nodeId, uint8_t r, uint8_t g, uint8_t b);
+  void UpdateNodeSize (uint32_t nodeId, double width, double height);
+  void UpdateNodeImage (uint32_t nodeId, uint32_t resourceId);
+  /// \returns the id of the resource, for UpdateNodeImage ()
+  uint32_t AddResource (std::string resourcePath);
+  /// \returns the id of the counter, for UpdateNodeCounter ()
+  uint32_t AddNodeCounter (std::string counterName, CounterType counterType);
+  void UpdateNodeCounter (uint32_t nodeCounterId, uint32_t nodeId, double counter);
+  void UpdateLinkDescription (uint32_t fromNode, uint32_t toNode, std::string linkDescription);
+  void UpdateLinkDescription (Ptr<Node> fromNode, Ptr<Node> toNode, std::string linkDescription);
+
+  /// Write what is buffered and close the file; called from Simulator::Destroy ().
+  void Close (void);
+
+private:
+  BinaryAnimation (const BinaryAnimation &);
+  BinaryAnimation &operator= (const BinaryAnimation &);
+
+  /// What a trace sink needs: the object and the node of the source.
+  struct Hook
+  {
+    BinaryAnimation *animation;
+    uint32_t node;
+  };
+
+  /// What a node looks like: the last values of the updates.
+  struct NodeState
+  {
+    NodeState ();
+    bool colored;
+    uint8_t r, g, b;
+    bool sized;
+    double width, height;
+    bool described;
+    std::string description;
+    bool imaged;
+    uint32_t image;
+  };
+
+  /// A wired packet between its transmission and its receptions.
+  struct WiredPacket
+  {
+    uint32_t from;
+    int64_t fbTx;
+    int64_t lbTx;
+    std::string meta;
+  };
+
+  /// A wireless packet between its transmission and its receptions.
+  struct WifiPacket
+  {
+    uint64_t animUid;
+    int64_t fbTx;
+  };
+
+  typedef std::pair<uint32_t, uint32_t> NodePair;
+  typedef std::map<std::string, std::vector<uint32_t> > NodesByDescription;
+
+  /// Open the file, hook the trace sources and write the setup, at time 0.
+  void Start (void);
+  void ConnectDevices (Ptr<Node> node, Hook *hook);
+  /// The declarations, then the state of every node and link.
+  void WriteSetup (void);
+  void PollMobility (void);
+  void WritePosition (uint32_t node, Ptr<const MobilityModel> model);
+  NodeState &GetState (uint32_t node);
+  /// The changes to node at this time, written together at its end.
+  AnimNodeUpdate &GetUpdate (uint32_t node);
+  /// Write the pending updates at the end of the event.
+  void ScheduleUpdates (void);
+  /// The scheduled event: write the pending updates, then rotate if the file is full.
+  void FlushUpdates (void);
+  /// Write the pending updates; no rotation, CloseChunk () writes them too.
+  void WriteUpdates (void);
+  /// A record per description, for all the nodes given it.
+  void WriteDescriptions (const NodesByDescription &nodes);
+  /// A record per description, for all the links given it.
+  void WriteLinkDescriptions (const std::map<NodePair, std::string> &links);
+
+  void OpenChunk (void);
+  void CloseChunk (void);
+  /// Close the current file and go on in the next one.
+  void Rotate (void);
+  void RotateEvery (void);
+  /// Rotate if the current file is full; not while writing the setup, nor after Close ().
+  void CheckSize (void);
+  /// The file name up to its first extension, "dir/name" for "dir/name.anim.gz".
+  std::string GetStem (void) const;
+  std::string GetChunkName (uint32_t chunk) const;
+
+  static void WifiTxBegin (Hook *hook, Ptr<const Packet> packet);
+  static void WifiRxBegin (Hook *hook, Ptr<const Packet> packet);
+  static void WiredTxBegin (Hook *hook, Ptr<const Packet> packet);
+  static void WiredTxEnd (Hook *hook, Ptr<const Packet> packet);
+  static void WiredRxEnd (Hook *hook, Ptr<const Packet> packet);
+  static void CourseChange (Hook *hook, Ptr<const MobilityModel> model);
+
+  std::string GetMeta (Ptr<const Packet> packet) const;
+  /// "ip~mac", as AnimationInterface describes a device.
+  static std::string GetAddress (Ptr<NetDevice> device);
+  static int64_t Now (void);
+
+  std::string m_filename;
+  TraceIoThread m_io;
+  AnimStreamWriter m_writer;
+  bool m_metadata;
+  Time m_pollInterval;
+  std::vector<Hook *> m_hooks;            //!< one per node
+  PositionDecimator m_decimator;
+  std::map<uint64_t, WiredPacket> m_wired;  //!< by packet uid
+  std::map<uint64_t, WifiPacket> m_wifi;    //!< by packet uid
+  uint64_t m_animUid;
+
+  std::vector<NodeState> m_nodes;
+  std::map<NodePair, std::string> m_linkDescriptions;   //!< by (from, to)
+  std::map<NodePair, double> m_counterValues;           //!< by (counter, node)
+  std::vector<std::string> m_resources;
+  std::vector<std::pair<std::string, uint8_t> > m_counters;  //!< name and AnimCounterType
+  std::map<uint32_t, AnimNodeUpdate> m_updates;         //!< by node, not written yet
+  std::map<NodePair, std::string> m_linkUpdates;        //!< by (from, to), not written yet
+  bool m_updatesScheduled;
+
+  Time m_rotatePeriod;
+  uint64_t m_rotateBytes;
+  uint32_t m_chunk;                       //!< the number of the current file
+  int64_t m_chunkStart;                   //!< when it was opened
+  FILE *m_index;
+  bool m_started;
+  bool m_closed;
+};
+
+
+inline
+BinaryAnimation::NodeState::NodeState ()
+  : colored (false),
+    r (0), g (0), b (0),
+    sized (false),
+    width (0), height (0),
+    described (false),
+    imaged (false),
+    image (0)
+{
+}
+
+inline
+BinaryAnimation::BinaryAnimation (std::string filename)
+  : m_filename (filename),
+    m_metadata (false),
+    m_pollInterval (MilliSeconds (250)),
+    m_animUid (0),
+    m_updatesScheduled (false),
+    m_rotatePeriod (Seconds (0)),
+    m_rotateBytes (0),
+    m_chunk (0),
+    m_chunkStart (0),
+    m_index (0),
+    m_started (false),
+    m_closed (false)
+{
+  Simulator::Schedule (Seconds (0), &BinaryAnimation::Start, this);
+  Simulator::ScheduleDestroy (&BinaryAnimation::Close, this);
+}
+
+inline
+BinaryAnimation::~BinaryAnimation ()
+{
+  Close ();
+  for (std::vector<Hook *>::iterator i = m_hooks.begin (); i != m_hooks.end (); ++i)
+    {
+      delete *i;
+    }
+}
+
+inline void
+BinaryAnimation::SetConstantPosition (Ptr<Node> n, double x, double y, double z)
+{
+  Ptr<ConstantPositionMobilityModel> model = n->GetObject<ConstantPositionMobilityModel> ();
+  if (model == 0)
+    {
+      model = CreateObject<ConstantPositionMobilityModel> ();
+      n->AggregateObject (model);
+    }
+  model->SetPosition (Vector (x, y, z));
+}
+
+inline void
+BinaryAnimation::EnablePacketMetadata (bool enable)
+{
+  m_metadata = enable;
+  if (enable)
+    {
+      Packet::EnablePrinting ();
+    }
+}
+
+inline void
+BinaryAnimation::SetMobilityPollInterval (Time t)
+{
+  m_pollInterval = t;
+}
+
+inline void
+BinaryAnimation::SetPositionDecimation (Time minInterval, double minDistance, double tolerance)
+{
+  m_decimator.SetMinInterval (minInterval.GetNanoSeconds ());
+  m_decimator.SetMinDistance (minDistance);
+  m_decimator.SetTolerance (tolerance);
+}
+
+inline void
+BinaryAnimation::SetRotation (Time period, uint64_t maxBytes)
+{
+  NS_ASSERT_MSG (!m_started, "BinaryAnimation::SetRotation () after the start");
+  m_rotatePeriod = period;
+  m_rotateBytes = maxBytes;
+}
+
+inline void
+BinaryAnimation::UpdateNodeDescription (Ptr<Node> n, std::string descr)
+{
+  UpdateNodeDescription (n->GetId (), descr);
+}
+
+inline void
+BinaryAnimation::UpdateNodeDescription (uint32_t nodeId, std::string descr)
+{
+  NodeState &state = GetState (nodeId);
+  if (state.described && state.description == descr)
+    {
+      return;
+    }
+  state.described = true;
+  state.description = descr;
+  if (m_started)
+    {
+      AnimNodeUpdate &update = GetUpdate (nodeId);
+      update.fields |= ANIM_FIELD_DESCRIPTION;
+      update.description = descr;
+    }
+}
+
+inline void
+BinaryAnimation::UpdateNodeColor (Ptr<Node> n, uint8_t r, uint8_t g, uint8_t b)
+{
+  UpdateNodeColor (n->GetId (), r, g, b);
+}
+
+inline void
+BinaryAnimation::UpdateNodeColor (uint32_t nodeId, uint8_t r, uint8_t g, uint8_t b)
+{
+  NodeState &state = GetState (nodeId);
+  if (state.colored && state.r == r && state.g == g && state.b == b)
+    {
+      return;
+    }
+  state.colored = true;
+  state.r = r;
+  state.g = g;
+  state.b = b;
+  if (m_started)
+    {
+      AnimNodeUpdate &update = GetUpdate (nodeId);
+      update.fields |= ANIM_FIELD_COLOR;
+      update.r = r;
+      update.g = g;
+      update.b = b;
+    }
+}
+
+inline void
+BinaryAnimation::UpdateNodeSize (uint32_t nodeId, double width, double height)
+{
+  NodeState &state = GetState (nodeId);
+  if (state.sized && state.width == width && state.height == height)
+    {
+      return;
+    }
+  state.sized = true;
+  state.width = width;
+  state.height = height;
+  if (m_started)
+    {
+      AnimNodeUpdate &update = GetUpdate (nodeId);
+      update.fields |= ANIM_FIELD_SIZE;
+      update.width = width;
+      update.height = height;
+    }
+}
+
+inline void
+BinaryAnimation::UpdateNodeImage (uint32_t nodeId, uint32_t resourceId)
+{
+  NodeState &state = GetState (nodeId);
+  if (state.imaged && state.image == resourceId)
+    {
+      return;
+    }
+  state.imaged = true;
+  state.image = resourceId;
+  if (m_started)
+    {
+      AnimNodeUpdate &update = GetUpdate (nodeId);
+      update.fields |= ANIM_FIELD_IMAGE;
+      update.image = resourceId;
+    }
+}
+
+inline uint32_t
+BinaryAnimation::AddResource (std::string resourcePath)
+{
+  m_resources.push_back (resourcePath);
+  if (m_started)
+    {
+      m_writer.Resource (m_resources.size () - 1, resourcePath);
+    }
+  return m_resources.size () - 1;
+}
+
+inline uint32_t
+BinaryAnimation::AddNodeCounter (std::string counterName, CounterType counterType)
+{
+  uint8_t type = counterType == UINT32_COUNTER ? ANIM_COUNTER_UINT32 : ANIM_COUNTER_DOUBLE;
+  m_counters.push_back (std::make_pair (counterName, type));
+  if (m_started)
+    {
+      m_writer.Counter (m_counters.size () - 1, counterName, type);
+    }
+  return m_counters.size () - 1;
+}
+
+inline void
+BinaryAnimation::UpdateNodeCounter (uint32_t nodeCounterId, uint32_t nodeId, double counter)
+{
+  std::map<NodePair, double>::iterator last = m_counterValues.find (NodePair (nodeCounterId, nodeId));
+  if (last != m_counterValues.end () && last->second == counter)
+    {
+      return;
+    }
+  m_counterValues[NodePair (nodeCounterId, nodeId)] = counter;
+  if (m_started)
+    {
+      GetUpdate (nodeId).SetCounter (nodeCounterId, counter);
+    }
+}
+
+inline void
+BinaryAnimation::UpdateLinkDescription (uint32_t fromNode, uint32_t toNode, std::string linkDescription)
+{
+  std::map<NodePair, std::string>::iterator last = m_linkDescriptions.find (NodePair (fromNode, toNode));
+  if (last != m_linkDescriptions.end () && last->second == linkDescription)
+    {
+      return;
+    }
+  m_linkDescriptions[NodePair (fromNode, toNode)] = linkDescription;
+  if (m_started)
+    {
+      m_linkUpdates[NodePair (fromNode, toNode)] = linkDescription;
+      ScheduleUpdates ();
+    }
+}
+
+inline void
+BinaryAnimation::UpdateLinkDescription (Ptr<Node> fromNode, Ptr<Node> toNode, std::string linkDescription)
+{
+  UpdateLinkDescription (fromNode->GetId (), toNode->GetId (), linkDescription);
+}
+
+inline void
+BinaryAnimation::Close (void)
+{
+  if (m_closed)
+    {
+      return;
+    }
+  m_closed = true;
+  if (m_started)
+    {
+      CloseChunk ();
+    }
+  if (m_index != 0)
+    {
+      std::fclose (m_index);
+      m_index = 0;
+    }
+  m_io.Close ();
+}
+
+inline BinaryAnimation::NodeState &
+BinaryAnimation::GetState (uint32_t node)
+{
+  if (node >= m_nodes.size ())
+    {
+      m_nodes.resize (node + 1);
+    }
+  return m_nodes[node];
+}
+
+inline AnimNodeUpdate &
+BinaryAnimation::GetUpdate (uint32_t node)
+{
+  ScheduleUpdates ();
+  return m_updates[node];
+}
+
+inline void
+BinaryAnimation::ScheduleUpdates (void)
+{
+  if (!m_updatesScheduled)
+    {
+      m_updatesScheduled = true;
+      Simulator::ScheduleNow (&BinaryAnimation::FlushUpdates, this);
+    }
+}
+
+inline void
+BinaryAnimation::FlushUpdates (void)
+{
+  WriteUpdates ();
+  CheckSize ();
+}
+
+inline void
+BinaryAnimation::WriteUpdates (void)
+{
+  m_updatesScheduled = false;
+  if (m_updates.empty () && m_linkUpdates.empty ())
+    {
+      return;
+    }
+  /* a description given to several nodes goes out once for all of them */
+  NodesByDescription described;
+  for (std::map<uint32_t, AnimNodeUpdate>::const_iterator i = m_updates.begin (); i != m_updates.end (); ++i)
+    {
+      if (i->second.fields & ANIM_FIELD_DESCRIPTION)
+        {
+          described[i->second.description].push_back (i->first);
+        }
+    }
+  for (NodesByDescription::iterator i = described.begin (); i != described.end (); )
+    {
+      if (i->second.size () == 1)
+        {
+          described.erase (i++);
+          continue;
+        }
+      for (std::vector<uint32_t>::const_iterator n = i->second.begin (); n != i->second.end (); ++n)
+        {
+          m_updates[*n].fields &= ~ANIM_FIELD_DESCRIPTION;
+        }
+      ++i;
+    }
+  WriteDescriptions (described);
+  for (std::map<uint32_t, AnimNodeUpdate>::const_iterator i = m_updates.begin (); i != m_updates.end (); ++i)
+    {
+      m_writer.NodeUpdate (Now (), i->first, i->second);
+    }
+  WriteLinkDescriptions (m_linkUpdates);
+  m_updates.clear ();
+  m_linkUpdates.clear ();
+}
+
+inline void
+BinaryAnimation::WriteDescriptions (const NodesByDescription &nodes)
+{
+  for (NodesByDescription::const_iterator i = nodes.begin (); i != nodes.end (); ++i)
+    {
+      m_writer.Descriptions (Now (), i->second, i->first);
+    }
+}
+
+inline void
+BinaryAnimation::WriteLinkDescriptions (const std::map<NodePair, std::string> &links)
+{
+  std::map<std::string, std::vector<NodePair> > described;
+  for (std::map<NodePair, std::string>::const_iterator i = links.begin (); i != links.end (); ++i)
+    {
+      described[i->second].push_back (i->first);
+    }
+  for (std::map<std::string, std::vector<NodePair> >::const_iterator i = described.begin (); i != described.end (); ++i)
+    {
+      m_writer.LinkDescriptions (Now (), i->second, i->first);
+    }
+}
+
+inline void
+BinaryAnimation::Start (void)
+{
+  m_started = true;
+  if (m_rotatePeriod.IsStrictlyPositive () || m_rotateBytes > 0)
+    {
+      std::string index = GetStem () + ".index";
+      m_index = std::fopen (index.c_str (), "w");
+      NS_ABORT_MSG_UNLESS (m_index != 0, "Cannot open " << index);
+      std::fprintf (m_index, "# chunk first(s) last(s) bytes file\n");
+      std::fflush (m_index);
+    }
+  OpenChunk ();
+
+  /* what AnimationInterface shows of a node nothing was said about */
+  uint32_t nodes = NodeList::GetNNodes ();
+  for (uint32_t n = 0; n < nodes; n++)
+    {
+      NodeState &state = GetState (n);
+      if (!state.colored)
+        {
+          state.colored = true;
+          state.r = 255;
+        }
+      if (!state.sized)
+        {
+          state.sized = true;
+          state.width = 1;
+          state.height = 1;
+        }
+    }
+  WriteSetup ();
+
+  for (uint32_t n = 0; n < nodes; n++)
+    {
+      Ptr<Node> node = NodeList::GetNode (n);
+      Hook *hook = new Hook;
+      hook->animation = this;
+      hook->node = n;
+      m_hooks.push_back (hook);
+      ConnectDevices (node, hook);
+      Ptr<MobilityModel> model = node->GetObject<MobilityModel> ();
+      if (model != 0)
+        {
+          model->TraceConnectWithoutContext ("CourseChange", MakeBoundCallback (&BinaryAnimation::CourseChange, hook));
+        }
+    }
+  Simulator::Schedule (m_pollInterval, &BinaryAnimation::PollMobility, this);
+  if (m_rotatePeriod.IsStrictlyPositive ())
+    {
+      Simulator::Schedule (m_rotatePeriod, &BinaryAnimation::RotateEvery, this);
+    }
+}
+
+inline void
+BinaryAnimation::WriteSetup (void)
+{
+  uint32_t nodes = NodeList::GetNNodes ();
+  for (uint32_t n = 0; n < nodes; n++)
+    {
+      Ptr<Node> node = NodeList::GetNode (n);
+      Ptr<MobilityModel> model = node->GetObject<MobilityModel> ();
+      Vector position = model != 0 ? model->GetPosition () : Vector ();
+      m_writer.Node (n, node->GetSystemId (), position.x, position.y);
+    }
+  for (uint32_t n = 0; n < m_nodes.size (); n++)
+    {
+      if (m_nodes[n].colored)
+        {
+          m_writer.Color (Now (), n, m_nodes[n].r, m_nodes[n].g, m_nodes[n].b);
+        }
+    }
+  for (uint32_t n = 0; n < nodes; n++)
+    {
+      Ptr<Node> node = NodeList::GetNode (n);
+      for (uint32_t i = 0; i < node->GetNDevices (); i++)
+        {
+          Ptr<NetDevice> device = node->GetDevice (i);
+          Ptr<Channel> channel = device->GetChannel ();
+          if (channel == 0)
+            {
+              continue;             // loopback
+            }
+          if (DynamicCast<PointToPointNetDevice> (device) != 0)
+            {
+              Ptr<NetDevice> peer = channel->GetDevice (channel->GetDevice (0) == device ? 1 : 0);
+              if (n < peer->GetNode ()->GetId ())
+                {
+                  m_writer.Link (n, peer->GetNode ()->GetId (), GetAddress (device), GetAddress (peer), "");
+                }
+              continue;
+            }
+          m_writer.NonP2pLink (n, GetAddress (device), channel->GetInstanceTypeId ().GetName ());
+        }
+    }
+  for (uint32_t n = 0; n < m_nodes.size (); n++)
+    {
+      if (m_nodes[n].sized)
+        {
+          m_writer.Size (Now (), n, m_nodes[n].width, m_nodes[n].height);
+        }
+    }
+  for (uint32_t i = 0; i < m_resources.size (); i++)
+    {
+      m_writer.Resource (i, m_resources[i]);
+    }
+  for (uint32_t i = 0; i < m_counters.size (); i++)
+    {
+      m_writer.Counter (i, m_counters[i].first, m_counters[i].second);
+    }
+  NodesByDescription described;
+  for (uint32_t n = 0; n < m_nodes.size (); n++)
+    {
+      if (m_nodes[n].described)
+        {
+          described[m_nodes[n].description].push_back (n);
+        }
+      if (m_nodes[n].imaged)
+        {
+          m_writer.Image (Now (), n, m_nodes[n].image);
+        }
+    }
+  WriteDescriptions (described);
+  WriteLinkDescriptions (m_linkDescriptions);
+  for (std::map<NodePair, double>::const_iterator i = m_counterValues.begin (); i != m_counterValues.end (); ++i)
+    {
+      m_writer.CounterValue (Now (), i->first.first, i->first.second, i->second);
+    }
+  m_decimator.Reset ();
+  for (uint32_t n = 0; n < nodes; n++)
+    {
+      Ptr<MobilityModel> model = NodeList::GetNode (n)->GetObject<MobilityModel> ();
+      if (model != 0)
+        {
+          WritePosition (n, model);
+        }
+    }
+}
+
+inline void
+BinaryAnimation::ConnectDevices (Ptr<Node> node, Hook *hook)
+{
+  for (uint32_t i = 0; i < node->GetNDevices (); i++)
+    {
+      Ptr<NetDevice> device = node->GetDevice (i);
+      PointerValue phy;
+      if (DynamicCast<CsmaNetDevice> (device) != 0 || DynamicCast<PointToPointNetDevice> (device) != 0)
+        {
+          device->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&BinaryAnimation::WiredTxBegin, hook));
+          device->TraceConnectWithoutContext ("PhyTxEnd", MakeBoundCallback (&BinaryAnimation::WiredTxEnd, hook));
+          device->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&BinaryAnimation::WiredRxEnd, hook));
+        }
+      else if (device->GetAttributeFailSafe ("Phy", phy) && phy.Get<Object> () != 0)
+        {
+          /* wifi and uan: whoever hears the transmission receives it */
+          phy.Get<Object> ()->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&BinaryAnimation::WifiTxBegin, hook));
+          phy.Get<Object> ()->TraceConnectWithoutContext ("PhyRxBegin", MakeBoundCallback (&BinaryAnimation::WifiRxBegin, hook));
+        }
+    }
+}
+
+inline void
+BinaryAnimation::OpenChunk (void)
+{
+  std::string filename = m_index != 0 ? GetChunkName (m_chunk) : m_filename;
+  NS_ABORT_MSG_UNLESS (m_writer.Open (filename, &m_io), "Cannot open " << filename);
+  m_chunkStart = Now ();
+}
+
+inline void
+BinaryAnimation::CloseChunk (void)
+{
+  WriteUpdates ();
+  uint64_t bytes = m_writer.GetOffset ();
+  m_writer.Close ();
+  if (m_index != 0)
+    {
+      std::string name = GetChunkName (m_chunk);
+      std::fprintf (m_index, "%u %.9f %.9f %llu %s\n", m_chunk, m_chunkStart / 1e9, Now () / 1e9,
+                    (unsigned long long) bytes, name.substr (name.find_last_of ('/') + 1).c_str ());
+      std::fflush (m_index);
+    }
+}
+
+inline void
+BinaryAnimation::Rotate (void)
+{
+  CloseChunk ();
+  m_chunk++;
+  OpenChunk ();
+  WriteSetup ();
+}
+
+inline void
+BinaryAnimation::RotateEvery (void)
+{
+  if (m_closed)
+    {
+      return;
+    }
+  Rotate ();
+  Simulator::Schedule (m_rotatePeriod, &BinaryAnimation::RotateEvery, this);
+}
+
+inline void
+BinaryAnimation::CheckSize (void)
+{
+  if (!m_closed && m_rotateBytes > 0 && m_writer.GetOffset () >= m_rotateBytes)
+    {
+      Rotate ();
+    }
+}
+
+inline std::string
+BinaryAnimation::GetStem (void) const
+{
+  std::string::size_type dot = m_filename.find ('.', m_filename.find_last_of ('/') + 1);
+  return m_filename.substr (0, dot);
+}
+
+inline std::string
+BinaryAnimation::GetChunkName (uint32_t chunk) const
+{
+  std::ostringstream name;
+  name << GetStem () << "-" << chunk << m_filename.substr (GetStem ().size ());
+  return name.str ();
+}
+
+inline void
+BinaryAnimation::PollMobility (void)
+{
+  for (uint32_t n = 0; n < m_hooks.size (); n++)
+    {
+      Ptr<MobilityModel> model = NodeList::GetNode (n)->GetObject<MobilityModel> ();
+      if (model != 0)
+        {
+          WritePosition (n, model);
+        }
+    }
+  CheckSize ();
+  /* packets still waiting for a reception after a second never get one */
+  int64_t expired = Now () - 1000000000;
+  for (std::map<uint64_t, WiredPacket>::iterator i = m_wired.begin (); i != m_wired.end (); )
+    {
+      if (i->second.fbTx < expired)
+        {
+          m_wired.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+  for (std::map<uint64_t, WifiPacket>::iterator i = m_wifi.begin (); i != m_wifi.end (); )
+    {
+      if (i->second.fbTx < expired)
+        {
+          m_wifi.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+  Simulator::Schedule (m_pollInterval, &BinaryAnimation::PollMobility, this);
+}
+
+inline void
+BinaryAnimation::WritePosition (uint32_t node, Ptr<const MobilityModel> model)
+{
+  Vector position = model->GetPosition ();
+  Vector velocity = model->GetVelocity ();
+  if (!m_decimator.Accept (node, Now (), position.x, position.y, velocity.x, velocity.y))
+    {
+      return;
+    }
+  if (m_decimator.IsLinear ())
+    {
+      m_writer.Motion (Now (), node, position.x, position.y, velocity.x, velocity.y);
+    }
+  else
+    {
+      m_writer.Position (Now (), node, position.x, position.y);
+    }
+}
+
+inline void
+BinaryAnimation::WifiTxBegin (Hook *hook, Ptr<const Packet> packet)
+{
+  BinaryAnimation *a = hook->animation;
+  WifiPacket &pending = a->m_wifi[packet->GetUid ()];
+  pending.animUid = ++a->m_animUid;
+  pending.fbTx = Now ();
+  a->m_writer.WifiTx (pending.fbTx, pending.animUid, hook->node, pending.fbTx, a->GetMeta (packet));
+  a->CheckSize ();
+}
+
+inline void
+BinaryAnimation::WifiRxBegin (Hook *hook, Ptr<const Packet> packet)
+{
+  BinaryAnimation *a = hook->animation;
+  std::map<uint64_t, WifiPacket>::const_iterator i = a->m_wifi.find (packet->GetUid ());
+  if (i != a->m_wifi.end ())
+    {
+      a->m_writer.WifiRx (Now (), i->second.animUid, hook->node, Now ());
+      a->CheckSize ();
+    }
+}
+
+inline void
+BinaryAnimation::WiredTxBegin (Hook *hook, Ptr<const Packet> packet)
+{
+  BinaryAnimation *a = hook->animation;
+  WiredPacket &pending = a->m_wired[packet->GetUid ()];
+  pending.from = hook->node;
+  pending.fbTx = Now ();
+  pending.lbTx = pending.fbTx;
+  pending.meta = a->GetMeta (packet);
+}
+
+inline void
+BinaryAnimation::WiredTxEnd (Hook *hook, Ptr<const Packet> packet)
+{
+  BinaryAnimation *a = hook->animation;
+  std::map<uint64_t, WiredPacket>::iterator i = a->m_wired.find (packet->GetUid ());
+  if (i != a->m_wired.end ())
+    {
+      i->second.lbTx = Now ();
+    }
+}
+
+inline void
+BinaryAnimation::WiredRxEnd (Hook *hook, Ptr<const Packet> packet)
+{
+  BinaryAnimation *a = hook->animation;
+  std::map<uint64_t, WiredPacket>::const_iterator i = a->m_wired.find (packet->GetUid ());
+  if (i == a->m_wired.end ())
+    {
+      return;
+    }
+  const WiredPacket &p = i->second;
+  int64_t now = Now ();
+  a->m_writer.Packet (now, p.from, hook->node, p.fbTx, p.lbTx, now - (p.lbTx - p.fbTx), now, p.meta);
+  a->CheckSize ();
+}
+
+inline void
+BinaryAnimation::CourseChange (Hook *hook, Ptr<const MobilityModel> model)
+{
+  hook->animation->WritePosition (hook->node, model);
+  hook->animation->CheckSize ();
+}
+
+inline std::string
+BinaryAnimation::GetMeta (Ptr<const Packet> packet) const
+{
+  if (!m_metadata)
+    {
+      return "";
+    }
+  std::ostringstream meta;
+  packet->Print (meta);
+  return meta.str ();
+}
+
+inline std::string
+BinaryAnimation::GetAddress (Ptr<NetDevice> device)
+{
+  std::ostringstream address;
+  Ipv4Address local ("0.0.0.0");
+  Ptr<Ipv4> ipv4 = device->GetNode ()->GetObject<Ipv4> ();
+  if (ipv4 != 0)
+    {
+      int32_t i = ipv4->GetInterfaceForDevice (device);
+      if (i >= 0 && ipv4->GetNAddresses (i) > 0)
+        {
+          local = ipv4->GetAddress (i, 0).GetLocal ();
+        }
+    }
+  address << local << "~";
+  if (Mac48Address::IsMatchingType (device->GetAddress ()))
+    {
+      address << Mac48Address::ConvertFrom (device->GetAddress ());
+    }
+  else
+    {
+      address << device->GetAddress ();
+    }
+  return address.str ();
+}
+
+inline int64_t
+BinaryAnimation::Now (void)
+{
+  return Simulator::Now ().GetNanoSeconds ();
+}
+
+} // namespace ns3
+
+#endif /* BINARY_ANIMATION_H */
@@ -0,0 +1,83 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+/*
+ * The binary event log: the events of the csma ascii trace (+ - d r) as
+ * fixed-size records, without formatting a line or printing the packet.
+ *
+ *     EventLogHeader, once
+ *     EventLogRecord per event, 32 bytes, host byte order
+ *
+ * TraceCapture::EnableCsmaEventLog () writes it, EventLogReader
+ * (trace-reader.h) reads it and "trace-cat <file> tr" turns it back into
+ * .tr lines.
+ *
+ * This file does not depend on ns-3.
+ */
+
+#include <stdint.h>
+
+enum EventLogType
+{
+  EVENT_LOG_ENQUEUE = 0,        //!< "+", TxQueue/Enqueue
+  EVENT_LOG_DEQUEUE = 1,        //!< "-", TxQueue/Dequeue
+  EVENT_LOG_DROP = 2,           //!< "d", TxQueue/Drop
+  EVENT_LOG_RECEIVE = 3         //!< "r", MacRx
+};
+
+static const uint32_t EVENT_LOG_VERSION = 1;
+
+struct EventLogHeader
+{
+  char magic[8];                //!< "NS3EVLOG"
+  uint32_t version;             //!< EVENT_LOG_VERSION
+  uint32_t recordSize;          //!< sizeof (EventLogRecord)
+};
+
+struct EventLogRecord
+{
+  int64_t timeNs;               //!< simulation time, in nanoseconds
+  uint64_t uid;                 //!< the packet uid
+  uint32_t node;
+  uint32_t size;                //!< the packet size, in bytes
+  uint32_t queueDepth;          //!< packets in the device queue at the event
+  uint16_t device;              //!< the device index on the node
+  uint8_t type;                 //!< one of EventLogType
+  uint8_t reserved;
+};
+
+static_assert (sizeof (EventLogRecord) == 32, "EventLogRecord must stay 32 bytes");
+
+/// The event character of the ascii trace.
+inline char
+EventLogSymbol (uint8_t type)
+{
+  static const char symbols[] = { '+', '-', 'd', 'r' };
+  return type < 4 ? symbols[type] : '?';
+}
+
+/// The trace source of the event, as in the context of the ascii trace.
+inline const char *
+EventLogSource (uint8_t type)
+{
+  static const char *sources[] = { "TxQueue/Enqueue", "TxQueue/Dequeue", "TxQueue/Drop", "MacRx" };
+  return type < 4 ? sources[type] : "?";
+}
+
+#endif /* EVENT_LOG_H */
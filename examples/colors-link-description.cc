@@ -25,10 +25,12 @@
 #include "ns3/netanim-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/point-to-point-layout-module.h"
+#include "../binary-animation.h"
 
 using namespace ns3;
 
 AnimationInterface * pAnim = 0;
+BinaryAnimation * pBinaryAnim = 0;
 
 struct rgb {
   uint8_t r;
@@ -42,26 +44,27 @@ struct rgb colors [] = {
                         { 0, 0, 255 }  // Green
                         };
 
-void modify ()
+template <typename Animation>
+void modify (Animation *anim)
 {
   std::ostringstream oss;
   oss << "Update:" << Simulator::Now ().GetSeconds ();
-  pAnim->UpdateLinkDescription (0, 1, oss.str ());
-  pAnim->UpdateLinkDescription (0, 2, oss.str ());
-  pAnim->UpdateLinkDescription (0, 3, oss.str ());
-  pAnim->UpdateLinkDescription (0, 4, oss.str ());
-  pAnim->UpdateLinkDescription (0, 5, oss.str ());
-  pAnim->UpdateLinkDescription (0, 6, oss.str ());
-  pAnim->UpdateLinkDescription (1, 7, oss.str ());
-  pAnim->UpdateLinkDescription (1, 8, oss.str ());
-  pAnim->UpdateLinkDescription (1, 9, oss.str ());
-  pAnim->UpdateLinkDescription (1, 10, oss.str ());
-  pAnim->UpdateLinkDescription (1, 11, oss.str ());
+  anim->UpdateLinkDescription (0, 1, oss.str ());
+  anim->UpdateLinkDescription (0, 2, oss.str ());
+  anim->UpdateLinkDescription (0, 3, oss.str ());
+  anim->UpdateLinkDescription (0, 4, oss.str ());
+  anim->UpdateLinkDescription (0, 5, oss.str ());
+  anim->UpdateLinkDescription (0, 6, oss.str ());
+  anim->UpdateLinkDescription (1, 7, oss.str ());
+  anim->UpdateLinkDescription (1, 8, oss.str ());
+  anim->UpdateLinkDescription (1, 9, oss.str ());
+  anim->UpdateLinkDescription (1, 10, oss.str ());
+  anim->UpdateLinkDescription (1, 11, oss.str ());
   
   // Every update change the node description for node 2
   std::ostringstream node0Oss;
   node0Oss << "-----Node:" << Simulator::Now ().GetSeconds ();
-  pAnim->UpdateNodeDescription (2, node0Oss.str ());
+  anim->UpdateNodeDescription (2, node0Oss.str ());
 
   // Every update change the color for node 4
   static uint32_t index = 0;
@@ -70,12 +73,12 @@ void modify ()
     index = 0;
   struct rgb color = colors[index];
   for (uint32_t nodeId = 4; nodeId < 12; ++nodeId)
-    pAnim->UpdateNodeColor (nodeId, color.r, color.g, color.b); 
+    anim->UpdateNodeColor (nodeId, color.r, color.g, color.b); 
 
 
   if (Simulator::Now ().GetSeconds () < 10) // This is important or the simulation
     // will run endlessly
-    Simulator::Schedule (Seconds (1), modify);
+    Simulator::Schedule (Seconds (1), &modify<Animation>, anim);
 
 }
 
@@ -88,12 +91,14 @@ int main (int argc, char *argv[])
   uint32_t    nRightLeaf = 5;
   uint32_t    nLeaf = 0; // If non-zero, number of both left and right
   std::string animFile = "dynamic_linknode.xml" ;  // Name of file for animation output
+  bool binary = false;
 
   CommandLine cmd;
   cmd.AddValue ("nLeftLeaf", "Number of left side leaf nodes", nLeftLeaf);
   cmd.AddValue ("nRightLeaf","Number of right side leaf nodes", nRightLeaf);
   cmd.AddValue ("nLeaf",     "Number of left and right side leaf nodes", nLeaf);
   cmd.AddValue ("animFile",  "File Name for Animation Output", animFile);
+  cmd.AddValue ("binary",    "Write a binary animation trace, animFile with .anim.gz for .xml (tools/anim-to-xml converts it)", binary);
 
   cmd.Parse (argc,argv);
   if (nLeaf > 0)
@@ -147,8 +152,18 @@ int main (int argc, char *argv[])
 
 
   // Create the animation object and configure for specified output
-  pAnim = new AnimationInterface (animFile);
-  Simulator::Schedule (Seconds (1), modify);
+  if (binary)
+    {
+      // The eleven link descriptions of an update go out as one record
+      animFile = animFile.substr (0, animFile.rfind (".xml")) + ".anim.gz";
+      pBinaryAnim = new BinaryAnimation (animFile);
+      Simulator::Schedule (Seconds (1), &modify<BinaryAnimation>, pBinaryAnim);
+    }
+  else
+    {
+      pAnim = new AnimationInterface (animFile);
+      Simulator::Schedule (Seconds (1), &modify<AnimationInterface>, pAnim);
+    }
   
   // Set up the acutal simulation
   Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
@@ -157,5 +172,6 @@ int main (int argc, char *argv[])
   std::cout << "Animation Trace file created:" << animFile.c_str ()<< std::endl;
   Simulator::Destroy ();
   delete pAnim;
+  delete pBinaryAnim;
   return 0;
 }
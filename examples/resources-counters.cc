@@ -25,10 +25,12 @@
 #include "ns3/netanim-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/point-to-point-layout-module.h"
+#include "../binary-animation.h"
 
 using namespace ns3;
 
 AnimationInterface * pAnim = 0;
+BinaryAnimation * pBinaryAnim = 0;
 
 struct rgb {
   uint8_t r;
@@ -48,34 +50,35 @@ uint32_t nodeCounterIdUint32;
 uint32_t nodeCounterIdDouble1;
 uint32_t nodeCounterIdDouble2;
 
-void modify ()
+template <typename Animation>
+void modify (Animation *anim)
 {
   std::ostringstream oss;
   oss << "Update:" << Simulator::Now ().GetSeconds ();
-  pAnim->UpdateLinkDescription (0, 1, oss.str ());
-  pAnim->UpdateLinkDescription (0, 2, oss.str ());
-  pAnim->UpdateLinkDescription (0, 3, oss.str ());
-  pAnim->UpdateLinkDescription (0, 4, oss.str ());
-  pAnim->UpdateLinkDescription (0, 5, oss.str ());
-  pAnim->UpdateLinkDescription (0, 6, oss.str ());
-  pAnim->UpdateLinkDescription (1, 7, oss.str ());
-  pAnim->UpdateLinkDescription (1, 8, oss.str ());
-  pAnim->UpdateLinkDescription (1, 9, oss.str ());
-  pAnim->UpdateLinkDescription (1, 10, oss.str ());
-  pAnim->UpdateLinkDescription (1, 11, oss.str ());
+  anim->UpdateLinkDescription (0, 1, oss.str ());
+  anim->UpdateLinkDescription (0, 2, oss.str ());
+  anim->UpdateLinkDescription (0, 3, oss.str ());
+  anim->UpdateLinkDescription (0, 4, oss.str ());
+  anim->UpdateLinkDescription (0, 5, oss.str ());
+  anim->UpdateLinkDescription (0, 6, oss.str ());
+  anim->UpdateLinkDescription (1, 7, oss.str ());
+  anim->UpdateLinkDescription (1, 8, oss.str ());
+  anim->UpdateLinkDescription (1, 9, oss.str ());
+  anim->UpdateLinkDescription (1, 10, oss.str ());
+  anim->UpdateLinkDescription (1, 11, oss.str ());
   
   // Every update change the node description for node 2
   std::ostringstream node0Oss;
   node0Oss << "-----Node:" << Simulator::Now ().GetSeconds ();
-  pAnim->UpdateNodeDescription (2, node0Oss.str ());
+  anim->UpdateNodeDescription (2, node0Oss.str ());
   static double size = 2;
   static uint32_t currentResourceId = resourceId1;
-  pAnim->UpdateNodeSize (2, size, size);
-  pAnim->UpdateNodeImage (3, currentResourceId);
+  anim->UpdateNodeSize (2, size, size);
+  anim->UpdateNodeImage (3, currentResourceId);
   size *= 1.1;
   if (size > 20)
     size = 1;
-  pAnim->UpdateNodeSize (3, 10, 10);
+  anim->UpdateNodeSize (3, 10, 10);
   if (currentResourceId == resourceId1)
     currentResourceId = resourceId2;
   else
@@ -88,20 +91,20 @@ void modify ()
     index = 0;
   struct rgb color = colors[index];
   for (uint32_t nodeId = 4; nodeId < 12; ++nodeId)
-    pAnim->UpdateNodeColor (nodeId, color.r, color.g, color.b); 
+    anim->UpdateNodeColor (nodeId, color.r, color.g, color.b); 
 
   // Update Node Counter for node 0 and node 5, use some random number between 0 to 1000 for value
   Ptr <UniformRandomVariable> rv = CreateObject<UniformRandomVariable> ();
-  pAnim->UpdateNodeCounter (nodeCounterIdUint32, 0, rv->GetValue (0, 1000));
-  pAnim->UpdateNodeCounter (nodeCounterIdDouble1, 0, rv->GetValue (100.0, 200.0));
-  pAnim->UpdateNodeCounter (nodeCounterIdDouble2, 0, rv->GetValue (300.0, 400.0));
-  pAnim->UpdateNodeCounter (nodeCounterIdUint32, 5, rv->GetValue (0, 1000));
-  pAnim->UpdateNodeCounter (nodeCounterIdDouble1, 5, rv->GetValue (100.0, 200.0));
-  pAnim->UpdateNodeCounter (nodeCounterIdDouble2, 5, rv->GetValue (300.0, 400.0));
+  anim->UpdateNodeCounter (nodeCounterIdUint32, 0, rv->GetValue (0, 1000));
+  anim->UpdateNodeCounter (nodeCounterIdDouble1, 0, rv->GetValue (100.0, 200.0));
+  anim->UpdateNodeCounter (nodeCounterIdDouble2, 0, rv->GetValue (300.0, 400.0));
+  anim->UpdateNodeCounter (nodeCounterIdUint32, 5, rv->GetValue (0, 1000));
+  anim->UpdateNodeCounter (nodeCounterIdDouble1, 5, rv->GetValue (100.0, 200.0));
+  anim->UpdateNodeCounter (nodeCounterIdDouble2, 5, rv->GetValue (300.0, 400.0));
 
   if (Simulator::Now ().GetSeconds () < 10) // This is important or the simulation
     // will run endlessly
-    Simulator::Schedule (Seconds (0.1), modify);
+    Simulator::Schedule (Seconds (0.1), &modify<Animation>, anim);
 
 }
 
@@ -114,12 +117,14 @@ int main (int argc, char *argv[])
   uint32_t    nRightLeaf = 5;
   uint32_t    nLeaf = 0; // If non-zero, number of both left and right
   std::string animFile = "resources_demo.xml" ;  // Name of file for animation output
+  bool binary = false;
 
   CommandLine cmd;
   cmd.AddValue ("nLeftLeaf", "Number of left side leaf nodes", nLeftLeaf);
   cmd.AddValue ("nRightLeaf","Number of right side leaf nodes", nRightLeaf);
   cmd.AddValue ("nLeaf",     "Number of left and right side leaf nodes", nLeaf);
   cmd.AddValue ("animFile",  "File Name for Animation Output", animFile);
+  cmd.AddValue ("binary",    "Write a binary animation trace, animFile with .anim.gz for .xml (tools/anim-to-xml converts it)", binary);
 
   cmd.Parse (argc,argv);
   if (nLeaf > 0)
@@ -172,20 +177,34 @@ int main (int argc, char *argv[])
   // Set the bounding box for animation
 
 
-  // Create the animation object and configure for specified output
-  pAnim = new AnimationInterface (animFile); 
-  // Provide the absolute path to the resource
-  resourceId1 = pAnim->AddResource ("/Users/john/ns3/netanim-3.105/ns-3-logo1.png");
-  resourceId2 = pAnim->AddResource ("/Users/john/ns3/netanim-3.105/ns-3-logo2.png");
-  pAnim->SetBackgroundImage ("/Users/john/ns3/netanim-3.105/ns-3-background.png", 0, 0, 0.2, 0.2, 0.1);
-
-
-  // Add a node counter
-  nodeCounterIdUint32 = pAnim->AddNodeCounter ("Uint32 Counter", AnimationInterface::UINT32_COUNTER);
-  nodeCounterIdDouble1 = pAnim->AddNodeCounter ("Double Counter 1", AnimationInterface::DOUBLE_COUNTER);
-  nodeCounterIdDouble2 = pAnim->AddNodeCounter ("Double Counter 2", AnimationInterface::DOUBLE_COUNTER);
-
-  Simulator::Schedule (Seconds (0.1), modify);
+  if (binary)
+    {
+      // Only the updates that change something are written; no background image
+      animFile = animFile.substr (0, animFile.rfind (".xml")) + ".anim.gz";
+      pBinaryAnim = new BinaryAnimation (animFile);
+      resourceId1 = pBinaryAnim->AddResource ("/Users/john/ns3/netanim-3.105/ns-3-logo1.png");
+      resourceId2 = pBinaryAnim->AddResource ("/Users/john/ns3/netanim-3.105/ns-3-logo2.png");
+      nodeCounterIdUint32 = pBinaryAnim->AddNodeCounter ("Uint32 Counter", BinaryAnimation::UINT32_COUNTER);
+      nodeCounterIdDouble1 = pBinaryAnim->AddNodeCounter ("Double Counter 1", BinaryAnimation::DOUBLE_COUNTER);
+      nodeCounterIdDouble2 = pBinaryAnim->AddNodeCounter ("Double Counter 2", BinaryAnimation::DOUBLE_COUNTER);
+      Simulator::Schedule (Seconds (0.1), &modify<BinaryAnimation>, pBinaryAnim);
+    }
+  else
+    {
+      // Create the animation object and configure for specified output
+      pAnim = new AnimationInterface (animFile); 
+      // Provide the absolute path to the resource
+      resourceId1 = pAnim->AddResource ("/Users/john/ns3/netanim-3.105/ns-3-logo1.png");
+      resourceId2 = pAnim->AddResource ("/Users/john/ns3/netanim-3.105/ns-3-logo2.png");
+      pAnim->SetBackgroundImage ("/Users/john/ns3/netanim-3.105/ns-3-background.png", 0, 0, 0.2, 0.2, 0.1);
+
+      // Add a node counter
+      nodeCounterIdUint32 = pAnim->AddNodeCounter ("Uint32 Counter", AnimationInterface::UINT32_COUNTER);
+      nodeCounterIdDouble1 = pAnim->AddNodeCounter ("Double Counter 1", AnimationInterface::DOUBLE_COUNTER);
+      nodeCounterIdDouble2 = pAnim->AddNodeCounter ("Double Counter 2", AnimationInterface::DOUBLE_COUNTER);
+
+      Simulator::Schedule (Seconds (0.1), &modify<AnimationInterface>, pAnim);
+    }
   
   // Set up the acutal simulation
   Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
@@ -194,6 +213,7 @@ int main (int argc, char *argv[])
   std::cout << "Animation Trace file created:" << animFile.c_str ()<< std::endl;
   Simulator::Destroy ();
   delete pAnim;
+  delete pBinaryAnim;
   return 0;
 }
 
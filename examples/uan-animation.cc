@@ -42,6 +42,7 @@
 #include "ns3/netanim-module.h"
 #include "ns3/mobility-module.h"
 #include "ns3/applications-module.h"
+#include "../binary-animation.h"
 
 #include <fstream>
 
@@ -61,7 +62,10 @@ NetAnimExperiment::NetAnimExperiment ()
     m_cwStep (10),
     m_avgs (3),
     m_slotTime (Seconds (0.2)),
-    m_simTime (Seconds (1000))
+    m_simTime (Seconds (1000)),
+    m_binary (false),
+    m_chunkSeconds (0),
+    m_chunkMegabytes (0)
 {
 }
 
@@ -218,8 +222,18 @@ NetAnimExperiment::Run (UanHelper &uan)
 
     m_bytesTotal = 0;
 
-    std::string traceFileName = "uan-animation.xml";
-    AnimationInterface anim(traceFileName.c_str ());
+    AnimationInterface *anim = 0;
+    BinaryAnimation *binaryAnim = 0;
+    if (m_binary)
+      {
+        binaryAnim = new BinaryAnimation ("uan-animation.anim.gz");
+        binaryAnim->SetRotation (Seconds (m_chunkSeconds), m_chunkMegabytes * 1e6);
+      }
+    else
+      {
+        std::string traceFileName = "uan-animation.xml";
+        anim = new AnimationInterface (traceFileName.c_str ());
+      }
 
     Simulator::Run ();
     sinkNode = 0;
@@ -246,6 +260,8 @@ NetAnimExperiment::Run (UanHelper &uan)
       }
 
     Simulator::Destroy ();
+    delete anim;
+    delete binaryAnim;
   }
 }
 
@@ -273,6 +289,9 @@ main (int argc, char **argv)
   cmd.AddValue ("Averages", "Number of topologies to test for each cw point", exp.m_avgs);
   cmd.AddValue ("PerModel", "PER model name", perModel);
   cmd.AddValue ("SinrModel", "SINR model name", sinrModel);
+  cmd.AddValue ("Binary", "Write uan-animation.anim.gz (tools/anim-to-xml converts it to XML) instead of uan-animation.xml", exp.m_binary);
+  cmd.AddValue ("ChunkSeconds", "Binary animation: start a new file every so many simulated seconds (0: never)", exp.m_chunkSeconds);
+  cmd.AddValue ("ChunkMegabytes", "Binary animation: start a new file when the current one reaches so many megabytes before compression (0: never)", exp.m_chunkMegabytes);
   cmd.Parse (argc, argv);
 
   ObjectFactory obf;
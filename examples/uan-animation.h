@@ -53,6 +53,10 @@ public:
   Time m_slotTime;
   Time m_simTime;
 
+  bool m_binary;            //!< write a binary animation trace instead of XML
+  double m_chunkSeconds;    //!< binary trace: simulated seconds per file, 0 for no limit
+  double m_chunkMegabytes;  //!< binary trace: megabytes per file, 0 for no limit
+
   std::vector<double> m_throughputs;
 
   NetAnimExperiment ();
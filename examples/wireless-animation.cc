@@ -28,6 +28,7 @@
 #include "ns3/netanim-module.h"
 #include "ns3/basic-energy-source.h"
 #include "ns3/simple-device-energy-model.h"
+#include "../binary-animation.h"
 
 
 
@@ -35,12 +36,41 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("WirelessAnimationExample");
 
+template <typename Animation>
+static void
+DescribeNodes (Animation &anim, NodeContainer wifiStaNodes, NodeContainer wifiApNode, NodeContainer csmaNodes)
+{
+  for (uint32_t i = 0; i < wifiStaNodes.GetN (); ++i)
+    {
+      anim.UpdateNodeDescription (wifiStaNodes.Get (i), "STA"); // Optional
+      anim.UpdateNodeColor (wifiStaNodes.Get (i), 255, 0, 0); // Optional
+    }
+  for (uint32_t i = 0; i < wifiApNode.GetN (); ++i)
+    {
+      anim.UpdateNodeDescription (wifiApNode.Get (i), "AP"); // Optional
+      anim.UpdateNodeColor (wifiApNode.Get (i), 0, 255, 0); // Optional
+    }
+  for (uint32_t i = 0; i < csmaNodes.GetN (); ++i)
+    {
+      anim.UpdateNodeDescription (csmaNodes.Get (i), "CSMA"); // Optional
+      anim.UpdateNodeColor (csmaNodes.Get (i), 0, 0, 255); // Optional 
+    }
+}
+
 int 
 main (int argc, char *argv[])
 {
   uint32_t nWifi = 20;
+  bool binary = false;
+  double minInterval = 0;
+  double minDistance = 0;
+  double tolerance = -1;
   CommandLine cmd;
   cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
+  cmd.AddValue ("binary", "Write wireless-animation.anim.gz (tools/anim-to-xml converts it to XML) instead of wireless-animation.xml", binary);
+  cmd.AddValue ("minInterval", "Binary animation: seconds between two positions of a node, at least", minInterval);
+  cmd.AddValue ("minDistance", "Binary animation: metres between two positions of a node, at least", minDistance);
+  cmd.AddValue ("tolerance", "Binary animation: linear-segment compression, metres a node may stray from its line (negative: off)", tolerance);
   
 
   cmd.Parse (argc,argv);
@@ -164,28 +194,28 @@ main (int argc, char *argv[])
   Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
   Simulator::Stop (Seconds (15.0));
 
-  AnimationInterface anim ("wireless-animation.xml"); // Mandatory
-  for (uint32_t i = 0; i < wifiStaNodes.GetN (); ++i)
+  AnimationInterface *anim = 0;
+  BinaryAnimation *binaryAnim = 0;
+  if (binary)
     {
-      anim.UpdateNodeDescription (wifiStaNodes.Get (i), "STA"); // Optional
-      anim.UpdateNodeColor (wifiStaNodes.Get (i), 255, 0, 0); // Optional
+      // The positions of the random-walk STAs, decimated; no routing tables or counters
+      binaryAnim = new BinaryAnimation ("wireless-animation.anim.gz");
+      binaryAnim->SetPositionDecimation (Seconds (minInterval), minDistance, tolerance);
+      DescribeNodes (*binaryAnim, wifiStaNodes, wifiApNode, csmaNodes);
+      binaryAnim->EnablePacketMetadata (); // Optional
     }
-  for (uint32_t i = 0; i < wifiApNode.GetN (); ++i)
+  else
     {
-      anim.UpdateNodeDescription (wifiApNode.Get (i), "AP"); // Optional
-      anim.UpdateNodeColor (wifiApNode.Get (i), 0, 255, 0); // Optional
+      anim = new AnimationInterface ("wireless-animation.xml"); // Mandatory
+      DescribeNodes (*anim, wifiStaNodes, wifiApNode, csmaNodes);
+      anim->EnablePacketMetadata (); // Optional
+      anim->EnableIpv4RouteTracking ("routingtable-wireless.xml", Seconds (0), Seconds (5), Seconds (0.25)); //Optional
+      anim->EnableWifiMacCounters (Seconds (0), Seconds (10)); //Optional
+      anim->EnableWifiPhyCounters (Seconds (0), Seconds (10)); //Optional
     }
-  for (uint32_t i = 0; i < csmaNodes.GetN (); ++i)
-    {
-      anim.UpdateNodeDescription (csmaNodes.Get (i), "CSMA"); // Optional
-      anim.UpdateNodeColor (csmaNodes.Get (i), 0, 0, 255); // Optional 
-    }
-
-  anim.EnablePacketMetadata (); // Optional
-  anim.EnableIpv4RouteTracking ("routingtable-wireless.xml", Seconds (0), Seconds (5), Seconds (0.25)); //Optional
-  anim.EnableWifiMacCounters (Seconds (0), Seconds (10)); //Optional
-  anim.EnableWifiPhyCounters (Seconds (0), Seconds (10)); //Optional
   Simulator::Run ();
   Simulator::Destroy ();
+  delete anim;
+  delete binaryAnim;
   return 0;
 }
@@ -0,0 +1,171 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/openflow-module.h"
+
+#include "trace-capture.h"
+
+#include <deque>
+
+namespace ns3 {
+
+/**
+ * \brief Triggers the flight recorder of a TraceCapture when FlowMonitor sees new losses.
+ *
+ * Every interval the lost and dropped packets of all the flows are summed;
+ * the capture is triggered when the sum grew.  FlowMonitor only declares a
+ * packet lost after MaxPerHopDelay without news of it, while the drops
+ * (packetsDropped) are counted as they happen, so the first are best
+ * caught with a window that long.
+ */
+class FlowLossTrigger
+{
+public:
+  FlowLossTrigger (TraceCapture *capture, Ptr<FlowMonitor> monitor);
+
+  /// Check every interval from now on.
+  void Start (Time interval);
+
+private:
+  void Check (void);
+
+  TraceCapture *m_capture;
+  Ptr<FlowMonitor> m_monitor;
+  Time m_interval;
+  uint64_t m_lost;
+};
+
+/**
+ * \brief A LearningController that triggers a TraceCapture on packet-in bursts.
+ *
+ * Behaves as ofi::LearningController; once SetTrigger () is called, more
+ * than burst OFPT_PACKET_IN messages from its switches within window
+ * trigger the flight recorder of the capture (a table miss storm, e.g.
+ * after the flows expired).
+ */
+class PacketInTriggerController : public ofi::LearningController
+{
+public:
+  static TypeId GetTypeId (void);
+  PacketInTriggerController ();
+
+  void SetTrigger (TraceCapture *capture, uint32_t burst, Time window);
+  virtual void ReceiveFromSwitch (Ptr<OpenFlowSwitchNetDevice> swtch, ofpbuf *buffer);
+
+private:
+  TraceCapture *m_capture;
+  uint32_t m_burst;
+  Time m_window;
+  std::deque<Time> m_packetIns;     //!< arrival times within the window
+};
+
+
+inline
+FlowLossTrigger::FlowLossTrigger (TraceCapture *capture, Ptr<FlowMonitor> monitor)
+  : m_capture (capture),
+    m_monitor (monitor),
+    m_lost (0)
+{
+}
+
+inline void
+FlowLossTrigger::Start (Time interval)
+{
+  m_interval = interval;
+  if (m_interval.IsStrictlyPositive ())
+    {
+      Simulator::Schedule (m_interval, &FlowLossTrigger::Check, this);
+    }
+}
+
+inline void
+FlowLossTrigger::Check (void)
+{
+  m_monitor->CheckForLostPackets ();
+  uint64_t lost = 0;
+  const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats ();
+  for (FlowMonitor::FlowStatsContainerCI i = stats.begin (); i != stats.end (); ++i)
+    {
+      lost += i->second.lostPackets;
+      for (std::vector<uint32_t>::const_iterator d = i->second.packetsDropped.begin ();
+           d != i->second.packetsDropped.end (); ++d)
+        {
+          lost += *d;
+        }
+    }
+  if (lost > m_lost)
+    {
+      m_capture->Trigger ("flowmon-loss");
+    }
+  m_lost = lost;
+  Simulator::Schedule (m_interval, &FlowLossTrigger::Check, this);
+}
+
+
+inline TypeId
+PacketInTriggerController::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PacketInTriggerController")
+    .SetParent<ofi::LearningController> ()
+    .AddConstructor<PacketInTriggerController> ()
+  ;
+  return tid;
+}
+
+inline
+PacketInTriggerController::PacketInTriggerController ()
+  : m_capture (0),
+    m_burst (0)
+{
+}
+
+inline void
+PacketInTriggerController::SetTrigger (TraceCapture *capture, uint32_t burst, Time window)
+{
+  m_capture = capture;
+  m_burst = burst;
+  m_window = window;
+}
+
+inline void
+PacketInTriggerController::ReceiveFromSwitch (Ptr<OpenFlowSwitchNetDevice> swtch, ofpbuf *buffer)
+{
+  if (m_capture != 0 && buffer->size >= sizeof (ofp_header)
+      && static_cast<ofp_header *> (buffer->data)->type == OFPT_PACKET_IN)
+    {
+      Time now = Simulator::Now ();
+      while (!m_packetIns.empty () && m_packetIns.front () + m_window < now)
+        {
+          m_packetIns.pop_front ();
+        }
+      m_packetIns.push_back (now);
+      if (m_packetIns.size () > m_burst)
+        {
+          m_capture->Trigger ("packet-in-burst");
+          m_packetIns.clear ();
+        }
+    }
+  LearningController::ReceiveFromSwitch (swtch, buffer);
+}
+
+} // namespace ns3
+
+#endif /* FLIGHT_RECORDER_H */
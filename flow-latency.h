@@ -0,0 +1,365 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_LATENCY_H
+#define FLOW_LATENCY_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/flow-monitor-module.h"
+
+#include "flow-selector.h"
+#include "hdr-histogram.h"
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Latency percentiles of one flow, in seconds.
+ */
+struct FlowLatency
+{
+  uint64_t count;   //!< packets the percentiles are computed from
+  double p50;
+  double p90;
+  double p99;
+  double p999;
+  double max;
+};
+
+/**
+ * \brief Per-packet end-to-end delay histograms of the selected flows.
+ *
+ * The delay of every packet is taken at the receiving node (Ipv4L3Protocol
+ * LocalDeliver) from the SeqTsHeader timestamp that UdpClient puts in the
+ * payload, and recorded in two fixed-size HdrHistograms per flow: one for the
+ * current sampling window and one for the whole run.  Only the UDP flows
+ * sent by a UdpClient (from its node to its RemoteAddress and RemotePort)
+ * are read that way, and a negative delay or one past the histogram range
+ * is counted as rejected (see Print ()), not recorded.  Other sources of
+ * per-packet delays can call RecordDelay () directly.
+ */
+class FlowLatencyTracker : public SimpleRefCount<FlowLatencyTracker>
+{
+public:
+  /// The range of the histograms, in nanoseconds: 1 us to 100 s.
+  static const uint64_t MIN_DELAY_NS = 1000;
+  static const uint64_t MAX_DELAY_NS = UINT64_C (100000000000);
+
+  /// The histograms of one flow.
+  class Flow
+  {
+  public:
+    Flow (const Ipv4FlowClassifier::FiveTuple &tuple, int significantFigures);
+
+    void Record (Time delay);
+    FlowLatency GetWindow (void) const;
+    FlowLatency GetTotal (void) const;
+    void EndWindow (void);
+
+    Ipv4FlowClassifier::FiveTuple tuple;
+
+  private:
+    static FlowLatency Summarize (const HdrHistogram &h);
+
+    HdrHistogram m_window;
+    HdrHistogram m_total;
+  };
+
+  /**
+   * \param selector only the flows it matches get histograms
+   * \param significantFigures precision of the percentiles (2 is 1%)
+   */
+  FlowLatencyTracker (const FlowSelector &selector, int significantFigures = 2);
+  ~FlowLatencyTracker ();
+
+  /// Take the delay of the packets delivered locally on node (e.g. the UdpServer node).
+  void Install (Ptr<Node> node);
+  void Install (NodeContainer nodes);
+
+  void RecordDelay (const Ipv4FlowClassifier::FiveTuple &t, Time delay);
+  /// The histograms of the flow, 0 if the selector does not match it.
+  Flow *Find (const Ipv4FlowClassifier::FiveTuple &t);
+  /// Start a new window for every flow.
+  void EndWindow (void);
+  /// Print the whole-run percentiles of every flow, and how many delays were rejected.
+  void Print (std::ostream &os) const;
+
+private:
+  FlowLatencyTracker (const FlowLatencyTracker &);
+  FlowLatencyTracker &operator= (const FlowLatencyTracker &);
+
+  void LocalDeliver (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface);
+  /// Collect the (source, destination, port) of every UdpClient, once the applications are installed.
+  void FindUdpClients (void);
+
+  /// The source address, destination address and destination port of a UdpClient flow.
+  typedef std::pair<std::pair<Ipv4Address, Ipv4Address>, uint16_t> UdpClientFlow;
+
+  FlowSelector m_selector;
+  int m_significantFigures;
+  bool m_clientsFound;
+  std::set<UdpClientFlow> m_clients;
+  uint64_t m_rejected;          //!< delays out of the histogram range
+  /// index in m_flows, -1 for the five-tuples the selector does not match
+  std::map<Ipv4FlowClassifier::FiveTuple, int32_t> m_index;
+  std::vector<Flow *> m_flows;
+};
+
+
+inline
+FlowLatencyTracker::Flow::Flow (const Ipv4FlowClassifier::FiveTuple &t, int significantFigures)
+  : tuple (t),
+    m_window (MIN_DELAY_NS, MAX_DELAY_NS, significantFigures),
+    m_total (MIN_DELAY_NS, MAX_DELAY_NS, significantFigures)
+{
+}
+
+inline void
+FlowLatencyTracker::Flow::Record (Time delay)
+{
+  uint64_t ns = delay.IsPositive () ? delay.GetNanoSeconds () : 0;
+  m_window.Record (ns);
+  m_total.Record (ns);
+}
+
+inline FlowLatency
+FlowLatencyTracker::Flow::Summarize (const HdrHistogram &h)
+{
+  FlowLatency l;
+  l.count = h.GetCount ();
+  l.p50 = h.GetValueAtPercentile (50) / 1e9;
+  l.p90 = h.GetValueAtPercentile (90) / 1e9;
+  l.p99 = h.GetValueAtPercentile (99) / 1e9;
+  l.p999 = h.GetValueAtPercentile (99.9) / 1e9;
+  l.max = h.GetMax () / 1e9;
+  return l;
+}
+
+inline FlowLatency
+FlowLatencyTracker::Flow::GetWindow (void) const
+{
+  return Summarize (m_window);
+}
+
+inline FlowLatency
+FlowLatencyTracker::Flow::GetTotal (void) const
+{
+  return Summarize (m_total);
+}
+
+inline void
+FlowLatencyTracker::Flow::EndWindow (void)
+{
+  if (m_window.GetCount () > 0)
+    {
+      m_window.Reset ();
+    }
+}
+
+
+inline
+FlowLatencyTracker::FlowLatencyTracker (const FlowSelector &selector, int significantFigures)
+  : m_selector (selector),
+    m_significantFigures (significantFigures),
+    m_clientsFound (false),
+    m_rejected (0)
+{
+}
+
+inline
+FlowLatencyTracker::~FlowLatencyTracker ()
+{
+  for (std::vector<Flow *>::iterator f = m_flows.begin (); f != m_flows.end (); ++f)
+    {
+      delete *f;
+    }
+}
+
+inline void
+FlowLatencyTracker::Install (Ptr<Node> node)
+{
+  std::ostringstream path;
+  path << "/NodeList/" << node->GetId () << "/$ns3::Ipv4L3Protocol/LocalDeliver";
+  Config::ConnectWithoutContext (path.str (), MakeCallback (&FlowLatencyTracker::LocalDeliver, this));
+}
+
+inline void
+FlowLatencyTracker::Install (NodeContainer nodes)
+{
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+    {
+      Install (*i);
+    }
+}
+
+inline FlowLatencyTracker::Flow *
+FlowLatencyTracker::Find (const Ipv4FlowClassifier::FiveTuple &t)
+{
+  std::map<Ipv4FlowClassifier::FiveTuple, int32_t>::iterator i = m_index.find (t);
+  if (i == m_index.end ())
+    {
+      /* first packet of this five-tuple: match it once */
+      int32_t index = -1;
+      if (m_selector.Matches (t))
+        {
+          index = m_flows.size ();
+          m_flows.push_back (new Flow (t, m_significantFigures));
+        }
+      i = m_index.insert (std::make_pair (t, index)).first;
+    }
+  return i->second < 0 ? 0 : m_flows[i->second];
+}
+
+inline void
+FlowLatencyTracker::RecordDelay (const Ipv4FlowClassifier::FiveTuple &t, Time delay)
+{
+  Flow *flow = Find (t);
+  if (flow != 0)
+    {
+      flow->Record (delay);
+    }
+}
+
+inline void
+FlowLatencyTracker::EndWindow (void)
+{
+  for (std::vector<Flow *>::iterator f = m_flows.begin (); f != m_flows.end (); ++f)
+    {
+      (*f)->EndWindow ();
+    }
+}
+
+inline void
+FlowLatencyTracker::LocalDeliver (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+{
+  /* UDP_PROT_NUMBER = 17, only UdpClient packets carry a SeqTsHeader */
+  if (header.GetProtocol () != 17)
+    {
+      return;
+    }
+  if (!m_clientsFound)
+    {
+      FindUdpClients ();
+    }
+  UdpHeader udp;
+  SeqTsHeader seqTs;
+  if (packet->GetSize () < udp.GetSerializedSize () + seqTs.GetSerializedSize ())
+    {
+      return;
+    }
+  Ptr<Packet> copy = packet->Copy ();
+  copy->RemoveHeader (udp);
+
+  Ipv4FlowClassifier::FiveTuple t;
+  t.sourceAddress = header.GetSource ();
+  t.destinationAddress = header.GetDestination ();
+  t.protocol = header.GetProtocol ();
+  t.sourcePort = udp.GetSourcePort ();
+  t.destinationPort = udp.GetDestinationPort ();
+  /* other UDP flows (OLSR, DNS...) carry no timestamp */
+  UdpClientFlow client (std::make_pair (t.sourceAddress, t.destinationAddress), t.destinationPort);
+  if (m_clients.count (client) == 0)
+    {
+      return;
+    }
+  Flow *flow = Find (t);
+  if (flow == 0)
+    {
+      return;
+    }
+  copy->PeekHeader (seqTs);
+  Time delay = Simulator::Now () - seqTs.GetTs ();
+  if (delay.IsStrictlyNegative () || delay.GetNanoSeconds () > int64_t (MAX_DELAY_NS))
+    {
+      m_rejected++;
+      return;
+    }
+  flow->Record (delay);
+}
+
+inline void
+FlowLatencyTracker::FindUdpClients (void)
+{
+  m_clientsFound = true;
+  for (uint32_t n = 0; n < NodeList::GetNNodes (); n++)
+    {
+      Ptr<Node> node = NodeList::GetNode (n);
+      Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+      if (ipv4 == 0)
+        {
+          continue;
+        }
+      for (uint32_t a = 0; a < node->GetNApplications (); a++)
+        {
+          Ptr<UdpClient> client = DynamicCast<UdpClient> (node->GetApplication (a));
+          if (client == 0)
+            {
+              continue;
+            }
+          AddressValue remote;
+          UintegerValue port;
+          client->GetAttribute ("RemoteAddress", remote);
+          client->GetAttribute ("RemotePort", port);
+          if (!Ipv4Address::IsMatchingType (remote.Get ()))
+            {
+              continue;
+            }
+          Ipv4Address destination = Ipv4Address::ConvertFrom (remote.Get ());
+          uint16_t destinationPort = port.Get ();
+          for (uint32_t i = 0; i < ipv4->GetNInterfaces (); i++)
+            {
+              for (uint32_t j = 0; j < ipv4->GetNAddresses (i); j++)
+                {
+                  Ipv4Address source = ipv4->GetAddress (i, j).GetLocal ();
+                  m_clients.insert (std::make_pair (std::make_pair (source, destination), destinationPort));
+                }
+            }
+        }
+    }
+}
+
+inline void
+FlowLatencyTracker::Print (std::ostream &os) const
+{
+  for (std::vector<Flow *>::const_iterator f = m_flows.begin (); f != m_flows.end (); ++f)
+    {
+      FlowLatency l = (*f)->GetTotal ();
+      os << "Latency (" << (*f)->tuple.sourceAddress << ":" << (*f)->tuple.sourcePort
+         << " -> " << (*f)->tuple.destinationAddress << ":" << (*f)->tuple.destinationPort << "), "
+         << l.count << " packets: "
+         << "p50 " << l.p50 * 1000 << " ms, "
+         << "p90 " << l.p90 * 1000 << " ms, "
+         << "p99 " << l.p99 * 1000 << " ms, "
+         << "p99.9 " << l.p999 * 1000 << " ms, "
+         << "max " << l.max * 1000 << " ms" << std::endl;
+    }
+  if (m_rejected > 0)
+    {
+      os << "Latency: " << m_rejected << " delays out of range (negative or over 100 s) were not recorded" << std::endl;
+    }
+}
+
+} // namespace ns3
+
+#endif /* FLOW_LATENCY_H */
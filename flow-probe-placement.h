@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_PROBE_PLACEMENT_H
+#define FLOW_PROBE_PLACEMENT_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/flow-monitor-module.h"
+
+#include <cstdlib>
+#include <set>
+#include <sstream>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \brief Chooses the nodes FlowMonitorHelper puts its Ipv4FlowProbes on.
+ *
+ * InstallAll () puts a probe (and the per-packet tag handling that comes
+ * with it) on every node, so the cost grows with the size of the network.
+ * In endpoint mode only the nodes that source or sink the flows of interest
+ * get a probe, plus the transit nodes named explicitly.
+ *
+ * The end-to-end stats stay correct with the endpoints alone: the source
+ * probe tags the packets and records the tx side, the sink probe records
+ * the rx side and the delay, and packets that never arrive are still
+ * declared lost by CheckForLostPackets () once MaxPerHopDelay has passed.
+ * What needs transit probes is the per-hop detail: timesForwarded, the
+ * drop reason of a packet lost on the way, and the per-probe stats.
+ */
+class FlowProbePlacement
+{
+public:
+  FlowProbePlacement ();
+
+  /// Only probe the endpoints and transit nodes (InstallAll () otherwise).
+  void SetEndpointsOnly (bool enable);
+  bool IsEndpointsOnly (void) const;
+
+  /// The nodes these applications run on source or sink flows.
+  void AddEndpoints (const ApplicationContainer &apps);
+  void AddEndpoint (Ptr<Node> node);
+  void AddTransit (Ptr<Node> node);
+  /**
+   * Transit nodes given by id, separated by commas (e.g. "2,4"), as on the
+   * command line; the ids are checked by Install ().  False on a bad number.
+   */
+  bool ParseTransit (std::string spec);
+
+  /// Install the probes; returns the monitor as FlowMonitorHelper does.
+  Ptr<FlowMonitor> Install (FlowMonitorHelper &helper) const;
+
+private:
+  bool m_endpointsOnly;
+  std::set<uint32_t> m_nodes;     //!< node ids, endpoints and transit nodes
+};
+
+
+inline
+FlowProbePlacement::FlowProbePlacement ()
+  : m_endpointsOnly (false)
+{
+}
+
+inline void
+FlowProbePlacement::SetEndpointsOnly (bool enable)
+{
+  m_endpointsOnly = enable;
+}
+
+inline bool
+FlowProbePlacement::IsEndpointsOnly (void) const
+{
+  return m_endpointsOnly;
+}
+
+inline void
+FlowProbePlacement::AddEndpoints (const ApplicationContainer &apps)
+{
+  for (uint32_t i = 0; i < apps.GetN (); i++)
+    {
+      AddEndpoint (apps.Get (i)->GetNode ());
+    }
+}
+
+inline void
+FlowProbePlacement::AddEndpoint (Ptr<Node> node)
+{
+  m_nodes.insert (node->GetId ());
+}
+
+inline void
+FlowProbePlacement::AddTransit (Ptr<Node> node)
+{
+  m_nodes.insert (node->GetId ());
+}
+
+inline bool
+FlowProbePlacement::ParseTransit (std::string spec)
+{
+  std::istringstream is (spec);
+  std::string id;
+  while (std::getline (is, id, ','))
+    {
+      if (id.empty ())
+        {
+          continue;
+        }
+      char *end;
+      long value = std::strtol (id.c_str (), &end, 10);
+      if (*end != '\0' || value < 0)
+        {
+          return false;
+        }
+      m_nodes.insert (value);
+    }
+  return true;
+}
+
+inline Ptr<FlowMonitor>
+FlowProbePlacement::Install (FlowMonitorHelper &helper) const
+{
+  if (!m_endpointsOnly)
+    {
+      return helper.InstallAll ();
+    }
+  NodeContainer nodes;
+  for (std::set<uint32_t>::const_iterator id = m_nodes.begin (); id != m_nodes.end (); ++id)
+    {
+      NS_ABORT_MSG_UNLESS (*id < NodeList::GetNNodes (), "No node " << *id << " to put a flow probe on");
+      Ptr<Node> node = NodeList::GetNode (*id);
+      /* FlowMonitorHelper::Install () skips the nodes without IPv4 as well */
+      if (node->GetObject<Ipv4> () != 0)
+        {
+          nodes.Add (node);
+        }
+    }
+  NS_ABORT_MSG_IF (nodes.GetN () == 0, "Endpoint flow probes requested but no endpoint was given");
+  return helper.Install (nodes);
+}
+
+} // namespace ns3
+
+#endif /* FLOW_PROBE_PLACEMENT_H */
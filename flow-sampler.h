@@ -0,0 +1,760 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_SAMPLER_H
+#define FLOW_SAMPLER_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/stats-module.h"
+
+#include "async-reporter.h"
+#include "flow-latency.h"
+#include "flow-selector.h"
+#include "flow-table.h"
+#include "time-series-writer.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief The metrics of one flow over one sampling window.
+ */
+struct FlowWindow
+{
+  Time duration;       //!< length of the window
+  uint32_t rxPackets;  //!< packets received in the window
+  double throughput;   //!< Kbps received in the window
+  double delay;        //!< mean delay per received packet, in seconds
+  double jitter;       //!< mean jitter per received packet, in seconds
+  double lostPackets;  //!< packets declared lost in the window
+};
+
+/**
+ * \brief The metrics of one flow, computed from one FlowMonitor snapshot.
+ *
+ * The cumulative values are what the old monitors plotted; `window` holds the
+ * deltas since the previous sample and `smoothed` their EWMA (equal to
+ * `window` when the EWMA is disabled).
+ */
+struct FlowSample
+{
+  Time time;                                //!< simulation time of the sample
+  FlowId flowId;                            //!< the sampled flow
+  Ipv4FlowClassifier::FiveTuple tuple;      //!< five-tuple of the flow
+  const FlowMonitor::FlowStats *stats;      //!< the stats the metrics come from
+
+  double throughput;   //!< Kbps, rxBytes over (timeLastRxPacket - timeFirstTxPacket)
+  double delay;        //!< delaySum, in seconds
+  double lostPackets;  //!< lostPackets
+  double jitter;       //!< jitterSum, in seconds
+
+  FlowWindow window;   //!< values over the last sampling window
+  FlowWindow smoothed; //!< EWMA of the window values
+
+  bool last;                 //!< from FlowSampler::Finish (): the state of the flow when the run stopped
+  bool hasLatency;           //!< a FlowLatencyTracker follows this flow
+  FlowLatency windowLatency; //!< delay percentiles of the packets received in the window
+  FlowLatency totalLatency;  //!< delay percentiles since the start of the run
+};
+
+/**
+ * \brief Receives the samples produced by a FlowSampler.
+ *
+ * Record () is called once per watched flow and per sampling pass,
+ * RecordNetwork () once per pass when the sampler has a FlowTable,
+ * EndOfPass () once after every pass, Finish () once after Simulator::Run ().
+ */
+class FlowSampleSink : public SimpleRefCount<FlowSampleSink>
+{
+public:
+  virtual ~FlowSampleSink () {}
+  virtual void Record (const FlowSample &sample) = 0;
+  virtual void RecordNetwork (const NetworkSummary &summary) {}
+  virtual void EndOfPass (Time now) {}
+  virtual void Finish (void) {}
+};
+
+/**
+ * \brief Samples the FlowMonitor once per period and feeds every sink.
+ *
+ * Replaces the ThroughputMonitor/DelayMonitor/LostPacketsMonitor/JitterMonitor/
+ * PrintParams chains: CheckForLostPackets () and the flow lookup are done once
+ * per pass instead of once per metric.
+ *
+ * New flows are classified once against the FlowSelector; the selected ones
+ * keep an iterator to their stats, so a pass only touches the watched flows.
+ */
+class FlowSampler
+{
+public:
+  FlowSampler (FlowMonitorHelper *fmhelper, Ptr<FlowMonitor> monitor);
+
+  /**
+   * Only sample the flows matched by the selector.  Every flow is matched
+   * once, the first time it shows up in the FlowMonitor stats.
+   */
+  void SetSelector (const FlowSelector &selector);
+  /**
+   * Smooth the window values with an EWMA: smoothed = alpha * window + (1 - alpha) * smoothed.
+   * alpha = 0 (the default) disables the smoothing.
+   */
+  void SetEwma (double alpha);
+  /// Fill the latency percentiles of the samples from this tracker.
+  void SetLatencyTracker (Ptr<FlowLatencyTracker> tracker);
+  /**
+   * Also update this table of all the flows at every pass and give its
+   * network-wide aggregates to the sinks ("all flows" mode).
+   */
+  void SetFlowTable (Ptr<FlowTable> table);
+  void AddSink (Ptr<FlowSampleSink> sink);
+
+  /// Take the first sample now and then one every period.
+  void Start (Time period);
+  /**
+   * Give the sinks the samples of the time the run stopped, flagged as
+   * last, and notify them that the run is over; call after
+   * Simulator::Run ().  When the run stopped right after a pass (a sink
+   * called Simulator::Stop (), e.g. SteadyStateStopper), the samples of
+   * that pass are given again rather than taken anew.
+   */
+  void Finish (void);
+
+private:
+  /// What is remembered of a flow between two samples.
+  struct FlowHistory
+  {
+    Time time;
+    uint64_t rxBytes;
+    uint32_t rxPackets;
+    uint32_t lostPackets;
+    Time delaySum;
+    Time jitterSum;
+    bool primed;         //!< smoothed holds a value
+    FlowWindow smoothed;
+  };
+
+  /// A selected flow, resolved once.
+  struct WatchedFlow
+  {
+    FlowId flowId;
+    Ipv4FlowClassifier::FiveTuple tuple;
+    FlowMonitor::FlowStatsContainerCI stats;  //!< std::map iterators stay valid on insert
+    FlowHistory history;
+    FlowLatencyTracker::Flow *latency;        //!< 0 without a tracker
+  };
+
+  void Sample (void);
+  void Pass (bool last);
+  void ResolveNewFlows (const FlowMonitor::FlowStatsContainer &flowStats);
+  void Resolve (FlowMonitor::FlowStatsContainerCI i, Ptr<Ipv4FlowClassifier> classifier);
+  void ComputeWindow (FlowSample &sample, FlowHistory &history);
+
+  FlowMonitorHelper *m_fmhelper;
+  Ptr<FlowMonitor> m_monitor;
+  Time m_period;
+  Time m_lastPass;
+
+  FlowSelector m_selector;
+  double m_alpha;
+  Ptr<FlowLatencyTracker> m_latency;
+  Ptr<FlowTable> m_table;
+
+  std::vector<bool> m_seen;      //!< indexed by FlowId
+  uint32_t m_nSeen;
+  FlowId m_maxSeen;
+  std::vector<WatchedFlow> m_watched;
+  std::vector<Ptr<FlowSampleSink> > m_sinks;
+  std::vector<FlowSample> m_samples;  //!< of the last pass, for Finish ()
+};
+
+/**
+ * \brief Streams every sample to a binary time-series file while the
+ * simulation runs (see time-series-writer.h).
+ *
+ * Both the cumulative and the per-window (smoothed) values are written;
+ * tools/ts-export.cc turns the file into gnuplot or CSV afterwards.  The
+ * records are also pushed to the file every flushInterval of simulated time,
+ * so a crash loses at most that much even when a chunk is not yet full.
+ */
+class TimeSeriesSampleSink : public FlowSampleSink
+{
+public:
+  TimeSeriesSampleSink (std::string filename, uint32_t chunkRecords = 4096,
+                        Time flushInterval = Seconds (1));
+
+  virtual void Record (const FlowSample &sample);
+  virtual void RecordNetwork (const NetworkSummary &summary);
+  virtual void EndOfPass (Time now);
+  virtual void Finish (void);
+
+private:
+  TimeSeriesWriter m_writer;
+  Time m_flushInterval;
+  Time m_nextFlush;
+  Time m_lastPass;     //!< already written when the last samples repeat it
+};
+
+/**
+ * \brief Reports the samples through an AsyncReporter, at most once per
+ * interval (what PrintParams used to do on std::cout).
+ *
+ * The lines are formatted into a reused buffer on the simulator thread and
+ * written out by the reporter thread, so the event loop never waits on the
+ * terminal or a pipe.  TEXT keeps the PrintParams layout, JSON writes one
+ * object per line for log collectors.
+ */
+class ReportSampleSink : public FlowSampleSink
+{
+public:
+  enum Format
+  {
+    TEXT,
+    JSON
+  };
+
+  ReportSampleSink (AsyncReporter *reporter, Time interval, Format format = TEXT);
+
+  virtual void Record (const FlowSample &sample);
+  virtual void RecordNetwork (const NetworkSummary &summary);
+  virtual void EndOfPass (Time now);
+
+private:
+  void Append (const char *format, ...);
+  static std::string AddressToString (Ipv4Address address);
+  void FormatText (const FlowSample &sample);
+  void FormatJson (const FlowSample &sample);
+
+  AsyncReporter *m_reporter;
+  Time m_interval;
+  Time m_next;
+  Time m_reportedAt;   //!< time of the last flow lines written
+  Format m_format;
+  std::string m_line;
+};
+
+
+inline
+FlowSampler::FlowSampler (FlowMonitorHelper *fmhelper, Ptr<FlowMonitor> monitor)
+  : m_fmhelper (fmhelper),
+    m_monitor (monitor),
+    m_period (Seconds (1)),
+    m_alpha (0),
+    m_nSeen (0),
+    m_maxSeen (0)
+{
+}
+
+inline void
+FlowSampler::SetSelector (const FlowSelector &selector)
+{
+  m_selector = selector;
+}
+
+inline void
+FlowSampler::SetEwma (double alpha)
+{
+  NS_ASSERT_MSG (alpha >= 0 && alpha <= 1, "EWMA weight must be in [0, 1]");
+  m_alpha = alpha;
+}
+
+inline void
+FlowSampler::SetLatencyTracker (Ptr<FlowLatencyTracker> tracker)
+{
+  m_latency = tracker;
+}
+
+inline void
+FlowSampler::SetFlowTable (Ptr<FlowTable> table)
+{
+  m_table = table;
+}
+
+inline void
+FlowSampler::AddSink (Ptr<FlowSampleSink> sink)
+{
+  m_sinks.push_back (sink);
+}
+
+inline void
+FlowSampler::Start (Time period)
+{
+  m_period = period;
+  Sample ();
+}
+
+inline void
+FlowSampler::Finish (void)
+{
+  if (Simulator::Now () > m_lastPass)
+    {
+      Pass (true);
+    }
+  else
+    {
+      /* stopped by the last pass itself: it was the final one */
+      for (std::vector<FlowSample>::iterator i = m_samples.begin (); i != m_samples.end (); ++i)
+        {
+          i->last = true;
+          for (std::vector<Ptr<FlowSampleSink> >::const_iterator s = m_sinks.begin (); s != m_sinks.end (); ++s)
+            {
+              (*s)->Record (*i);
+            }
+        }
+      if (m_table)
+        {
+          for (std::vector<Ptr<FlowSampleSink> >::const_iterator s = m_sinks.begin (); s != m_sinks.end (); ++s)
+            {
+              (*s)->RecordNetwork (m_table->GetSummary ());
+            }
+        }
+    }
+  for (std::vector<Ptr<FlowSampleSink> >::const_iterator s = m_sinks.begin (); s != m_sinks.end (); ++s)
+    {
+      (*s)->Finish ();
+    }
+}
+
+inline void
+FlowSampler::Sample (void)
+{
+  Pass (false);
+  Simulator::Schedule (m_period, &FlowSampler::Sample, this);
+}
+
+inline void
+FlowSampler::Pass (bool last)
+{
+  Time now = Simulator::Now ();
+  m_lastPass = now;
+  m_monitor->CheckForLostPackets ();
+  /* GetFlowStats () returns a reference, no need to copy the whole map */
+  const FlowMonitor::FlowStatsContainer &flowStats = m_monitor->GetFlowStats ();
+  if (flowStats.size () != m_nSeen)
+    {
+      ResolveNewFlows (flowStats);
+    }
+
+  m_samples.clear ();
+  for (std::vector<WatchedFlow>::iterator w = m_watched.begin (); w != m_watched.end (); ++w)
+    {
+      const FlowMonitor::FlowStats &st = w->stats->second;
+      FlowSample sample;
+      sample.time = now;
+      sample.flowId = w->flowId;
+      sample.tuple = w->tuple;
+      sample.stats = &st;
+      sample.throughput = st.rxBytes * 8.0 / (st.timeLastRxPacket.GetSeconds () - st.timeFirstTxPacket.GetSeconds ()) / 1024;
+      sample.delay = st.delaySum.GetSeconds ();
+      sample.lostPackets = st.lostPackets;
+      sample.jitter = st.jitterSum.GetSeconds ();
+      sample.last = last;
+      ComputeWindow (sample, w->history);
+      sample.hasLatency = (w->latency != 0);
+      if (sample.hasLatency)
+        {
+          sample.windowLatency = w->latency->GetWindow ();
+          sample.totalLatency = w->latency->GetTotal ();
+        }
+      m_samples.push_back (sample);
+
+      for (std::vector<Ptr<FlowSampleSink> >::const_iterator s = m_sinks.begin (); s != m_sinks.end (); ++s)
+        {
+          (*s)->Record (sample);
+        }
+    }
+
+  if (m_table)
+    {
+      /* the lost packets were checked above */
+      m_table->Update ();
+      for (std::vector<Ptr<FlowSampleSink> >::const_iterator s = m_sinks.begin (); s != m_sinks.end (); ++s)
+        {
+          (*s)->RecordNetwork (m_table->GetSummary ());
+        }
+    }
+
+  for (std::vector<Ptr<FlowSampleSink> >::const_iterator s = m_sinks.begin (); s != m_sinks.end (); ++s)
+    {
+      (*s)->EndOfPass (now);
+    }
+  if (m_latency)
+    {
+      m_latency->EndWindow ();
+    }
+}
+
+inline void
+FlowSampler::ResolveNewFlows (const FlowMonitor::FlowStatsContainer &flowStats)
+{
+  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (m_fmhelper->GetClassifier ());
+
+  /* FlowIds are handed out in increasing order, so the new flows are
+   * normally all after the largest one seen so far */
+  FlowMonitor::FlowStatsContainerCI i = m_nSeen == 0 ? flowStats.begin () : flowStats.upper_bound (m_maxSeen);
+  for (; i != flowStats.end (); ++i)
+    {
+      Resolve (i, classifier);
+    }
+  if (m_nSeen != flowStats.size ())
+    {
+      /* a flow got its stats late (e.g. first seen by a forwarding probe) */
+      for (i = flowStats.begin (); i != flowStats.end (); ++i)
+        {
+          Resolve (i, classifier);
+        }
+    }
+}
+
+inline void
+FlowSampler::Resolve (FlowMonitor::FlowStatsContainerCI i, Ptr<Ipv4FlowClassifier> classifier)
+{
+  FlowId id = i->first;
+  if (id >= m_seen.size ())
+    {
+      m_seen.resize (id + 1, false);
+    }
+  if (m_seen[id])
+    {
+      return;
+    }
+  m_seen[id] = true;
+  m_nSeen++;
+  if (id > m_maxSeen)
+    {
+      m_maxSeen = id;
+    }
+
+  Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (id);
+  if (!m_selector.Matches (t))
+    {
+      return;
+    }
+  WatchedFlow w;
+  w.flowId = id;
+  w.tuple = t;
+  w.stats = i;
+  /* a new flow: its first window starts one period ago, from zero */
+  w.history.time = Simulator::Now () - m_period;
+  w.history.rxBytes = 0;
+  w.history.rxPackets = 0;
+  w.history.lostPackets = 0;
+  w.history.primed = false;
+  w.latency = m_latency ? m_latency->Find (t) : 0;
+  m_watched.push_back (w);
+}
+
+inline void
+FlowSampler::ComputeWindow (FlowSample &sample, FlowHistory &history)
+{
+  const FlowMonitor::FlowStats &st = *sample.stats;
+  FlowWindow &w = sample.window;
+
+  w.duration = sample.time - history.time;
+  w.rxPackets = st.rxPackets - history.rxPackets;
+  w.lostPackets = double (st.lostPackets) - history.lostPackets;
+  w.throughput = 0;
+  if (w.duration.IsStrictlyPositive ())
+    {
+      w.throughput = (st.rxBytes - history.rxBytes) * 8.0 / w.duration.GetSeconds () / 1024;
+    }
+  w.delay = 0;
+  w.jitter = 0;
+  if (w.rxPackets > 0)
+    {
+      w.delay = (st.delaySum - history.delaySum).GetSeconds () / w.rxPackets;
+      w.jitter = (st.jitterSum - history.jitterSum).GetSeconds () / w.rxPackets;
+    }
+
+  if (m_alpha == 0 || !history.primed)
+    {
+      history.smoothed = w;
+      history.primed = (w.rxPackets > 0);
+    }
+  else
+    {
+      FlowWindow &e = history.smoothed;
+      e.duration = w.duration;
+      e.rxPackets = w.rxPackets;
+      e.throughput = m_alpha * w.throughput + (1 - m_alpha) * e.throughput;
+      e.lostPackets = m_alpha * w.lostPackets + (1 - m_alpha) * e.lostPackets;
+      /* an empty window says nothing about delay and jitter */
+      if (w.rxPackets > 0)
+        {
+          e.delay = m_alpha * w.delay + (1 - m_alpha) * e.delay;
+          e.jitter = m_alpha * w.jitter + (1 - m_alpha) * e.jitter;
+        }
+    }
+  sample.smoothed = history.smoothed;
+
+  history.time = sample.time;
+  history.rxBytes = st.rxBytes;
+  history.rxPackets = st.rxPackets;
+  history.lostPackets = st.lostPackets;
+  history.delaySum = st.delaySum;
+  history.jitterSum = st.jitterSum;
+}
+
+
+inline
+TimeSeriesSampleSink::TimeSeriesSampleSink (std::string filename, uint32_t chunkRecords,
+                                            Time flushInterval)
+  : m_writer (filename, chunkRecords),
+    m_flushInterval (flushInterval),
+    m_nextFlush (flushInterval),
+    m_lastPass (Seconds (-1))
+{
+  NS_ABORT_MSG_UNLESS (m_writer.IsOpen (), "Cannot open time-series file " << filename);
+}
+
+inline void
+TimeSeriesSampleSink::Record (const FlowSample &sample)
+{
+  if (sample.last && sample.time == m_lastPass)
+    {
+      return;
+    }
+  double now = sample.time.GetSeconds ();
+  m_writer.Write (now, sample.flowId, TS_THROUGHPUT, sample.throughput);
+  m_writer.Write (now, sample.flowId, TS_DELAY, sample.delay);
+  m_writer.Write (now, sample.flowId, TS_LOST_PACKETS, sample.lostPackets);
+  m_writer.Write (now, sample.flowId, TS_JITTER, sample.jitter);
+  m_writer.Write (now, sample.flowId, TS_WINDOW_THROUGHPUT, sample.smoothed.throughput);
+  m_writer.Write (now, sample.flowId, TS_WINDOW_DELAY, sample.smoothed.delay);
+  m_writer.Write (now, sample.flowId, TS_WINDOW_LOST_PACKETS, sample.smoothed.lostPackets);
+  m_writer.Write (now, sample.flowId, TS_WINDOW_JITTER, sample.smoothed.jitter);
+  if (sample.hasLatency && sample.windowLatency.count > 0)
+    {
+      m_writer.Write (now, sample.flowId, TS_WINDOW_DELAY_P50, sample.windowLatency.p50);
+      m_writer.Write (now, sample.flowId, TS_WINDOW_DELAY_P90, sample.windowLatency.p90);
+      m_writer.Write (now, sample.flowId, TS_WINDOW_DELAY_P99, sample.windowLatency.p99);
+      m_writer.Write (now, sample.flowId, TS_WINDOW_DELAY_P999, sample.windowLatency.p999);
+    }
+}
+
+inline void
+TimeSeriesSampleSink::RecordNetwork (const NetworkSummary &summary)
+{
+  if (summary.time == m_lastPass)
+    {
+      return;
+    }
+  double now = summary.time.GetSeconds ();
+  m_writer.Write (now, 0, TS_NET_GOODPUT, summary.goodput);
+  m_writer.Write (now, 0, TS_NET_FAIRNESS, summary.fairness);
+  m_writer.Write (now, 0, TS_NET_DELAY, summary.delay);
+  m_writer.Write (now, 0, TS_NET_LOST_PACKETS, summary.lostPackets);
+  m_writer.Write (now, 0, TS_NET_ACTIVE_FLOWS, summary.nActive);
+  for (uint32_t c = 0; c < summary.cells.size (); c++)
+    {
+      m_writer.Write (now, c, TS_CELL_GOODPUT, summary.cells[c].goodput);
+      m_writer.Write (now, c, TS_CELL_FAIRNESS, summary.cells[c].fairness);
+      m_writer.Write (now, c, TS_CELL_LOST_PACKETS, summary.cells[c].lostPackets);
+    }
+}
+
+inline void
+TimeSeriesSampleSink::EndOfPass (Time now)
+{
+  m_lastPass = now;
+  if (now >= m_nextFlush)
+    {
+      m_writer.Flush ();
+      m_nextFlush = now + m_flushInterval;
+    }
+}
+
+inline void
+TimeSeriesSampleSink::Finish (void)
+{
+  m_writer.Close ();
+}
+
+
+inline
+ReportSampleSink::ReportSampleSink (AsyncReporter *reporter, Time interval, Format format)
+  : m_reporter (reporter),
+    m_interval (interval),
+    m_format (format)
+{
+  m_line.reserve (1024);
+}
+
+inline void
+ReportSampleSink::Append (const char *format, ...)
+{
+  /* measure, then format in place: m_line keeps its capacity, and no
+   * line is ever cut */
+  va_list args;
+  va_start (args, format);
+  va_list copy;
+  va_copy (copy, args);
+  int n = std::vsnprintf (0, 0, format, copy);
+  va_end (copy);
+  if (n > 0)
+    {
+      std::string::size_type size = m_line.size ();
+      m_line.resize (size + n + 1);
+      std::vsnprintf (&m_line[size], n + 1, format, args);
+      m_line.resize (size + n);
+    }
+  va_end (args);
+}
+
+inline std::string
+ReportSampleSink::AddressToString (Ipv4Address address)
+{
+  uint32_t a = address.Get ();
+  char buffer[16];
+  std::snprintf (buffer, sizeof (buffer), "%u.%u.%u.%u",
+                 (a >> 24) & 0xff, (a >> 16) & 0xff, (a >> 8) & 0xff, a & 0xff);
+  return buffer;
+}
+
+inline void
+ReportSampleSink::Record (const FlowSample &sample)
+{
+  /* the final sample is always reported, with the time the run stopped */
+  if (sample.time < m_next && !sample.last)
+    {
+      return;
+    }
+  m_reportedAt = sample.time;
+  m_line.clear ();
+  if (m_format == JSON)
+    {
+      FormatJson (sample);
+    }
+  else
+    {
+      FormatText (sample);
+    }
+  m_reporter->Write (m_line);
+}
+
+inline void
+ReportSampleSink::FormatText (const FlowSample &sample)
+{
+  const FlowMonitor::FlowStats &st = *sample.stats;
+  Append ("Time: %g s%s, Flow %u  Protocol  %s (%s -> %s)\n",
+          sample.time.GetSeconds (), sample.last ? " (end of run)" : "", sample.flowId,
+          sample.tuple.protocol == 17 ? "UDP" : "TCP",
+          AddressToString (sample.tuple.sourceAddress).c_str (),
+          AddressToString (sample.tuple.destinationAddress).c_str ());
+  Append ("Tx Packets = %u\n", st.txPackets);
+  Append ("Rx Packets = %u\n", st.rxPackets);
+  Append ("Duration: %g\n", st.timeLastRxPacket.GetSeconds () - st.timeFirstTxPacket.GetSeconds ());
+  Append ("Last Received Packet: %g Seconds\n", st.timeLastRxPacket.GetSeconds ());
+  Append ("Throughput: %g Kbps\n", sample.throughput);
+  Append ("Delay: %g\n", sample.delay);
+  Append ("LostPackets: %g\n", sample.lostPackets);
+  Append ("Jitter: %g\n", sample.jitter);
+  Append ("Window: %g s, %u packets, %g Kbps, delay %g s, jitter %g s, lost %g\n",
+          sample.window.duration.GetSeconds (), sample.window.rxPackets, sample.smoothed.throughput,
+          sample.smoothed.delay, sample.smoothed.jitter, sample.smoothed.lostPackets);
+  if (sample.hasLatency)
+    {
+      const FlowLatency &l = sample.windowLatency;
+      Append ("Delay percentiles (window, %llu packets): p50 %g s, p90 %g s, p99 %g s, p99.9 %g s\n",
+              (unsigned long long) l.count, l.p50, l.p90, l.p99, l.p999);
+    }
+  Append ("------------------------------------------\n");
+}
+
+inline void
+ReportSampleSink::FormatJson (const FlowSample &sample)
+{
+  const FlowMonitor::FlowStats &st = *sample.stats;
+  Append ("{\"time\":%.9g,\"flow\":%u,\"protocol\":%u,\"src\":\"%s:%u\",\"dst\":\"%s:%u\"",
+          sample.time.GetSeconds (), sample.flowId, unsigned (sample.tuple.protocol),
+          AddressToString (sample.tuple.sourceAddress).c_str (), unsigned (sample.tuple.sourcePort),
+          AddressToString (sample.tuple.destinationAddress).c_str (), unsigned (sample.tuple.destinationPort));
+  Append (",\"txPackets\":%u,\"rxPackets\":%u,\"throughputKbps\":%.9g,\"delaySum\":%.9g,\"lostPackets\":%.9g,\"jitterSum\":%.9g",
+          st.txPackets, st.rxPackets, sample.throughput, sample.delay, sample.lostPackets, sample.jitter);
+  Append (",\"window\":{\"duration\":%.9g,\"rxPackets\":%u,\"throughputKbps\":%.9g,\"delay\":%.9g,\"jitter\":%.9g,\"lostPackets\":%.9g}",
+          sample.window.duration.GetSeconds (), sample.window.rxPackets, sample.smoothed.throughput,
+          sample.smoothed.delay, sample.smoothed.jitter, sample.smoothed.lostPackets);
+  if (sample.hasLatency)
+    {
+      const FlowLatency &l = sample.windowLatency;
+      Append (",\"latency\":{\"count\":%llu,\"p50\":%.9g,\"p90\":%.9g,\"p99\":%.9g,\"p999\":%.9g}",
+              (unsigned long long) l.count, l.p50, l.p90, l.p99, l.p999);
+    }
+  if (sample.last)
+    {
+      Append (",\"last\":true");
+    }
+  Append ("}\n");
+}
+
+inline void
+ReportSampleSink::RecordNetwork (const NetworkSummary &summary)
+{
+  /* reported along with the flows, the final pass included */
+  if (summary.time < m_next && summary.time != m_reportedAt)
+    {
+      return;
+    }
+  m_line.clear ();
+  if (m_format == JSON)
+    {
+      Append ("{\"time\":%.9g,\"network\":{\"window\":%.9g,\"flows\":%u,\"active\":%u,\"goodputKbps\":%.9g,"
+              "\"fairness\":%.9g,\"delay\":%.9g,\"jitter\":%.9g,\"rxPackets\":%llu,\"lostPackets\":%llu,\"cells\":[",
+              summary.time.GetSeconds (), summary.window.GetSeconds (), summary.nFlows, summary.nActive,
+              summary.goodput, summary.fairness, summary.delay, summary.jitter,
+              (unsigned long long) summary.rxPackets, (unsigned long long) summary.lostPackets);
+      for (uint32_t c = 0; c < summary.cells.size (); c++)
+        {
+          const FlowCellSummary &cell = summary.cells[c];
+          Append ("%s{\"name\":\"%s\",\"active\":%u,\"goodputKbps\":%.9g,\"fairness\":%.9g,\"rxPackets\":%llu,\"lostPackets\":%llu}",
+                  c == 0 ? "" : ",", cell.name.c_str (), cell.nActive, cell.goodput, cell.fairness,
+                  (unsigned long long) cell.rxPackets, (unsigned long long) cell.lostPackets);
+        }
+      Append ("]}}\n");
+    }
+  else
+    {
+      Append ("Time: %g s, Network: %u/%u flows active, goodput %g Kbps, fairness %g, delay %g s, jitter %g s, lost %llu\n",
+              summary.time.GetSeconds (), summary.nActive, summary.nFlows, summary.goodput, summary.fairness,
+              summary.delay, summary.jitter, (unsigned long long) summary.lostPackets);
+      for (uint32_t c = 0; c < summary.cells.size (); c++)
+        {
+          const FlowCellSummary &cell = summary.cells[c];
+          Append ("  Cell %s: %u flows active, goodput %g Kbps, fairness %g, lost %llu\n",
+                  cell.name.c_str (), cell.nActive, cell.goodput, cell.fairness, (unsigned long long) cell.lostPackets);
+        }
+      Append ("------------------------------------------\n");
+    }
+  m_reporter->Write (m_line);
+}
+
+inline void
+ReportSampleSink::EndOfPass (Time now)
+{
+  if (now >= m_next)
+    {
+      m_next = now + m_interval;
+    }
+}
+
+} // namespace ns3
+
+#endif /* FLOW_SAMPLER_H */
@@ -0,0 +1,266 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_SELECTOR_H
+#define FLOW_SELECTOR_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/flow-monitor-module.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Five-tuple patterns selecting the flows to watch.
+ *
+ * A pattern is a comma separated list of `key=value` fields, any field left
+ * out matches everything:
+ *
+ *     src=192.168.0.11,dst=10.0.0.0/24,sport=49153,dport=9,proto=udp
+ *
+ * Several patterns are separated by ';' and a flow is selected when it
+ * matches any of them.  The addresses are parsed once, so matching a flow is
+ * only integer compares.
+ */
+class FlowSelector
+{
+public:
+  FlowSelector ();
+
+  /// Add the patterns in spec; returns false (and adds nothing) on a syntax error.
+  bool Parse (std::string spec);
+  void Clear (void);
+  bool IsEmpty (void) const;
+
+  bool Matches (const Ipv4FlowClassifier::FiveTuple &t) const;
+
+private:
+  struct Pattern
+  {
+    Ipv4Address src;
+    Ipv4Mask srcMask;
+    Ipv4Address dst;
+    Ipv4Mask dstMask;
+    int32_t srcPort;    //!< -1 for any
+    int32_t dstPort;    //!< -1 for any
+    int32_t protocol;   //!< -1 for any
+  };
+
+  static bool ParsePattern (std::string spec, Pattern &pattern);
+  static bool ParseAddress (std::string value, Ipv4Address &address, Ipv4Mask &mask);
+  static bool ParseNumber (std::string value, int32_t max, int32_t &number);
+
+  std::vector<Pattern> m_patterns;
+};
+
+
+inline
+FlowSelector::FlowSelector ()
+{
+}
+
+inline bool
+FlowSelector::Parse (std::string spec)
+{
+  std::vector<Pattern> patterns;
+  std::string::size_type start = 0;
+  while (start <= spec.size ())
+    {
+      std::string::size_type end = spec.find (';', start);
+      if (end == std::string::npos)
+        {
+          end = spec.size ();
+        }
+      std::string one = spec.substr (start, end - start);
+      if (!one.empty ())
+        {
+          Pattern pattern;
+          if (!ParsePattern (one, pattern))
+            {
+              return false;
+            }
+          patterns.push_back (pattern);
+        }
+      start = end + 1;
+    }
+  m_patterns.insert (m_patterns.end (), patterns.begin (), patterns.end ());
+  return true;
+}
+
+inline void
+FlowSelector::Clear (void)
+{
+  m_patterns.clear ();
+}
+
+inline bool
+FlowSelector::IsEmpty (void) const
+{
+  return m_patterns.empty ();
+}
+
+inline bool
+FlowSelector::Matches (const Ipv4FlowClassifier::FiveTuple &t) const
+{
+  for (std::vector<Pattern>::const_iterator p = m_patterns.begin (); p != m_patterns.end (); ++p)
+    {
+      if (p->protocol >= 0 && p->protocol != t.protocol)
+        {
+          continue;
+        }
+      if (p->srcPort >= 0 && p->srcPort != t.sourcePort)
+        {
+          continue;
+        }
+      if (p->dstPort >= 0 && p->dstPort != t.destinationPort)
+        {
+          continue;
+        }
+      if (!p->srcMask.IsMatch (p->src, t.sourceAddress) || !p->dstMask.IsMatch (p->dst, t.destinationAddress))
+        {
+          continue;
+        }
+      return true;
+    }
+  return false;
+}
+
+inline bool
+FlowSelector::ParsePattern (std::string spec, Pattern &pattern)
+{
+  pattern.src = Ipv4Address::GetAny ();
+  pattern.srcMask = Ipv4Mask::GetZero ();
+  pattern.dst = Ipv4Address::GetAny ();
+  pattern.dstMask = Ipv4Mask::GetZero ();
+  pattern.srcPort = -1;
+  pattern.dstPort = -1;
+  pattern.protocol = -1;
+
+  std::string::size_type start = 0;
+  while (start < spec.size ())
+    {
+      std::string::size_type end = spec.find (',', start);
+      if (end == std::string::npos)
+        {
+          end = spec.size ();
+        }
+      std::string field = spec.substr (start, end - start);
+      start = end + 1;
+
+      std::string::size_type eq = field.find ('=');
+      if (eq == std::string::npos)
+        {
+          return false;
+        }
+      std::string key = field.substr (0, eq);
+      std::string value = field.substr (eq + 1);
+      if (value == "*")
+        {
+          continue;
+        }
+
+      bool ok;
+      if (key == "src")
+        {
+          ok = ParseAddress (value, pattern.src, pattern.srcMask);
+        }
+      else if (key == "dst")
+        {
+          ok = ParseAddress (value, pattern.dst, pattern.dstMask);
+        }
+      else if (key == "sport")
+        {
+          ok = ParseNumber (value, 65535, pattern.srcPort);
+        }
+      else if (key == "dport")
+        {
+          ok = ParseNumber (value, 65535, pattern.dstPort);
+        }
+      else if (key == "proto")
+        {
+          if (value == "udp")
+            {
+              pattern.protocol = 17;    // UDP_PROT_NUMBER
+              ok = true;
+            }
+          else if (value == "tcp")
+            {
+              pattern.protocol = 6;     // TCP_PROT_NUMBER
+              ok = true;
+            }
+          else
+            {
+              ok = ParseNumber (value, 255, pattern.protocol);
+            }
+        }
+      else
+        {
+          ok = false;
+        }
+      if (!ok)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+inline bool
+FlowSelector::ParseAddress (std::string value, Ipv4Address &address, Ipv4Mask &mask)
+{
+  std::string::size_type slash = value.find ('/');
+  std::string host = value.substr (0, slash);
+  if (host.empty () || host.find_first_not_of ("0123456789.") != std::string::npos)
+    {
+      return false;
+    }
+  address = Ipv4Address (host.c_str ());
+  mask = Ipv4Mask::GetOnes ();
+  if (slash != std::string::npos)
+    {
+      int32_t prefix;
+      if (!ParseNumber (value.substr (slash + 1), 32, prefix))
+        {
+          return false;
+        }
+      mask = Ipv4Mask (value.substr (slash).c_str ());
+    }
+  return true;
+}
+
+inline bool
+FlowSelector::ParseNumber (std::string value, int32_t max, int32_t &number)
+{
+  if (value.empty () || value.find_first_not_of ("0123456789") != std::string::npos)
+    {
+      return false;
+    }
+  long n = std::atol (value.c_str ());
+  if (n > max)
+    {
+      return false;
+    }
+  number = n;
+  return true;
+}
+
+} // namespace ns3
+
+#endif /* FLOW_SELECTOR_H */
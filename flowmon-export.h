@@ -0,0 +1,305 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOWMON_EXPORT_H
+#define FLOWMON_EXPORT_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/flow-monitor-module.h"
+
+#include "flowmon-stream.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Streams the FlowMonitor stats to a binary (or gzip) file.
+ *
+ * Replaces FlowMonitor::SerializeToXmlFile (): each checkpoint writes one
+ * record per flow (and per probe) that changed since the previous
+ * checkpoint, straight from the FlowMonitor containers to a small buffer,
+ * so there is no document to build in memory at the end of the run.  Read
+ * the file back with tools/flowmon-reader.cc, which can also produce the
+ * usual FlowMonitor XML.
+ *
+ * Only a filename ending in ".gz" (compressed) or ".nsfm" selects the
+ * binary export; any other name, the usual ".flowmon" or ".xml", keeps the
+ * old behaviour: no checkpoints, SerializeToXmlFile () in Finish ().
+ */
+class FlowMonitorExporter
+{
+public:
+  /**
+   * \param filename ending in ".gz" (compressed) or ".nsfm" for the binary export, else XML
+   * \param helper the helper that installed the monitor, for the classifier
+   * \param monitor the monitor to export
+   * \param enableHistograms same meaning as for SerializeToXmlFile ()
+   * \param enableProbes same meaning as for SerializeToXmlFile ()
+   */
+  FlowMonitorExporter (std::string filename, FlowMonitorHelper *helper, Ptr<FlowMonitor> monitor,
+                       bool enableHistograms, bool enableProbes);
+  ~FlowMonitorExporter ();
+
+  bool IsOpen (void) const;
+  /// Write a checkpoint every interval from now on (never if interval is zero).
+  void Start (Time interval);
+  /// Write the flows that changed since the last checkpoint.
+  void Checkpoint (void);
+  /// Write the final checkpoint and close the file.
+  void Finish (void);
+
+private:
+  FlowMonitorExporter (const FlowMonitorExporter &);
+  FlowMonitorExporter &operator= (const FlowMonitorExporter &);
+
+  void DoCheckpoint (bool final);
+  void Periodic (void);
+  static bool IsStreamFile (const std::string &filename);
+  static uint64_t Signature (const FlowMonitor::FlowStats &s);
+  static void Copy (const Histogram &h, FlowmonHistogram &out);
+
+  std::string m_xmlFile;        //!< empty for the binary export
+  bool m_histograms;
+  bool m_probes;
+  FlowmonStreamWriter m_writer;
+  Ptr<Ipv4FlowClassifier> m_classifier;
+  Ptr<FlowMonitor> m_monitor;
+  Time m_interval;
+  EventId m_event;
+  bool m_finished;
+
+  /*
+   * Every counter of a flow only grows, so their sum changes whenever the
+   * flow does; a flow whose sum did not move is not written again.
+   */
+  std::map<FlowId, uint64_t> m_flowSignatures;
+  std::vector<std::map<FlowId, uint64_t> > m_probeSignatures;
+
+  FlowmonFlowRecord m_flow;     //!< reused for every record
+  FlowmonProbeRecord m_probe;
+};
+
+
+inline
+FlowMonitorExporter::FlowMonitorExporter (std::string filename, FlowMonitorHelper *helper, Ptr<FlowMonitor> monitor,
+                                          bool enableHistograms, bool enableProbes)
+  : m_xmlFile (IsStreamFile (filename) ? "" : filename),
+    m_histograms (enableHistograms),
+    m_probes (enableProbes),
+    m_writer (m_xmlFile.empty () ? filename : "",
+              (enableHistograms ? FLOWMON_HISTOGRAMS : 0) | (enableProbes ? FLOWMON_PROBES : 0)),
+    m_classifier (DynamicCast<Ipv4FlowClassifier> (helper->GetClassifier ())),
+    m_monitor (monitor),
+    m_finished (false)
+{
+}
+
+inline
+FlowMonitorExporter::~FlowMonitorExporter ()
+{
+  Finish ();
+}
+
+inline bool
+FlowMonitorExporter::IsStreamFile (const std::string &filename)
+{
+  static const char *suffixes[] = { ".gz", ".nsfm" };
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      std::string suffix = suffixes[i];
+      if (filename.size () > suffix.size ()
+          && filename.compare (filename.size () - suffix.size (), suffix.size (), suffix) == 0)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+inline bool
+FlowMonitorExporter::IsOpen (void) const
+{
+  return !m_xmlFile.empty () || m_writer.IsOpen ();
+}
+
+inline void
+FlowMonitorExporter::Start (Time interval)
+{
+  m_interval = interval;
+  if (m_interval.IsStrictlyPositive () && m_xmlFile.empty ())
+    {
+      m_event = Simulator::Schedule (m_interval, &FlowMonitorExporter::Periodic, this);
+    }
+}
+
+inline void
+FlowMonitorExporter::Periodic (void)
+{
+  DoCheckpoint (false);
+  m_event = Simulator::Schedule (m_interval, &FlowMonitorExporter::Periodic, this);
+}
+
+inline void
+FlowMonitorExporter::Checkpoint (void)
+{
+  DoCheckpoint (false);
+}
+
+inline void
+FlowMonitorExporter::Finish (void)
+{
+  if (m_finished)
+    {
+      return;
+    }
+  m_finished = true;
+  m_event.Cancel ();
+  if (!m_xmlFile.empty ())
+    {
+      m_monitor->SerializeToXmlFile (m_xmlFile, m_histograms, m_probes);
+      return;
+    }
+  DoCheckpoint (true);
+  m_writer.Close ();
+}
+
+inline uint64_t
+FlowMonitorExporter::Signature (const FlowMonitor::FlowStats &s)
+{
+  uint64_t sum = s.txPackets + s.rxPackets + s.lostPackets + s.timesForwarded;
+  for (std::vector<uint32_t>::const_iterator i = s.packetsDropped.begin (); i != s.packetsDropped.end (); ++i)
+    {
+      sum += *i;
+    }
+  return sum;
+}
+
+inline void
+FlowMonitorExporter::Copy (const Histogram &h, FlowmonHistogram &out)
+{
+  uint32_t nBins = h.GetNBins ();
+  out.nBins = nBins;
+  out.width = nBins > 0 ? h.GetBinWidth (0) : 0;
+  out.bins.clear ();
+  for (uint32_t i = 0; i < nBins; i++)
+    {
+      uint32_t count = h.GetBinCount (i);
+      if (count != 0)
+        {
+          out.bins.push_back (std::make_pair (i, count));
+        }
+    }
+}
+
+inline void
+FlowMonitorExporter::DoCheckpoint (bool final)
+{
+  if (!m_writer.IsOpen ())
+    {
+      return;
+    }
+  m_monitor->CheckForLostPackets ();
+  m_writer.WriteCheckpoint (Simulator::Now ().GetSeconds (), final);
+
+  const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats ();
+  for (FlowMonitor::FlowStatsContainerCI i = stats.begin (); i != stats.end (); ++i)
+    {
+      const FlowMonitor::FlowStats &s = i->second;
+      uint64_t signature = Signature (s);
+      std::map<FlowId, uint64_t>::iterator seen = m_flowSignatures.find (i->first);
+      if (seen != m_flowSignatures.end () && seen->second == signature)
+        {
+          continue;
+        }
+      m_flowSignatures[i->first] = signature;
+
+      Ipv4FlowClassifier::FiveTuple t = m_classifier->FindFlow (i->first);
+      FlowmonFlowRecord &f = m_flow;
+      f.flowId = i->first;
+      f.sourceAddress = t.sourceAddress.Get ();
+      f.destinationAddress = t.destinationAddress.Get ();
+      f.protocol = t.protocol;
+      f.sourcePort = t.sourcePort;
+      f.destinationPort = t.destinationPort;
+      f.timeFirstTxPacket = s.timeFirstTxPacket.GetNanoSeconds ();
+      f.timeFirstRxPacket = s.timeFirstRxPacket.GetNanoSeconds ();
+      f.timeLastTxPacket = s.timeLastTxPacket.GetNanoSeconds ();
+      f.timeLastRxPacket = s.timeLastRxPacket.GetNanoSeconds ();
+      f.delaySum = s.delaySum.GetNanoSeconds ();
+      f.jitterSum = s.jitterSum.GetNanoSeconds ();
+      f.lastDelay = s.lastDelay.GetNanoSeconds ();
+      f.txBytes = s.txBytes;
+      f.rxBytes = s.rxBytes;
+      f.txPackets = s.txPackets;
+      f.rxPackets = s.rxPackets;
+      f.lostPackets = s.lostPackets;
+      f.timesForwarded = s.timesForwarded;
+      f.packetsDropped = s.packetsDropped;
+      f.bytesDropped = s.bytesDropped;
+      if (m_writer.GetFlags () & FLOWMON_HISTOGRAMS)
+        {
+          Copy (s.delayHistogram, f.delayHistogram);
+          Copy (s.jitterHistogram, f.jitterHistogram);
+          Copy (s.packetSizeHistogram, f.packetSizeHistogram);
+          Copy (s.flowInterruptionsHistogram, f.flowInterruptionsHistogram);
+        }
+      m_writer.WriteFlow (f);
+    }
+
+  if (m_writer.GetFlags () & FLOWMON_PROBES)
+    {
+      const FlowMonitor::FlowProbeContainer &probes = m_monitor->GetAllProbes ();
+      m_probeSignatures.resize (probes.size ());
+      for (uint32_t index = 0; index < probes.size (); index++)
+        {
+          FlowProbe::Stats probeStats = probes[index]->GetStats ();
+          for (FlowProbe::Stats::const_iterator i = probeStats.begin (); i != probeStats.end (); ++i)
+            {
+              const FlowProbe::FlowStats &s = i->second;
+              uint64_t signature = s.packets;
+              for (std::vector<uint32_t>::const_iterator d = s.packetsDropped.begin (); d != s.packetsDropped.end (); ++d)
+                {
+                  signature += *d;
+                }
+              std::map<FlowId, uint64_t>::iterator seen = m_probeSignatures[index].find (i->first);
+              if (seen != m_probeSignatures[index].end () && seen->second == signature)
+                {
+                  continue;
+                }
+              m_probeSignatures[index][i->first] = signature;
+
+              FlowmonProbeRecord &p = m_probe;
+              p.probe = index;
+              p.flowId = i->first;
+              p.delayFromFirstProbeSum = s.delayFromFirstProbeSum.GetNanoSeconds ();
+              p.bytes = s.bytes;
+              p.packets = s.packets;
+              p.packetsDropped = s.packetsDropped;
+              p.bytesDropped = s.bytesDropped;
+              m_writer.WriteProbe (p);
+            }
+        }
+    }
+  m_writer.Flush ();
+}
+
+} // namespace ns3
+
+#endif /* FLOWMON_EXPORT_H */
@@ -0,0 +1,603 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOWMON_STREAM_H
+#define FLOWMON_STREAM_H
+
+/*
+ * Compact binary FlowMonitor export, written flow by flow instead of as one
+ * XML document at the end of the run.
+ *
+ * The file is a gzip stream (plain binary when the name does not end in
+ * ".gz") holding, in host byte order:
+ *
+ *     header    : char magic[4] = "NSFM", uint16_t version, uint16_t flags
+ *     records   : uint8_t type followed by the record
+ *       'C' checkpoint : double time, uint8_t final
+ *       'F' flow       : FlowmonFlowRecord (only the flows that changed
+ *                        since the previous checkpoint)
+ *       'P' probe      : FlowmonProbeRecord (same rule), only with FLOWMON_PROBES
+ *       'E' end of file
+ *
+ * The latest 'F'/'P' record of a flow holds its current stats.  A run that
+ * crashed still has every checkpoint written before the crash.
+ *
+ * This file does not depend on ns-3 (tools/flowmon-reader.cc uses it).  The
+ * ".gz" files need zlib: build with -DHAVE_ZLIB and link with -lz; without it
+ * the plain files go through stdio.
+ */
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static const char FLOWMON_MAGIC[4] = { 'N', 'S', 'F', 'M' };
+static const uint16_t FLOWMON_VERSION = 1;
+
+#ifdef HAVE_ZLIB
+typedef gzFile FlowmonFile;
+#else
+typedef FILE *FlowmonFile;
+#endif
+
+/// Open filename for reading or writing; 0 if it cannot be opened.
+inline FlowmonFile
+FlowmonOpen (const std::string &filename, bool write)
+{
+  bool compress = filename.size () > 3 && filename.compare (filename.size () - 3, 3, ".gz") == 0;
+#ifdef HAVE_ZLIB
+  /* "T" asks zlib for a plain, uncompressed file */
+  gzFile file = gzopen (filename.c_str (), !write ? "rb" : compress ? "wb6" : "wbT");
+  if (file != 0)
+    {
+      gzbuffer (file, 1 << 17);
+    }
+  return file;
+#else
+  if (compress)
+    {
+      std::fprintf (stderr, "FlowmonOpen: %s needs zlib, build with -DHAVE_ZLIB and -lz\n", filename.c_str ());
+      return 0;
+    }
+  return std::fopen (filename.c_str (), write ? "wb" : "rb");
+#endif
+}
+
+inline bool
+FlowmonRead (FlowmonFile file, void *data, uint32_t size)
+{
+#ifdef HAVE_ZLIB
+  return gzread (file, data, size) == int (size);
+#else
+  return std::fread (data, 1, size, file) == size;
+#endif
+}
+
+inline void
+FlowmonWrite (FlowmonFile file, const std::string &data)
+{
+#ifdef HAVE_ZLIB
+  gzwrite (file, data.data (), data.size ());
+#else
+  std::fwrite (data.data (), 1, data.size (), file);
+#endif
+}
+
+/// Make what was written so far readable, e.g. by a reader of a crashed run.
+inline void
+FlowmonFlush (FlowmonFile file)
+{
+#ifdef HAVE_ZLIB
+  gzflush (file, Z_SYNC_FLUSH);
+#else
+  std::fflush (file);
+#endif
+}
+
+inline void
+FlowmonClose (FlowmonFile file)
+{
+#ifdef HAVE_ZLIB
+  gzclose (file);
+#else
+  std::fclose (file);
+#endif
+}
+
+enum FlowmonFlags
+{
+  FLOWMON_HISTOGRAMS = 1,   //!< the flow records carry the four histograms
+  FLOWMON_PROBES = 2        //!< the file has per-probe records
+};
+
+enum FlowmonRecordType
+{
+  FLOWMON_CHECKPOINT = 'C',
+  FLOWMON_FLOW = 'F',
+  FLOWMON_PROBE = 'P',
+  FLOWMON_END = 'E'
+};
+
+/**
+ * \brief The non-empty bins of a FlowMonitor Histogram.
+ */
+struct FlowmonHistogram
+{
+  double width;                                      //!< bin width, bin i starts at i * width
+  uint32_t nBins;
+  std::vector<std::pair<uint32_t, uint32_t> > bins;  //!< (index, count), count != 0
+};
+
+/**
+ * \brief FlowMonitor::FlowStats of one flow plus its five-tuple; times in ns.
+ */
+struct FlowmonFlowRecord
+{
+  uint32_t flowId;
+  uint32_t sourceAddress;
+  uint32_t destinationAddress;
+  uint8_t protocol;
+  uint16_t sourcePort;
+  uint16_t destinationPort;
+
+  int64_t timeFirstTxPacket;
+  int64_t timeFirstRxPacket;
+  int64_t timeLastTxPacket;
+  int64_t timeLastRxPacket;
+  int64_t delaySum;
+  int64_t jitterSum;
+  int64_t lastDelay;
+  uint64_t txBytes;
+  uint64_t rxBytes;
+  uint32_t txPackets;
+  uint32_t rxPackets;
+  uint32_t lostPackets;
+  uint32_t timesForwarded;
+  std::vector<uint32_t> packetsDropped;
+  std::vector<uint64_t> bytesDropped;
+
+  FlowmonHistogram delayHistogram;              //!< only with FLOWMON_HISTOGRAMS
+  FlowmonHistogram jitterHistogram;
+  FlowmonHistogram packetSizeHistogram;
+  FlowmonHistogram flowInterruptionsHistogram;
+};
+
+/**
+ * \brief FlowProbe::FlowStats of one flow seen by one probe; times in ns.
+ */
+struct FlowmonProbeRecord
+{
+  uint32_t probe;       //!< index in FlowMonitor::GetAllProbes ()
+  uint32_t flowId;
+  int64_t delayFromFirstProbeSum;
+  uint64_t bytes;
+  uint32_t packets;
+  std::vector<uint32_t> packetsDropped;
+  std::vector<uint64_t> bytesDropped;
+};
+
+/**
+ * \brief Writes a binary FlowMonitor export.
+ */
+class FlowmonStreamWriter
+{
+public:
+  FlowmonStreamWriter (std::string filename, uint16_t flags);
+  ~FlowmonStreamWriter ();
+
+  bool IsOpen (void) const;
+  uint16_t GetFlags (void) const;
+
+  void WriteCheckpoint (double time, bool final);
+  void WriteFlow (const FlowmonFlowRecord &flow);
+  void WriteProbe (const FlowmonProbeRecord &probe);
+  /// Push the buffered records to the file.
+  void Flush (void);
+  /// Write the end marker and close the file.
+  void Close (void);
+
+private:
+  FlowmonStreamWriter (const FlowmonStreamWriter &);
+  FlowmonStreamWriter &operator= (const FlowmonStreamWriter &);
+
+  template <typename T>
+  void Put (T value)
+  {
+    m_buffer.append (reinterpret_cast<const char *> (&value), sizeof (value));
+  }
+  void PutHistogram (const FlowmonHistogram &h);
+  template <typename T>
+  void PutVector (const std::vector<T> &v)
+  {
+    Put<uint32_t> (v.size ());
+    for (typename std::vector<T>::const_iterator i = v.begin (); i != v.end (); ++i)
+      {
+        Put<T> (*i);
+      }
+  }
+  void MaybeFlush (void);
+
+  FlowmonFile m_file;
+  uint16_t m_flags;
+  std::string m_buffer;
+};
+
+/**
+ * \brief Reads a binary FlowMonitor export record by record.
+ */
+class FlowmonStreamReader
+{
+public:
+  FlowmonStreamReader (std::string filename);
+  ~FlowmonStreamReader ();
+
+  /// False if the file could not be opened or is not a FlowMonitor export.
+  bool IsOpen (void) const;
+  uint16_t GetFlags (void) const;
+
+  /**
+   * Read the next record.  Returns false at the end of the file (or on a
+   * truncated record, e.g. after a crash); the record is then available
+   * from GetTime ()/IsFinal (), GetFlow () or GetProbe () depending on type.
+   */
+  bool Next (FlowmonRecordType &type);
+
+  double GetTime (void) const;
+  bool IsFinal (void) const;
+  const FlowmonFlowRecord &GetFlow (void) const;
+  const FlowmonProbeRecord &GetProbe (void) const;
+
+private:
+  FlowmonStreamReader (const FlowmonStreamReader &);
+  FlowmonStreamReader &operator= (const FlowmonStreamReader &);
+
+  template <typename T>
+  bool Get (T &value)
+  {
+    return FlowmonRead (m_file, &value, sizeof (value));
+  }
+  bool GetHistogram (FlowmonHistogram &h);
+  template <typename T>
+  bool GetVector (std::vector<T> &v)
+  {
+    uint32_t n;
+    if (!Get (n))
+      {
+        return false;
+      }
+    v.resize (n);
+    for (uint32_t i = 0; i < n; i++)
+      {
+        if (!Get (v[i]))
+          {
+            return false;
+          }
+      }
+    return true;
+  }
+  bool ReadFlow (void);
+  bool ReadProbe (void);
+
+  FlowmonFile m_file;
+  uint16_t m_flags;
+  double m_time;
+  bool m_final;
+  FlowmonFlowRecord m_flow;
+  FlowmonProbeRecord m_probe;
+};
+
+
+inline
+FlowmonStreamWriter::FlowmonStreamWriter (std::string filename, uint16_t flags)
+  : m_flags (flags)
+{
+  m_file = FlowmonOpen (filename, true);
+  if (m_file == 0)
+    {
+      return;
+    }
+  m_buffer.reserve (1 << 16);
+  m_buffer.append (FLOWMON_MAGIC, sizeof (FLOWMON_MAGIC));
+  Put<uint16_t> (FLOWMON_VERSION);
+  Put<uint16_t> (m_flags);
+}
+
+inline
+FlowmonStreamWriter::~FlowmonStreamWriter ()
+{
+  Close ();
+}
+
+inline bool
+FlowmonStreamWriter::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline uint16_t
+FlowmonStreamWriter::GetFlags (void) const
+{
+  return m_flags;
+}
+
+inline void
+FlowmonStreamWriter::WriteCheckpoint (double time, bool final)
+{
+  Put<uint8_t> (FLOWMON_CHECKPOINT);
+  Put<double> (time);
+  Put<uint8_t> (final ? 1 : 0);
+  MaybeFlush ();
+}
+
+inline void
+FlowmonStreamWriter::PutHistogram (const FlowmonHistogram &h)
+{
+  Put<double> (h.width);
+  Put<uint32_t> (h.nBins);
+  Put<uint32_t> (h.bins.size ());
+  for (std::vector<std::pair<uint32_t, uint32_t> >::const_iterator b = h.bins.begin (); b != h.bins.end (); ++b)
+    {
+      Put<uint32_t> (b->first);
+      Put<uint32_t> (b->second);
+    }
+}
+
+inline void
+FlowmonStreamWriter::WriteFlow (const FlowmonFlowRecord &f)
+{
+  Put<uint8_t> (FLOWMON_FLOW);
+  Put<uint32_t> (f.flowId);
+  Put<uint32_t> (f.sourceAddress);
+  Put<uint32_t> (f.destinationAddress);
+  Put<uint8_t> (f.protocol);
+  Put<uint16_t> (f.sourcePort);
+  Put<uint16_t> (f.destinationPort);
+  Put<int64_t> (f.timeFirstTxPacket);
+  Put<int64_t> (f.timeFirstRxPacket);
+  Put<int64_t> (f.timeLastTxPacket);
+  Put<int64_t> (f.timeLastRxPacket);
+  Put<int64_t> (f.delaySum);
+  Put<int64_t> (f.jitterSum);
+  Put<int64_t> (f.lastDelay);
+  Put<uint64_t> (f.txBytes);
+  Put<uint64_t> (f.rxBytes);
+  Put<uint32_t> (f.txPackets);
+  Put<uint32_t> (f.rxPackets);
+  Put<uint32_t> (f.lostPackets);
+  Put<uint32_t> (f.timesForwarded);
+  PutVector (f.packetsDropped);
+  PutVector (f.bytesDropped);
+  if (m_flags & FLOWMON_HISTOGRAMS)
+    {
+      PutHistogram (f.delayHistogram);
+      PutHistogram (f.jitterHistogram);
+      PutHistogram (f.packetSizeHistogram);
+      PutHistogram (f.flowInterruptionsHistogram);
+    }
+  MaybeFlush ();
+}
+
+inline void
+FlowmonStreamWriter::WriteProbe (const FlowmonProbeRecord &p)
+{
+  Put<uint8_t> (FLOWMON_PROBE);
+  Put<uint32_t> (p.probe);
+  Put<uint32_t> (p.flowId);
+  Put<int64_t> (p.delayFromFirstProbeSum);
+  Put<uint64_t> (p.bytes);
+  Put<uint32_t> (p.packets);
+  PutVector (p.packetsDropped);
+  PutVector (p.bytesDropped);
+  MaybeFlush ();
+}
+
+inline void
+FlowmonStreamWriter::MaybeFlush (void)
+{
+  if (m_buffer.size () >= (1 << 16))
+    {
+      FlowmonWrite (m_file, m_buffer);
+      m_buffer.clear ();
+    }
+}
+
+inline void
+FlowmonStreamWriter::Flush (void)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  if (!m_buffer.empty ())
+    {
+      FlowmonWrite (m_file, m_buffer);
+      m_buffer.clear ();
+    }
+  FlowmonFlush (m_file);
+}
+
+inline void
+FlowmonStreamWriter::Close (void)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  Put<uint8_t> (FLOWMON_END);
+  if (!m_buffer.empty ())
+    {
+      FlowmonWrite (m_file, m_buffer);
+      m_buffer.clear ();
+    }
+  FlowmonClose (m_file);
+  m_file = 0;
+}
+
+
+inline
+FlowmonStreamReader::FlowmonStreamReader (std::string filename)
+  : m_flags (0),
+    m_time (0),
+    m_final (false)
+{
+  m_file = FlowmonOpen (filename, false);
+  if (m_file == 0)
+    {
+      return;
+    }
+  char magic[4];
+  uint16_t version;
+  if (!FlowmonRead (m_file, magic, sizeof (magic))
+      || std::memcmp (magic, FLOWMON_MAGIC, sizeof (magic)) != 0
+      || !Get (version) || version != FLOWMON_VERSION
+      || !Get (m_flags))
+    {
+      FlowmonClose (m_file);
+      m_file = 0;
+    }
+}
+
+inline
+FlowmonStreamReader::~FlowmonStreamReader ()
+{
+  if (m_file != 0)
+    {
+      FlowmonClose (m_file);
+    }
+}
+
+inline bool
+FlowmonStreamReader::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline uint16_t
+FlowmonStreamReader::GetFlags (void) const
+{
+  return m_flags;
+}
+
+inline bool
+FlowmonStreamReader::Next (FlowmonRecordType &type)
+{
+  uint8_t t;
+  if (m_file == 0 || !Get (t))
+    {
+      return false;
+    }
+  type = FlowmonRecordType (t);
+  switch (type)
+    {
+    case FLOWMON_CHECKPOINT:
+      {
+        uint8_t final;
+        if (!Get (m_time) || !Get (final))
+          {
+            return false;
+          }
+        m_final = (final != 0);
+        return true;
+      }
+    case FLOWMON_FLOW:
+      return ReadFlow ();
+    case FLOWMON_PROBE:
+      return ReadProbe ();
+    default:
+      /* FLOWMON_END or garbage */
+      return false;
+    }
+}
+
+inline bool
+FlowmonStreamReader::GetHistogram (FlowmonHistogram &h)
+{
+  uint32_t n;
+  if (!Get (h.width) || !Get (h.nBins) || !Get (n))
+    {
+      return false;
+    }
+  h.bins.resize (n);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      if (!Get (h.bins[i].first) || !Get (h.bins[i].second))
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+inline bool
+FlowmonStreamReader::ReadFlow (void)
+{
+  FlowmonFlowRecord &f = m_flow;
+  bool ok = Get (f.flowId) && Get (f.sourceAddress) && Get (f.destinationAddress)
+    && Get (f.protocol) && Get (f.sourcePort) && Get (f.destinationPort)
+    && Get (f.timeFirstTxPacket) && Get (f.timeFirstRxPacket)
+    && Get (f.timeLastTxPacket) && Get (f.timeLastRxPacket)
+    && Get (f.delaySum) && Get (f.jitterSum) && Get (f.lastDelay)
+    && Get (f.txBytes) && Get (f.rxBytes)
+    && Get (f.txPackets) && Get (f.rxPackets) && Get (f.lostPackets) && Get (f.timesForwarded)
+    && GetVector (f.packetsDropped) && GetVector (f.bytesDropped);
+  if (ok && (m_flags & FLOWMON_HISTOGRAMS))
+    {
+      ok = GetHistogram (f.delayHistogram) && GetHistogram (f.jitterHistogram)
+        && GetHistogram (f.packetSizeHistogram) && GetHistogram (f.flowInterruptionsHistogram);
+    }
+  return ok;
+}
+
+inline bool
+FlowmonStreamReader::ReadProbe (void)
+{
+  FlowmonProbeRecord &p = m_probe;
+  return Get (p.probe) && Get (p.flowId) && Get (p.delayFromFirstProbeSum)
+    && Get (p.bytes) && Get (p.packets)
+    && GetVector (p.packetsDropped) && GetVector (p.bytesDropped);
+}
+
+inline double
+FlowmonStreamReader::GetTime (void) const
+{
+  return m_time;
+}
+
+inline bool
+FlowmonStreamReader::IsFinal (void) const
+{
+  return m_final;
+}
+
+inline const FlowmonFlowRecord &
+FlowmonStreamReader::GetFlow (void) const
+{
+  return m_flow;
+}
+
+inline const FlowmonProbeRecord &
+FlowmonStreamReader::GetProbe (void) const
+{
+  return m_probe;
+}
+
+#endif /* FLOWMON_STREAM_H */
@@ -52,6 +52,10 @@
 
 #include "ns3/netanim-module.h"
 
+#include "flow-probe-placement.h"
+#include "flow-table.h"
+#include "flowmon-export.h"
+
 using namespace ns3;
 
 // 用于命令行操作 `$ export NS_LOG=GoalTopoScript=info`
@@ -103,6 +107,11 @@ main (int argc, char *argv[])
 
   ns3::Time stopTime = ns3::Seconds (5.0);
 
+  std::string flowmonFile = "goal-topo-for-monitor-test.flowmon";  // .gz/.nsfm: streamed binary
+  double flowmonCheckpoint = 0.0;
+  bool endpointProbes = false;        // probes only on the client and server nodes
+  std::string probeTransit = "";      // forwarding nodes that get one as well, e.g. "2,4"
+
   #ifdef NS3_OPENFLOW
 
 
@@ -113,6 +122,10 @@ main (int argc, char *argv[])
   cmd.AddValue ("nAp1Station", "Number of wifi STA devices of AP1", nAp1Station);
   cmd.AddValue ("nAp2Station", "Number of wifi STA devices of AP2", nAp2Station);
   cmd.AddValue ("nAp3Station", "Number of wifi STA devices of AP3", nAp3Station);
+  cmd.AddValue ("flowmon", "FlowMonitor output file: XML at the end, or streamed in binary when it ends in .gz (compressed) or .nsfm", flowmonFile);
+  cmd.AddValue ("flowmonCheckpoint", "Seconds between two FlowMonitor checkpoints (0: only at the end)", flowmonCheckpoint);
+  cmd.AddValue ("endpointProbes", "Only put FlowMonitor probes on the client and server nodes", endpointProbes);
+  cmd.AddValue ("probeTransit", "Ids of forwarding nodes that also get a probe with endpointProbes, e.g. 2,4", probeTransit);
 
   cmd.AddValue ("v", "Verbose (turns on logging).", MakeCallback (&SetVerbose));
   cmd.AddValue ("verbose", "Verbose (turns on logging).", MakeCallback (&SetVerbose));
@@ -521,7 +534,12 @@ main (int argc, char *argv[])
 ** Calculate Throughput using Flowmonitor
 */
   FlowMonitorHelper flowmon;
-  Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+  FlowProbePlacement probes;
+  probes.SetEndpointsOnly (endpointProbes);
+  probes.AddEndpoints (server_apps);
+  probes.AddEndpoints (client_apps);
+  NS_ABORT_MSG_UNLESS (probes.ParseTransit (probeTransit), "Bad node id in probeTransit: " << probeTransit);
+  Ptr<FlowMonitor> monitor = probes.Install (flowmon);
 
 
 /*
@@ -532,32 +550,27 @@ main (int argc, char *argv[])
 
   
 
-  monitor->CheckForLostPackets ();
+  // every flow in struct-of-arrays columns, printed once the simulation is over
+  // (the stats used to be read here, before Simulator::Run (), when they were still empty)
+  FlowTable table (&flowmon, monitor);
+  table.AddCell ("ap1", interfaceA);
+  table.AddCell ("ap2", interfaceB);
+  table.AddCell ("ap3", staWifiInterfaceC);
 
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
-  std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
-    {
-      /* `Ipv4FlowClassifier`
-       * Classifies packets by looking at their IP and TCP/UDP headers. 
-       * FiveTuple五元组是：(source-ip, destination-ip, protocol, source-port, destination-port)
-      */
-
-      Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-      std::cout << "Flow " << i->first  << " (" << t.sourceAddress << " -> " << t.destinationAddress << ")\n";
-      std::cout << "  Tx Bytes:   " << i->second.txBytes << "\n";   // 传输了多少字节
-      std::cout << "  Rx Bytes:   " << i->second.rxBytes << "\n";   // 收到了多少字节
-      // 得出吞吐量(Throughput是多少)
-      std::cout << "  Throughput: " << i->second.rxBytes * 8.0 / (i->second.timeLastRxPacket.GetSeconds() - i->second.timeFirstTxPacket.GetSeconds())/1024/1024  << " Mbps\n";
-     }
-
-
-  monitor->SerializeToXmlFile("goal-topo-for-monitor-test.flowmon", true, true);
-  // the SerializeToXmlFile () function 2nd and 3rd parameters 
+
+  // XML at the end, or streamed while the simulation runs when flowmonFile ends
+  // in .gz or .nsfm (read it back with tools/flowmon-reader)
+  // the last two parameters (as for SerializeToXmlFile ())
   // are used respectively to activate/deactivate the histograms and the per-probe detailed stats.
+  FlowMonitorExporter exporter (flowmonFile, &flowmon, monitor, true, true);
+  exporter.Start (Seconds (flowmonCheckpoint));
 
   
   Simulator::Run ();
+  monitor->CheckForLostPackets ();
+  table.Update ();
+  table.Print (std::cout);
+  exporter.Finish ();
   Simulator::Destroy ();
 
 
@@ -52,6 +52,15 @@
 
 #include "ns3/netanim-module.h"
 
+#include "flow-sampler.h"
+#include "flow-selector.h"
+#include "flow-probe-placement.h"
+#include "flowmon-export.h"
+#include "steady-state.h"
+#include "trace-capture.h"
+#include "flight-recorder.h"
+#include "binary-animation.h"
+
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -68,6 +77,12 @@ ns3::Time timeout = ns3::Seconds (0);
 
 
 double stopTime = 50.0;  // when the simulation stops
+/* 只在时间窗口内抓包(pcap和csma事件trace): 窗口开始时连接trace sink, 结束时断开, 窗口外没有任何trace开销.
+ * traceWindows 可以给出多个窗口 "开始-结束"(秒), 如 "5-10,20-25", 给出时 traceStart/traceStop 不起作用
+ */
+double traceStart = 0.0;
+double traceStop  = 0.0;  // 0 表示到仿真结束
+std::string traceWindows = "";
 
 uint32_t nAp         = 3;
 uint32_t nSwitch     = 2;
@@ -78,6 +93,79 @@ uint32_t nAp3Station = 1;
 
 
 double nSamplingPeriod = 0.1;   // 抽样间隔，根据总的Simulation时间做相应的调整
+double nEwma     = 0.0;         // 对每个抽样间隔内的值做EWMA平滑, 0表示不平滑
+
+/* 要监测的flow, 格式见 flow-selector.h
+ * `192.168.0.11`是client(Node #14)的IP, `10.0.0.5`是server(Node #6)的IP
+ */
+FlowSelector flowSelector;
+std::string  sFlows = "src=192.168.0.11,dst=10.0.0.5,proto=udp";
+
+/* 每秒一次的报告, 由后台线程写出, 不阻塞仿真线程 */
+std::string  sReport       = "-";      // "-" 表示 stdout
+std::string  sReportFormat = "text";   // text 或 json (每行一个JSON对象)
+uint32_t     nReportFlushMs = 200;     // 后台线程每隔多少毫秒 flush 一次
+
+/* 全网模式: 每次抽样时统计所有flow的总goodput, Jain公平性指数, 以及每个AP(cell)的和 */
+bool         bAllFlows = false;
+
+/* FlowMonitor的probe只装在收发两端(client/server)的节点上, 而不是所有节点;
+ * 需要逐跳统计(timesForwarded, 中途丢包原因)时, 用 ProbeTransit 加上转发节点的id, 如 "2,4"
+ */
+bool         bEndpointProbes = false;
+std::string  sProbeTransit   = "";
+
+/* 自动停止: 每个flow的窗口吞吐量和时延都进入稳态(MSER-5 + batch means),
+ * 且95%置信区间的半宽不超过均值的 AutoStopPrecision 时, 提前结束仿真
+ */
+bool         bAutoStop = false;
+double       nAutoStopPrecision = 0.05;
+
+/* FlowMonitor的统计结果, 默认在结束时用 SerializeToXmlFile () 输出XML;
+ * 文件名以 .gz (压缩) 或 .nsfm 结尾时边运行边写入二进制文件, 用 tools/flowmon-reader 读取
+ */
+std::string  sFlowmon = "goal-topo/goal-topo.flowmon";
+double       nFlowmonCheckpoint = 0.0;  // 每隔多少秒写一次检查点, 0 表示只在结束时写
+
+/* pcap抓包: 每个文件先写入内存缓冲区, 缓冲区满了交给后台线程写盘, 不阻塞仿真线程 */
+uint32_t     nPcapBufferKb = 1024;     // 每个pcap文件的缓冲区大小(KB)
+/* 为每个pcap文件另写一个时间索引 <文件>.idx, 每隔这么多秒记一条(时间, uid, 文件偏移), 读取时可直接跳到某个时间; 0 表示不写 */
+double       nPcapIndex = 0.0;
+/* 所有设备写入同一个pcapng文件(每个设备一个接口, 按仿真时间排序, 每个包带uid和节点id); 为空则每个设备一个pcap文件 */
+std::string  sPcapng = "";
+/* csma事件trace的格式: ascii (默认) 为原来的 goal-topo/goal-topo.tr 文本; binary 为定长二进制记录
+ * (时间,事件,节点,设备,uid,大小,队列长度), 写入 goal-topo/goal-topo.evl, 用 tools/trace-cat <文件> tr 转换回 .tr 文本
+ */
+std::string  sTraceFormat = "ascii";
+/* NetAnim动画的格式: xml (默认) 为原来的 goal-topo/goal-topo.xml; binary 为二进制记录(每个字符串只写一次,
+ * 之后用编号引用), 边写边压缩, 写入 goal-topo/goal-topo.anim.gz, 用 tools/anim-to-xml 转换成NetAnim读取的XML
+ */
+std::string  sAnimFormat = "xml";
+/* 二进制动画中节点位置的抽稀(只对 AnimFormat=binary 有效): 同一节点相邻两次位置至少间隔 AnimPositionInterval 秒,
+ * 至少相距 AnimPositionDistance 米; AnimPositionTolerance >= 0 时按直线段压缩: 位置连同速度写入,
+ * 节点偏离按上次位置和速度推算的直线超过这么多米才再写一次, tools/anim-to-xml 转换时沿直线补出中间位置
+ */
+double       nAnimPositionInterval  = 0.0;
+double       nAnimPositionDistance  = 0.0;
+double       nAnimPositionTolerance = -1.0;   // 负数表示不做直线段压缩
+/* 压缩输出: 所有trace文件加上 .gz 后缀, 每个缓冲区由多个线程并行压缩; 用 tools/trace-cat 读取 */
+bool         bTraceCompress = false;
+uint32_t     nTraceThreads  = 2;        // 压缩线程数
+/* pcap每个记录保留的字节数(含radiotap), 0 表示只保留到UDP/TCP头为止, 不存payload; 记录中仍保存原始长度 */
+uint32_t     nPcapSnapLen   = 65535;
+/* 抽样: 每N个包只抓1个, 按五元组和packet uid的哈希选取, 同一个包在每一跳都被选中(或都不被选中);
+ * TraceSamplingDevices 为个别设备指定抽样率, 格式 "节点id/设备id=N", 如 "0/1=10,2/2=100" (与pcap文件名中的编号相同)
+ */
+uint32_t     nTraceSampling = 1;
+std::string  sTraceSamplingDevices = "";
+/* 飞行记录仪: 每个设备只在内存中保留最近 FlightRecorder 个包, 触发时才写入pcap. 触发事件(FlightRecorderTriggers):
+ *   phy: PHY接收丢包, mac: MAC队列满丢包, loss: FlowMonitor统计到新的丢包, packetin: OpenFlow packet-in 突发
+ */
+uint32_t     nFlightRecorder = 0;             // 0 表示关闭, 所有包都写入
+double       nFlightRecorderWindow = 0.0;     // 只写出触发前多少秒内的包, 0 表示不限
+double       nFlightRecorderAfter  = 1.0;     // 触发后继续直接写入多少秒
+std::string  sFlightRecorderTriggers = "phy,mac,loss,packetin";
+uint32_t     nPacketInBurst = 50;             // 1秒内超过这么多个packet-in即触发
 
 
 /* for udp-server-client application. */
@@ -110,6 +198,14 @@ SetTimeout (std::string value)
   return false;
 }
 
+bool
+SetFlows (std::string value)
+{
+  sFlows = value;
+  flowSelector.Clear ();
+  return flowSelector.Parse (value);
+}
+
 
 bool
 CommandSetup (int argc, char **argv)
@@ -120,7 +216,40 @@ CommandSetup (int argc, char **argv)
   //cmd.AddValue ("timeout", "Learning Controller Timeout (has no effect if drop controller is specified).", MakeCallback ( &SetTimeout));
 
   cmd.AddValue ("SamplingPeriod", "Sampling period", nSamplingPeriod);
+  cmd.AddValue ("Ewma", "EWMA weight of the per-window values (0 disables smoothing)", nEwma);
+  cmd.AddValue ("Flows", "Five-tuple patterns of the flows to monitor, e.g. src=192.168.0.11,dst=10.0.0.5,proto=udp", MakeCallback (&SetFlows));
+  cmd.AddValue ("Report", "File the per-second report is written to (- for stdout)", sReport);
+  cmd.AddValue ("ReportFormat", "Format of the report: text or json", sReportFormat);
+  cmd.AddValue ("ReportFlushMs", "Milliseconds between two flushes of the report", nReportFlushMs);
+  cmd.AddValue ("AllFlows", "Also report the goodput, fairness and per-cell sums of all the flows", bAllFlows);
+  cmd.AddValue ("EndpointProbes", "Only put FlowMonitor probes on the client and server nodes", bEndpointProbes);
+  cmd.AddValue ("AutoStop", "Stop the simulation once the watched flows reach steady state", bAutoStop);
+  cmd.AddValue ("AutoStopPrecision", "Relative half-width of the 95% confidence intervals for AutoStop", nAutoStopPrecision);
+  cmd.AddValue ("ProbeTransit", "Ids of forwarding nodes that also get a probe with EndpointProbes, e.g. 2,4", sProbeTransit);
+  cmd.AddValue ("Flowmon", "FlowMonitor output file: XML at the end, or streamed in binary when it ends in .gz (compressed) or .nsfm", sFlowmon);
+  cmd.AddValue ("FlowmonCheckpoint", "Seconds between two FlowMonitor checkpoints (0: only at the end)", nFlowmonCheckpoint);
+  cmd.AddValue ("PcapBufferKb", "Size of the buffer of each pcap file, in KB, written by a background thread", nPcapBufferKb);
+  cmd.AddValue ("PcapIndex", "Write a time index <pcap>.idx next to each pcap file, an entry every that many seconds, e.g. 0.01 (0: none)", nPcapIndex);
+  cmd.AddValue ("Pcapng", "Capture every device into this single pcapng file, e.g. goal-topo/goal-topo.pcapng (empty: a pcap file per device)", sPcapng);
+  cmd.AddValue ("TraceFormat", "Csma event trace: ascii (goal-topo.tr) or binary (goal-topo.evl, trace-cat converts it to .tr)", sTraceFormat);
+  cmd.AddValue ("AnimFormat", "NetAnim output: xml (goal-topo.xml) or binary (goal-topo.anim.gz, tools/anim-to-xml converts it to XML)", sAnimFormat);
+  cmd.AddValue ("AnimPositionInterval", "Binary animation: seconds between two positions of a node, at least", nAnimPositionInterval);
+  cmd.AddValue ("AnimPositionDistance", "Binary animation: metres between two positions of a node, at least", nAnimPositionDistance);
+  cmd.AddValue ("AnimPositionTolerance", "Binary animation: write positions with velocities, and a new one only when a node strays that many metres from its line (negative: off)", nAnimPositionTolerance);
+  cmd.AddValue ("TraceCompress", "Write the pcap and ascii traces gzip-compressed (.pcap.gz, .tr.gz)", bTraceCompress);
+  cmd.AddValue ("TraceThreads", "Threads compressing the traces with TraceCompress", nTraceThreads);
+  cmd.AddValue ("PcapSnapLen", "Bytes kept of each captured frame (0: the headers up to UDP/TCP only)", nPcapSnapLen);
+  cmd.AddValue ("TraceSampling", "Trace one packet in N, chosen by a hash of its five-tuple and uid", nTraceSampling);
+  cmd.AddValue ("TraceSamplingDevices", "Per-device sampling rates, e.g. 0/1=10,2/2=100 (node/device=N)", sTraceSamplingDevices);
+  cmd.AddValue ("FlightRecorder", "Keep the last N frames of each device in memory, write them to pcap only on a trigger (0: off)", nFlightRecorder);
+  cmd.AddValue ("FlightRecorderWindow", "Only write the frames of the last seconds before a trigger (0: all N)", nFlightRecorderWindow);
+  cmd.AddValue ("FlightRecorderAfter", "Seconds the frames are written as they come after a trigger", nFlightRecorderAfter);
+  cmd.AddValue ("FlightRecorderTriggers", "What triggers the flight recorder: phy,mac,loss,packetin", sFlightRecorderTriggers);
+  cmd.AddValue ("PacketInBurst", "Packet-in messages within one second that trigger the flight recorder", nPacketInBurst);
   cmd.AddValue ("stopTime", "The time to stop", stopTime);
+  cmd.AddValue ("traceStart", "When the tracing starts, in seconds", traceStart);
+  cmd.AddValue ("traceStop", "When the tracing stops, in seconds (0: at the end)", traceStop);
+  cmd.AddValue ("traceWindows", "Trace only within these windows, start-stop in seconds, e.g. 5-10,20-25 (overrides traceStart/traceStop)", traceWindows);
   
   /* for udp-server-client application */
   cmd.AddValue ("MaxPackets", "The total packets available to be scheduled by the UDP application.", nMaxPackets);
@@ -132,209 +261,11 @@ CommandSetup (int argc, char **argv)
   //cmd.AddValue ("MaxBytes", "The amount of data to send in bytes", nMaxBytes);
   
   cmd.Parse (argc, argv);
-  return true;
-}
-
-
-
-/*
- * Calculate Throughput using Flowmonitor
- * 每个探针(probe)会根据四点来对包进行分类
- * -- when packet is `sent`;
- * -- when packet is `forwarded`;
- * -- when packet is `received`;
- * -- when packet is `dropped`;
- * 由于包是在IP层进行track的，所以任何的四层(TCP)重传的包，都会被认为是一个新的包
- */
-void
-ThroughputMonitor (FlowMonitorHelper* fmhelper, Ptr<FlowMonitor> monitor, 
-  Gnuplot2dDataset dataset)
-{
-  
-  double throu   = 0.0;
-  monitor->CheckForLostPackets ();
-  std::map<FlowId, FlowMonitor::FlowStats> flowStats = monitor->GetFlowStats ();
-  /* since fmhelper is a pointer, we should use it as a pointer.
-   * `fmhelper->GetClassifier ()` instead of `fmhelper.GetClassifier ()`
-   */
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (fmhelper->GetClassifier ());
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = flowStats.begin (); i != flowStats.end (); ++i)
-    {
-    /* 
-     * `Ipv4FlowClassifier`
-     * Classifies packets by looking at their IP and TCP/UDP headers. 
-     * FiveTuple五元组是：(source-ip, destination-ip, protocol, source-port, destination-port)
-    */
-
-    /* 每个flow是根据包的五元组(协议，源IP/端口，目的IP/端口)来区分的 */
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-    // `192.168.0.11`是client(Node #14)的IP,
-    // `192.168.0.7` 是client(Node #10)的IP
-    if ((t.sourceAddress=="192.168.0.11" && t.destinationAddress == "10.0.0.5"))
-      {
-          // UDP_PROT_NUMBER = 17
-          if (17 == unsigned(t.protocol))
-          {
-            throu   = i->second.rxBytes * 8.0 / (i->second.timeLastRxPacket.GetSeconds() - i->second.timeFirstTxPacket.GetSeconds())/1024 ;
-            dataset.Add  (Simulator::Now().GetSeconds(), throu);
-          }
-          else
-          {
-            std::cout << "This is not UDP traffic" << std::endl;
-          }
-      }
-
-    }
-  /* check throughput every nSamplingPeriod second(每隔nSamplingPeriod调用依次Simulation)
-   * 表示每隔nSamplingPeriod时间
-   */
-  Simulator::Schedule (Seconds(nSamplingPeriod), &ThroughputMonitor, fmhelper, monitor, 
-    dataset);
-
-}
-
-
-void
-DelayMonitor (FlowMonitorHelper* fmhelper, Ptr<FlowMonitor> monitor, 
-  Gnuplot2dDataset dataset1)
-{
-  
-  double delay   = 0.0;
-  monitor->CheckForLostPackets ();
-  std::map<FlowId, FlowMonitor::FlowStats> flowStats = monitor->GetFlowStats ();
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (fmhelper->GetClassifier ());
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = flowStats.begin (); i != flowStats.end (); ++i)
-    {
-
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-    if ((t.sourceAddress=="192.168.0.11" && t.destinationAddress == "10.0.0.5"))
-      {
-          // UDP_PROT_NUMBER = 17
-          if (17 == unsigned(t.protocol))
-          {
-            delay   = i->second.delaySum.GetSeconds ();
-            dataset1.Add (Simulator::Now().GetSeconds(), delay);
-          }
-          else
-          {
-            std::cout << "This is not UDP traffic" << std::endl;
-          }
-      }
-
-    }
-  Simulator::Schedule (Seconds(nSamplingPeriod), &DelayMonitor, fmhelper, monitor, 
-    dataset1);
-
-}
-
-
-void
-LostPacketsMonitor (FlowMonitorHelper* fmhelper, Ptr<FlowMonitor> monitor, 
-  Gnuplot2dDataset dataset2)
-{
-  
-  double packets = 0.0;
-  monitor->CheckForLostPackets ();
-  std::map<FlowId, FlowMonitor::FlowStats> flowStats = monitor->GetFlowStats ();
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (fmhelper->GetClassifier ());
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = flowStats.begin (); i != flowStats.end (); ++i)
-    {
-
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-    if ((t.sourceAddress=="192.168.0.11" && t.destinationAddress == "10.0.0.5"))
-      {
-          // UDP_PROT_NUMBER = 17
-          if (17 == unsigned(t.protocol))
-          {
-            packets = i->second.lostPackets;
-            dataset2.Add (Simulator::Now().GetSeconds(), packets);
-          }
-          else
-          {
-            std::cout << "This is not UDP traffic" << std::endl;
-          }
-      }
-
-    }
-  Simulator::Schedule (Seconds(nSamplingPeriod), &LostPacketsMonitor, fmhelper, monitor, 
-    dataset2);
-
-}
-
-
-void
-JitterMonitor (FlowMonitorHelper* fmhelper, Ptr<FlowMonitor> monitor, 
-  Gnuplot2dDataset dataset3)
-{
-  
-  double jitter  = 0.0;
-  monitor->CheckForLostPackets ();
-  std::map<FlowId, FlowMonitor::FlowStats> flowStats = monitor->GetFlowStats ();
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (fmhelper->GetClassifier ());
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = flowStats.begin (); i != flowStats.end (); ++i)
+  if (flowSelector.IsEmpty ())
     {
-
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-    if ((t.sourceAddress=="192.168.0.11" && t.destinationAddress == "10.0.0.5"))
-      {
-          // UDP_PROT_NUMBER = 17
-          if (17 == unsigned(t.protocol))
-          {
-            jitter  = i->second.jitterSum.GetSeconds ();
-            dataset3.Add (Simulator::Now().GetSeconds(), jitter);
-          }
-          else
-          {
-            std::cout << "This is not UDP traffic" << std::endl;
-          }
-      }
-
-    }
-  Simulator::Schedule (Seconds(nSamplingPeriod), &JitterMonitor, fmhelper, monitor, 
-    dataset3);
-
-}
-
-
-void PrintParams (FlowMonitorHelper* fmhelper, Ptr<FlowMonitor> monitor){
-  double tempThroughput = 0.0;
-  monitor->CheckForLostPackets(); 
-  std::map<FlowId, FlowMonitor::FlowStats> flowStats = monitor->GetFlowStats();
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (fmhelper->GetClassifier());
-
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = flowStats.begin (); i != flowStats.end (); i++){ 
-      // A tuple: Source-ip, destination-ip, protocol, source-port, destination-port
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-      
-
-    if ((t.sourceAddress=="192.168.0.11" && t.destinationAddress == "10.0.0.5"))
-      {
-          // UDP_PROT_NUMBER = 17
-          if (17 == unsigned(t.protocol))
-          {
-            std::cout<<"Time: " << Simulator::Now ().GetSeconds () << " s," << " Flow " << i->first  << "  Protocol  " << "UDP" << " (" << t.sourceAddress << " -> " << t.destinationAddress << ")" << std::endl;
-
-            std::cout<<"Tx Packets = " << i->second.txPackets<<std::endl;
-            std::cout<<"Rx Packets = " << i->second.rxPackets<<std::endl;
-            std::cout<<"Duration: " <<i->second.timeLastRxPacket.GetSeconds() - i->second.timeFirstTxPacket.GetSeconds()<<std::endl;
-            std::cout<<"Last Received Packet: "<< i->second.timeLastRxPacket.GetSeconds()<<" Seconds"<<std::endl;
-            tempThroughput = (i->second.rxBytes * 8.0 / (i->second.timeLastRxPacket.GetSeconds() - i->second.timeFirstTxPacket.GetSeconds())/1024);
-            std::cout<<"Throughput: "<< tempThroughput <<" Kbps"<<std::endl;
-            std::cout<< "Delay: " << i->second.delaySum.GetSeconds () << std::endl;
-            std::cout<< "LostPackets: " << i->second.lostPackets << std::endl;
-            std::cout<< "Jitter: " << i->second.jitterSum.GetSeconds () << std::endl;
-            //std::cout<<"Last Received Packet: "<< i->second.timeLastRxPacket.GetSeconds()<<" Seconds ---->" << "Throughput: " << tempThroughput << " Kbps" << std::endl;
-            std::cout<<"------------------------------------------"<<std::endl;
-
-          }
-          else
-          {
-            std::cout << "This is not UDP traffic" << std::endl;
-          }
-      }
+      SetFlows (sFlows);
     }
-  // 每隔一秒打印一次
-  Simulator::Schedule(Seconds(1), &PrintParams, fmhelper, monitor);
+  return true;
 }
 
 
@@ -572,12 +503,13 @@ main (int argc, char *argv[])
 
   */
 
-  Ptr<ns3::ofi::LearningController> controller = CreateObject<ns3::ofi::LearningController> ();
+  /* 与 LearningController 相同, 另外在 packet-in 突发时触发飞行记录仪 */
+  Ptr<PacketInTriggerController> controller = CreateObject<PacketInTriggerController> ();
   if (!timeout.IsZero ()) controller->SetAttribute ("ExpirationTime", TimeValue (timeout));
   switchHelper.Install (switchNode1, switch1Device, controller);
   //switchHelper.Install (switchNode2, switch2Device, controller);
 
-  Ptr<ns3::ofi::LearningController> controller2 = CreateObject<ns3::ofi::LearningController> ();
+  Ptr<PacketInTriggerController> controller2 = CreateObject<PacketInTriggerController> ();
   if (!timeout.IsZero ()) controller2->SetAttribute ("ExpirationTime", TimeValue (timeout));
   switchHelper.Install (switchNode2, switch2Device, controller2);
   
@@ -749,24 +681,56 @@ main (int argc, char *argv[])
    * Configure tracing of all enqueue, dequeue, and NetDevice receive events.
    * Trace output will be sent to the file as below
    */
+  TraceCapture capture;
+  capture.SetPcapng (sPcapng);
+  capture.SetPcapIndex (Seconds (nPcapIndex));
+  if (!traceWindows.empty ())
+    {
+      NS_ABORT_MSG_UNLESS (capture.ParseWindows (traceWindows), "Bad traceWindows: " << traceWindows);
+    }
+  else if (traceStart > 0 || traceStop > 0)
+    {
+      NS_ABORT_MSG_IF (traceStop > 0 && traceStop <= traceStart, "traceStop must come after traceStart");
+      capture.AddWindow (Seconds (traceStart), Seconds (traceStop));
+    }
+  capture.SetBufferSize (nPcapBufferKb * 1024);
+  capture.SetCompression (bTraceCompress, nTraceThreads);
+  capture.SetSnapLen (nPcapSnapLen);
+  capture.SetSampling (nTraceSampling);
+  NS_ABORT_MSG_UNLESS (capture.ParseSampling (sTraceSamplingDevices), "Bad TraceSamplingDevices: " << sTraceSamplingDevices);
+  NS_ABORT_MSG_UNLESS (sTraceFormat == "binary" || sTraceFormat == "ascii", "Bad TraceFormat: " << sTraceFormat);
+  capture.SetFlightRecorder (nFlightRecorder, Seconds (nFlightRecorderWindow), Seconds (nFlightRecorderAfter));
+  capture.SetTriggers ((sFlightRecorderTriggers.find ("phy") != std::string::npos ? TraceCapture::TRIGGER_PHY_RX_DROP : 0)
+                       | (sFlightRecorderTriggers.find ("mac") != std::string::npos ? TraceCapture::TRIGGER_MAC_TX_DROP : 0));
+  if (nFlightRecorder > 0 && sFlightRecorderTriggers.find ("packetin") != std::string::npos)
+    {
+      controller->SetTrigger (&capture, nPacketInBurst, Seconds (1));
+      controller2->SetTrigger (&capture, nPacketInBurst, Seconds (1));
+    }
   if (tracing)
     {
-      AsciiTraceHelper ascii;
       //csma.EnablePcapAll("goal-topo");
-      csma.EnableAsciiAll (ascii.CreateFileStream ("goal-topo/goal-topo.tr"));
-      wifiPhy.EnablePcap ("goal-topo/goal-topo-ap1-wifi", apWifi1Device);
-      wifiPhy.EnablePcap ("goal-topo/goal-topo-ap2-wifi", apWifi2Device);
-      wifiPhy.EnablePcap ("goal-topo/goal-topo-ap2-sta1-wifi", stasWifi2Device);
-      wifiPhy.EnablePcap ("goal-topo/goal-topo-ap3-wifi", apWifi3Device);
-      wifiPhy.EnablePcap ("goal-topo/goal-topo-ap3-sta1-wifi", stasWifi3Device);
+      if (sTraceFormat == "ascii")
+        {
+          capture.EnableCsmaAsciiAll ("goal-topo/goal-topo.tr");
+        }
+      else
+        {
+          capture.EnableCsmaEventLog ("goal-topo/goal-topo.evl");
+        }
+      capture.EnableWifi ("goal-topo/goal-topo-ap1-wifi", apWifi1Device);
+      capture.EnableWifi ("goal-topo/goal-topo-ap2-wifi", apWifi2Device);
+      capture.EnableWifi ("goal-topo/goal-topo-ap2-sta1-wifi", stasWifi2Device);
+      capture.EnableWifi ("goal-topo/goal-topo-ap3-wifi", apWifi3Device);
+      capture.EnableWifi ("goal-topo/goal-topo-ap3-sta1-wifi", stasWifi3Device);
       // WifiMacHelper doesnot have `EnablePcap()` method
-      csma.EnablePcap ("goal-topo/goal-topo-switch1-csma", switch1Device);
-      csma.EnablePcap ("goal-topo/goal-topo-switch2-csma", switch2Device);
-      csma.EnablePcap ("goal-topo/goal-topo-ap1-csma", ap1CsmaDevice);
-      csma.EnablePcap ("goal-topo/goal-topo-ap2-csma", ap2CsmaDevice);
-      csma.EnablePcap ("goal-topo/goal-topo-ap3-csma", ap3CsmaDevice);
-      csma.EnablePcap ("goal-topo/goal-topo-H1-csma", hostsDevice.Get(0));
-      csma.EnablePcap ("goal-topo/goal-topo-H2-csma", hostsDevice.Get(1));
+      capture.EnableCsma ("goal-topo/goal-topo-switch1-csma", switch1Device);
+      capture.EnableCsma ("goal-topo/goal-topo-switch2-csma", switch2Device);
+      capture.EnableCsma ("goal-topo/goal-topo-ap1-csma", ap1CsmaDevice);
+      capture.EnableCsma ("goal-topo/goal-topo-ap2-csma", ap2CsmaDevice);
+      capture.EnableCsma ("goal-topo/goal-topo-ap3-csma", ap3CsmaDevice);
+      capture.EnableCsma ("goal-topo/goal-topo-H1-csma", hostsDevice.Get(0));
+      capture.EnableCsma ("goal-topo/goal-topo-H2-csma", hostsDevice.Get(1));
     }
 
   //
@@ -779,119 +743,105 @@ main (int argc, char *argv[])
   //
   //csma.EnablePcapAll ("goal-topo", false);
 
-  AnimationInterface anim ("goal-topo/goal-topo.xml");
-  anim.SetConstantPosition(switchNode1,30,0);             // s1-----node 0
-  anim.SetConstantPosition(switchNode2,65,0);             // s2-----node 1
-  anim.SetConstantPosition(apsNode.Get(0),5,20);      // Ap1----node 2
-  anim.SetConstantPosition(apsNode.Get(1),30,20);      // Ap2----node 3
-  anim.SetConstantPosition(apsNode.Get(2),55,20);      // Ap3----node 4
-  anim.SetConstantPosition(hostsNode.Get(0),65,20);    // H1-----node 5
-  anim.SetConstantPosition(hostsNode.Get(1),75,20);    // H2-----node 6
-  //anim.SetConstantPosition(staWifi3Nodes.Get(0),55,40);  //   -----node 14
-
-  anim.EnablePacketMetadata();   // to see the details of each packet
+  BinaryAnimation::SetConstantPosition(switchNode1,30,0);             // s1-----node 0
+  BinaryAnimation::SetConstantPosition(switchNode2,65,0);             // s2-----node 1
+  BinaryAnimation::SetConstantPosition(apsNode.Get(0),5,20);      // Ap1----node 2
+  BinaryAnimation::SetConstantPosition(apsNode.Get(1),30,20);      // Ap2----node 3
+  BinaryAnimation::SetConstantPosition(apsNode.Get(2),55,20);      // Ap3----node 4
+  BinaryAnimation::SetConstantPosition(hostsNode.Get(0),65,20);    // H1-----node 5
+  BinaryAnimation::SetConstantPosition(hostsNode.Get(1),75,20);    // H2-----node 6
+  //BinaryAnimation::SetConstantPosition(staWifi3Nodes.Get(0),55,40);  //   -----node 14
+
+  NS_ABORT_MSG_UNLESS (sAnimFormat == "binary" || sAnimFormat == "xml", "Bad AnimFormat: " << sAnimFormat);
+  AnimationInterface *anim = 0;
+  BinaryAnimation *binaryAnim = 0;
+  if (sAnimFormat == "xml")
+    {
+      anim = new AnimationInterface ("goal-topo/goal-topo.xml");
+      anim->EnablePacketMetadata ();   // to see the details of each packet
+    }
+  else
+    {
+      binaryAnim = new BinaryAnimation ("goal-topo/goal-topo.anim.gz");
+      binaryAnim->EnablePacketMetadata ();
+      binaryAnim->SetPositionDecimation (Seconds (nAnimPositionInterval), nAnimPositionDistance, nAnimPositionTolerance);
+    }
 
 
 
   NS_LOG_INFO ("------------Preparing for Check all the params.------------");
   FlowMonitorHelper flowmon;
-  Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+  FlowProbePlacement probes;
+  probes.SetEndpointsOnly (bEndpointProbes);
+  probes.AddEndpoints (serverApps);
+  probes.AddEndpoints (clientApps);
+  NS_ABORT_MSG_UNLESS (probes.ParseTransit (sProbeTransit), "Bad node id in ProbeTransit: " << sProbeTransit);
+  Ptr<FlowMonitor> monitor = probes.Install (flowmon);
+  FlowLossTrigger lossTrigger (&capture, monitor);
+  if (nFlightRecorder > 0 && sFlightRecorderTriggers.find ("loss") != std::string::npos)
+    {
+      lossTrigger.Start (Seconds (nSamplingPeriod));
+    }
 
   Simulator::Stop (Seconds(stopTime));
 /*----------------------------------------------------------------------*/
   
-  std::string base = "goal-topo-SDN__";
-  //Throughput
-  std::string throu = base + "ThroughputVSTime";
-  std::string graphicsFileName        = throu + ".png";
-  std::string plotFileName            = throu + ".plt";
-  std::string plotTitle               = "Throughput vs Time";
-  std::string dataTitle               = "Throughput";
-  Gnuplot gnuplot (graphicsFileName);
-  gnuplot.SetTitle (plotTitle);
-  gnuplot.SetTerminal ("png");
-  gnuplot.SetLegend ("Time", "Throughput");
-  Gnuplot2dDataset dataset;
-  dataset.SetTitle (dataTitle);
-  dataset.SetStyle (Gnuplot2dDataset::LINES_POINTS);
-  //Delay
-  std::string delay = base + "DelayVSTime";
-  std::string graphicsFileName1        = delay + ".png";
-  std::string plotFileName1            = delay + ".plt";
-  std::string plotTitle1               = "Delay vs Time";
-  std::string dataTitle1               = "Delay";
-  Gnuplot gnuplot1 (graphicsFileName1);
-  gnuplot1.SetTitle (plotTitle1);
-  gnuplot1.SetTerminal ("png");
-  gnuplot1.SetLegend ("Time", "Delay");
-  Gnuplot2dDataset dataset1;
-  dataset1.SetTitle (dataTitle1);
-  dataset1.SetStyle (Gnuplot2dDataset::LINES_POINTS);
-  //LostPackets
-  std::string lost = base + "LostPacketsVSTime";
-  std::string graphicsFileName2        = lost + ".png";
-  std::string plotFileName2            = lost + ".plt";
-  std::string plotTitle2               = "LostPackets vs Time";
-  std::string dataTitle2               = "LostPackets";
-  Gnuplot gnuplot2 (graphicsFileName2);
-  gnuplot2.SetTitle (plotTitle2);
-  gnuplot2.SetTerminal ("png");
-  gnuplot2.SetLegend ("Time", "LostPackets");
-  Gnuplot2dDataset dataset2;
-  dataset2.SetTitle (dataTitle2);
-  dataset2.SetStyle (Gnuplot2dDataset::LINES_POINTS);
-  //Jitter
-  std::string jitter = base + "JitterVSTime";
-  std::string graphicsFileName3        = jitter + ".png";
-  std::string plotFileName3            = jitter + ".plt";
-  std::string plotTitle3               = "Jitter vs Time";
-  std::string dataTitle3               = "Jitter";
-  Gnuplot gnuplot3 (graphicsFileName3);
-  gnuplot3.SetTitle (plotTitle3);
-  gnuplot3.SetTerminal ("png");
-  gnuplot3.SetLegend ("Time", "Jitter");
-  Gnuplot2dDataset dataset3;
-  dataset3.SetTitle (dataTitle3);
-  dataset3.SetStyle (Gnuplot2dDataset::LINES_POINTS);
-
-/*-----------------------------------------------------*/
-  // 测吞吐量, 延时, 丢包, 抖动, 最后打印出这些参数
-  ThroughputMonitor (&flowmon, monitor, dataset);
-  DelayMonitor      (&flowmon, monitor, dataset1);
-  LostPacketsMonitor(&flowmon, monitor, dataset2);
-  JitterMonitor     (&flowmon, monitor, dataset3);
-  PrintParams       (&flowmon, monitor);
-/*-----------------------------------------------------*/
+  /* 测吞吐量, 延时, 丢包, 抖动, 并每隔一秒打印出这些参数
+   * 所有指标都在同一次抽样中计算 (FlowSampler), 再分发给各个 sink
+   */
+  FlowSampler sampler (&flowmon, monitor);
+  sampler.SetSelector (flowSelector);
+  sampler.SetEwma (nEwma);
+  /* 在server(Node #6)上逐包统计时延, 得到 p50/p90/p99/p99.9 */
+  Ptr<FlowLatencyTracker> latency = Create<FlowLatencyTracker> (flowSelector);
+  latency->Install (hostsNode.Get (1));
+  sampler.SetLatencyTracker (latency);
+  if (bAllFlows)
+    {
+      Ptr<FlowTable> table = Create<FlowTable> (&flowmon, monitor);
+      table->AddCell ("ap1", stasWifi1Interface);
+      table->AddCell ("ap2", stasWifi2Interface);
+      table->AddCell ("ap3", stasWifi3Interface);
+      sampler.SetFlowTable (table);
+    }
+  /* 抽样结果在运行过程中直接写入二进制文件, 画图用 tools/ts-export 离线转换:
+   *   ts-export goal-topo-SDN__TimeSeries.bin gnuplot goal-topo-SDN__
+   */
+  sampler.AddSink (Create<TimeSeriesSampleSink> ("goal-topo-SDN__TimeSeries.bin"));
+  AsyncReporter reporter (sReport, 1 << 20, nReportFlushMs);
+  NS_ABORT_MSG_UNLESS (reporter.IsOpen (), "Cannot open report file " << sReport);
+  sampler.AddSink (Create<ReportSampleSink> (&reporter, Seconds (1),
+                                             sReportFormat == "json" ? ReportSampleSink::JSON : ReportSampleSink::TEXT));
+  Ptr<SteadyStateStopper> stopper;
+  if (bAutoStop)
+    {
+      stopper = Create<SteadyStateStopper> (nAutoStopPrecision);
+      sampler.AddSink (stopper);
+    }
+  sampler.Start (Seconds (nSamplingPeriod));
+  /* the last two parameters (as for SerializeToXmlFile ())
+   * are used respectively to activate/deactivate the histograms and the per-probe detailed stats.
+   */
+  FlowMonitorExporter exporter (sFlowmon, &flowmon, monitor, true, true);
+  NS_ABORT_MSG_UNLESS (exporter.IsOpen (), "Cannot open FlowMonitor file " << sFlowmon);
+  exporter.Start (Seconds (nFlowmonCheckpoint));
 
 
   NS_LOG_INFO ("------------Running Simulation.------------");
   Simulator::Run ();
 
-  //Throughput
-  gnuplot.AddDataset (dataset);
-  std::ofstream plotFile (plotFileName.c_str());
-  gnuplot.GenerateOutput (plotFile);
-  plotFile.close ();
-  //Delay
-  gnuplot1.AddDataset (dataset1);
-  std::ofstream plotFile1 (plotFileName1.c_str());
-  gnuplot1.GenerateOutput (plotFile1);
-  plotFile1.close ();
-  //LostPackets
-  gnuplot2.AddDataset (dataset2);
-  std::ofstream plotFile2 (plotFileName2.c_str());
-  gnuplot2.GenerateOutput (plotFile2);
-  plotFile2.close ();
-  //Jitter
-  gnuplot3.AddDataset (dataset3);
-  std::ofstream plotFile3 (plotFileName3.c_str());
-  gnuplot3.GenerateOutput (plotFile3);
-  plotFile3.close ();
-
-
-  monitor->SerializeToXmlFile("goal-topo/goal-topo.flowmon", true, true);
-  /* the SerializeToXmlFile () function 2nd and 3rd parameters 
-   * are used respectively to activate/deactivate the histograms and the per-probe detailed stats.
-   */
+  sampler.Finish ();
+  reporter.Close ();
+  if (stopper)
+    {
+      stopper->Print (std::cout);
+    }
+  latency->Print (std::cout);
+  capture.PrintTriggers (std::cout);
+
+
+  exporter.Finish ();
   Simulator::Destroy ();
+  delete anim;
+  delete binaryAnim;
 }
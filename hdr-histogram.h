@@ -0,0 +1,273 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * \brief Fixed-memory log-bucketed histogram (HdrHistogram layout).
+ *
+ * Values between `lowest` and `highest` are kept with `significantFigures`
+ * decimal digits of precision: the range is cut in power-of-two buckets,
+ * each split in the same number of linear sub-buckets.  The memory only
+ * depends on the range and the precision, never on the number of values, so
+ * a 20k-packet and a 20M-packet run cost the same.
+ *
+ * Values are plain integers; the latency tracker uses nanoseconds.
+ */
+class HdrHistogram
+{
+public:
+  /**
+   * \param lowest smallest value that can be told apart from 0 (>= 1)
+   * \param highest largest value tracked, larger ones are clamped to it
+   * \param significantFigures 1 to 5
+   */
+  HdrHistogram (uint64_t lowest, uint64_t highest, int significantFigures);
+
+  void Record (uint64_t value);
+  void Reset (void);
+  /// Add the counts of another histogram with the same layout.
+  void Add (const HdrHistogram &other);
+
+  uint64_t GetCount (void) const;
+  uint64_t GetMin (void) const;
+  uint64_t GetMax (void) const;
+  double GetMean (void) const;
+  /// Value below which `percentile` percent of the recorded values fall (0 if empty).
+  uint64_t GetValueAtPercentile (double percentile) const;
+
+private:
+  uint32_t GetIndex (uint64_t value) const;
+  uint64_t GetValueFromIndex (uint32_t index) const;
+  uint64_t GetHighestEquivalentValue (uint64_t value) const;
+  static int Log2 (uint64_t value);
+
+  uint64_t m_highest;
+  int m_unitMagnitude;
+  int m_subBucketCountMagnitude;
+  int m_subBucketHalfCountMagnitude;
+  uint32_t m_subBucketCount;
+  uint32_t m_subBucketHalfCount;
+  uint64_t m_subBucketMask;
+
+  std::vector<uint64_t> m_counts;
+  uint64_t m_total;
+  uint64_t m_min;
+  uint64_t m_max;
+  double m_sum;
+};
+
+
+inline int
+HdrHistogram::Log2 (uint64_t value)
+{
+  int n = -1;
+  while (value != 0)
+    {
+      value >>= 1;
+      n++;
+    }
+  return n;
+}
+
+inline
+HdrHistogram::HdrHistogram (uint64_t lowest, uint64_t highest, int significantFigures)
+  : m_highest (highest)
+{
+  if (lowest < 1)
+    {
+      lowest = 1;
+    }
+  if (significantFigures < 1)
+    {
+      significantFigures = 1;
+    }
+  if (significantFigures > 5)
+    {
+      significantFigures = 5;
+    }
+
+  /* enough linear sub-buckets to tell 1 part in 10^significantFigures apart */
+  uint64_t largestSingleUnit = 2 * static_cast<uint64_t> (std::pow (10.0, significantFigures));
+  m_subBucketCountMagnitude = Log2 (largestSingleUnit - 1) + 1;
+  m_subBucketHalfCountMagnitude = m_subBucketCountMagnitude - 1;
+  m_subBucketCount = 1u << m_subBucketCountMagnitude;
+  m_subBucketHalfCount = m_subBucketCount / 2;
+  m_unitMagnitude = Log2 (lowest);
+  m_subBucketMask = static_cast<uint64_t> (m_subBucketCount - 1) << m_unitMagnitude;
+
+  uint64_t smallestUntrackable = static_cast<uint64_t> (m_subBucketCount) << m_unitMagnitude;
+  uint32_t bucketCount = 1;
+  while (smallestUntrackable <= highest && smallestUntrackable < (UINT64_C (1) << 62))
+    {
+      smallestUntrackable <<= 1;
+      bucketCount++;
+    }
+  m_counts.assign ((bucketCount + 1) * m_subBucketHalfCount, 0);
+  Reset ();
+}
+
+inline void
+HdrHistogram::Reset (void)
+{
+  std::fill (m_counts.begin (), m_counts.end (), 0);
+  m_total = 0;
+  m_min = 0;
+  m_max = 0;
+  m_sum = 0;
+}
+
+inline uint32_t
+HdrHistogram::GetIndex (uint64_t value) const
+{
+  int bucketIndex = Log2 (value | m_subBucketMask) - m_unitMagnitude - m_subBucketHalfCountMagnitude;
+  uint32_t subBucketIndex = static_cast<uint32_t> (value >> (bucketIndex + m_unitMagnitude));
+  return ((bucketIndex + 1) << m_subBucketHalfCountMagnitude) + subBucketIndex - m_subBucketHalfCount;
+}
+
+inline uint64_t
+HdrHistogram::GetValueFromIndex (uint32_t index) const
+{
+  int bucketIndex = static_cast<int> (index >> m_subBucketHalfCountMagnitude) - 1;
+  uint32_t subBucketIndex = (index & (m_subBucketHalfCount - 1)) + m_subBucketHalfCount;
+  if (bucketIndex < 0)
+    {
+      subBucketIndex -= m_subBucketHalfCount;
+      bucketIndex = 0;
+    }
+  return static_cast<uint64_t> (subBucketIndex) << (bucketIndex + m_unitMagnitude);
+}
+
+inline uint64_t
+HdrHistogram::GetHighestEquivalentValue (uint64_t value) const
+{
+  int bucketIndex = Log2 (value | m_subBucketMask) - m_unitMagnitude - m_subBucketHalfCountMagnitude;
+  uint32_t subBucketIndex = static_cast<uint32_t> (value >> (bucketIndex + m_unitMagnitude));
+  int adjustedBucket = (subBucketIndex >= m_subBucketCount) ? bucketIndex + 1 : bucketIndex;
+  uint64_t lowestEquivalent = static_cast<uint64_t> (subBucketIndex) << (bucketIndex + m_unitMagnitude);
+  uint64_t range = UINT64_C (1) << (m_unitMagnitude + adjustedBucket);
+  return lowestEquivalent + range - 1;
+}
+
+inline void
+HdrHistogram::Record (uint64_t value)
+{
+  if (value > m_highest)
+    {
+      value = m_highest;
+    }
+  uint32_t index = GetIndex (value);
+  if (index >= m_counts.size ())
+    {
+      index = m_counts.size () - 1;
+    }
+  m_counts[index]++;
+  if (m_total == 0 || value < m_min)
+    {
+      m_min = value;
+    }
+  if (value > m_max)
+    {
+      m_max = value;
+    }
+  m_total++;
+  m_sum += value;
+}
+
+inline void
+HdrHistogram::Add (const HdrHistogram &other)
+{
+  if (other.m_total == 0 || other.m_counts.size () != m_counts.size ())
+    {
+      return;
+    }
+  for (uint32_t i = 0; i < m_counts.size (); i++)
+    {
+      m_counts[i] += other.m_counts[i];
+    }
+  if (m_total == 0 || other.m_min < m_min)
+    {
+      m_min = other.m_min;
+    }
+  if (other.m_max > m_max)
+    {
+      m_max = other.m_max;
+    }
+  m_total += other.m_total;
+  m_sum += other.m_sum;
+}
+
+inline uint64_t
+HdrHistogram::GetCount (void) const
+{
+  return m_total;
+}
+
+inline uint64_t
+HdrHistogram::GetMin (void) const
+{
+  return m_min;
+}
+
+inline uint64_t
+HdrHistogram::GetMax (void) const
+{
+  return m_max;
+}
+
+inline double
+HdrHistogram::GetMean (void) const
+{
+  return m_total == 0 ? 0.0 : m_sum / m_total;
+}
+
+inline uint64_t
+HdrHistogram::GetValueAtPercentile (double percentile) const
+{
+  if (m_total == 0)
+    {
+      return 0;
+    }
+  if (percentile > 100)
+    {
+      percentile = 100;
+    }
+  uint64_t wanted = static_cast<uint64_t> (std::ceil (percentile / 100.0 * m_total));
+  if (wanted < 1)
+    {
+      wanted = 1;
+    }
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < m_counts.size (); i++)
+    {
+      seen += m_counts[i];
+      if (seen >= wanted)
+        {
+          uint64_t value = GetHighestEquivalentValue (GetValueFromIndex (i));
+          /* never report more than what was actually recorded */
+          return value < m_max ? value : m_max;
+        }
+    }
+  return m_max;
+}
+
+#endif /* HDR_HISTOGRAM_H */
@@ -0,0 +1,54 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PCAP_INDEX_H
+#define PCAP_INDEX_H
+
+/*
+ * The time index of a pcap file, written next to it as "<file>.idx".
+ *
+ *     PcapIndexHeader, once
+ *     PcapIndexEntry for the first record of every interval that has one
+ *
+ * The offsets count the uncompressed bytes of the pcap file, so a reader
+ * seeks straight to them in a plain file; in a ".gz" file gzseek () still
+ * has to decompress up to them, but not parse the records.
+ *
+ * PcapWriter writes it, PcapReader::SeekTime () (trace-reader.h) uses it.
+ *
+ * This file does not depend on ns-3.
+ */
+
+#include <stdint.h>
+
+static const uint32_t PCAP_INDEX_VERSION = 1;
+
+struct PcapIndexHeader
+{
+  char magic[8];                //!< "NS3PIDX\0"
+  uint32_t version;             //!< PCAP_INDEX_VERSION
+  uint32_t entrySize;           //!< sizeof (PcapIndexEntry)
+  uint64_t intervalNs;          //!< one entry per interval, at most
+};
+
+struct PcapIndexEntry
+{
+  int64_t timeNs;               //!< time of the record
+  uint64_t uid;                 //!< ns-3 packet uid of the record
+  uint64_t offset;              //!< of the record header, in the pcap file
+};
+
+#endif /* PCAP_INDEX_H */
@@ -0,0 +1,361 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PCAP_WRITER_H
+#define PCAP_WRITER_H
+
+/*
+ * Classic libpcap files (microsecond timestamps, host byte order, the same
+ * format ns-3's PcapFile writes) on top of an AsyncTraceFile, and the
+ * header parsing behind the header-only and sampled captures.
+ *
+ * A PcapWriter can also write the time index of its file (pcap-index.h).
+ *
+ * This file does not depend on ns-3.
+ */
+
+#include "pcap-index.h"
+#include "trace-io.h"
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+
+enum PcapLinkType
+{
+  PCAP_LINK_EN10MB = 1,               //!< Ethernet, what CsmaHelper writes
+  PCAP_LINK_IEEE802_11 = 105,
+  PCAP_LINK_IEEE802_11_RADIO = 127    //!< radiotap + 802.11
+};
+
+/// Bytes of a frame PcapParseFrame () may need to look at.
+static const uint32_t PCAP_MAX_HEADERS = 192;
+
+/**
+ * \brief What PcapParseFrame () found in a frame.
+ */
+struct PcapFrameInfo
+{
+  uint32_t headersLength;         //!< link, IP and transport headers, or the whole frame
+  bool ipv4;                      //!< false: the fields below are zero
+  uint32_t sourceAddress;
+  uint32_t destinationAddress;
+  uint8_t protocol;
+  uint16_t sourcePort;            //!< UDP and TCP only
+  uint16_t destinationPort;
+  uint16_t identification;        //!< the IPv4 identification field
+  uint16_t totalLength;           //!< the IPv4 total length, IP header included
+};
+
+/**
+ * \brief Parse the headers at the start of a frame.
+ *
+ * The link header (Ethernet, DIX or LLC/SNAP, or 802.11 with LLC/SNAP),
+ * then IPv4 and its UDP, TCP or ICMP header: info.headersLength is
+ * everything but the payload.  Frames that carry no payload of interest
+ * (802.11 control and management, ARP, ...) and frames that cannot be
+ * parsed are kept whole.
+ *
+ * \param linkType PCAP_LINK_EN10MB or PCAP_LINK_IEEE802_11 (no radiotap)
+ * \param frame the first bytes of the frame
+ * \param available bytes in frame, at most the frame length
+ * \param length the frame length
+ * \param info filled in; headersLength is at most length, and more than
+ *        available when the headers are longer
+ * \returns info.ipv4
+ */
+inline bool
+PcapParseFrame (uint32_t linkType, const uint8_t *frame, uint32_t available, uint32_t length, PcapFrameInfo &info)
+{
+  std::memset (&info, 0, sizeof (info));
+  info.headersLength = length;
+  uint32_t offset;
+  uint16_t etherType;
+  if (linkType == PCAP_LINK_EN10MB)
+    {
+      if (available < 14)
+        {
+          return false;
+        }
+      etherType = (frame[12] << 8) | frame[13];
+      offset = 14;
+      if (etherType < 0x0600)
+        {
+          /* 802.3 length, then LLC/SNAP */
+          if (available < 22)
+            {
+              return false;
+            }
+          etherType = (frame[20] << 8) | frame[21];
+          offset = 22;
+        }
+    }
+  else if (linkType == PCAP_LINK_IEEE802_11)
+    {
+      if (available < 2)
+        {
+          return false;
+        }
+      uint16_t control = frame[0] | (frame[1] << 8);
+      uint8_t type = (control >> 2) & 0x3;
+      uint8_t subtype = (control >> 4) & 0xf;
+      if (type != 2 || (subtype & 0x4))
+        {
+          /* management, control, or data without a body */
+          return false;
+        }
+      offset = 24;
+      if ((control & 0x0300) == 0x0300)
+        {
+          offset += 6;            // fourth address
+        }
+      if (subtype & 0x8)
+        {
+          offset += 2;            // QoS control
+          if (control & 0x8000)
+            {
+              offset += 4;        // HT control
+            }
+        }
+      if (available < offset + 8)
+        {
+          return false;
+        }
+      etherType = (frame[offset + 6] << 8) | frame[offset + 7];
+      offset += 8;                // LLC/SNAP
+    }
+  else
+    {
+      return false;
+    }
+
+  if (etherType != 0x0800 || available < offset + 20)
+    {
+      return false;
+    }
+  const uint8_t *ip = frame + offset;
+  info.ipv4 = true;
+  info.identification = (ip[4] << 8) | ip[5];
+  info.totalLength = (ip[2] << 8) | ip[3];
+  info.protocol = ip[9];
+  info.sourceAddress = (ip[12] << 24) | (ip[13] << 16) | (ip[14] << 8) | ip[15];
+  info.destinationAddress = (ip[16] << 24) | (ip[17] << 16) | (ip[18] << 8) | ip[19];
+  offset += (ip[0] & 0xf) * 4;
+  if ((info.protocol == 6 || info.protocol == 17) && available >= offset + 4)
+    {
+      info.sourcePort = (frame[offset] << 8) | frame[offset + 1];
+      info.destinationPort = (frame[offset + 2] << 8) | frame[offset + 3];
+    }
+  if (info.protocol == 6)
+    {
+      if (available < offset + 13)
+        {
+          return true;
+        }
+      offset += (frame[offset + 12] >> 4) * 4;
+    }
+  else if (info.protocol == 17 || info.protocol == 1)
+    {
+      offset += 8;
+    }
+  info.headersLength = offset < length ? offset : length;
+  return true;
+}
+
+/**
+ * \brief Sampling hash of a packet: its five-tuple and its uid, mixed.
+ *
+ * The uid and the headers a packet carries do not change from hop to hop,
+ * so neither does the hash: a packet is sampled everywhere or nowhere.
+ */
+inline uint64_t
+PcapSampleHash (const PcapFrameInfo &info, uint64_t uid)
+{
+  /* splitmix64 finalizer */
+  struct Mix
+  {
+    static uint64_t Do (uint64_t x)
+    {
+      x ^= x >> 30;
+      x *= 0xbf58476d1ce4e5b9ULL;
+      x ^= x >> 27;
+      x *= 0x94d049bb133111ebULL;
+      return x ^ (x >> 31);
+    }
+  };
+  uint64_t addresses = (uint64_t (info.sourceAddress) << 32) | info.destinationAddress;
+  uint64_t rest = (uint64_t (info.protocol) << 32) | (uint32_t (info.sourcePort) << 16) | info.destinationPort;
+  return Mix::Do (Mix::Do (Mix::Do (addresses) ^ rest) ^ uid);
+}
+
+/**
+ * \brief Threshold of PcapSampleHash () to keep one packet in oneIn.
+ *
+ * A packet is kept when its hash is below the threshold; the packets kept
+ * at a rate are also kept at any higher rate.
+ */
+inline uint64_t
+PcapSampleThreshold (uint32_t oneIn)
+{
+  return oneIn <= 1 ? ~uint64_t (0) : ~uint64_t (0) / oneIn;
+}
+
+/**
+ * \brief Writes one pcap file through the trace I/O thread.
+ */
+class PcapWriter
+{
+public:
+  PcapWriter ();
+
+  /**
+   * \param filename the pcap file
+   * \param linkType one of PcapLinkType
+   * \param snapLen the largest record kept; longer packets are truncated
+   * \param io the thread that writes the buffers
+   * \param indexIntervalNs when not zero, also write "<filename>.idx" with
+   *        an entry for the first record of every interval that long
+   */
+  bool Open (std::string filename, uint32_t linkType, uint32_t snapLen, TraceIoThread *io,
+             uint64_t indexIntervalNs = 0);
+  bool IsOpen (void) const;
+  uint32_t GetSnapLen (void) const;
+  /**
+   * Write one record: prefix (e.g. a radiotap header, may be empty) followed
+   * by data, truncated to the snaplen.
+   * \param timeNs the simulation time, in nanoseconds
+   * \param originalLength the length of the frame on the wire, prefix included
+   * \param uid the packet uid, for the index
+   */
+  void Write (uint64_t timeNs, const uint8_t *prefix, uint32_t prefixLength,
+              const uint8_t *data, uint32_t dataLength, uint32_t originalLength, uint64_t uid = 0);
+  void Flush (void);
+  void Close (void);
+
+private:
+  AsyncTraceFile m_file;
+  uint32_t m_snapLen;
+  AsyncTraceFile m_index;
+  uint64_t m_indexInterval;
+  uint64_t m_nextIndex;           //!< the next record at or after it gets an entry
+};
+
+
+inline
+PcapWriter::PcapWriter ()
+  : m_snapLen (0),
+    m_indexInterval (0),
+    m_nextIndex (0)
+{
+}
+
+inline bool
+PcapWriter::Open (std::string filename, uint32_t linkType, uint32_t snapLen, TraceIoThread *io,
+                  uint64_t indexIntervalNs)
+{
+  if (!m_file.Open (filename, io))
+    {
+      return false;
+    }
+  m_indexInterval = indexIntervalNs;
+  m_nextIndex = 0;
+  if (m_indexInterval > 0)
+    {
+      if (!m_index.Open (filename + ".idx", io))
+        {
+          m_file.Close ();
+          return false;
+        }
+      PcapIndexHeader header;
+      std::memcpy (header.magic, "NS3PIDX", 8);
+      header.version = PCAP_INDEX_VERSION;
+      header.entrySize = sizeof (PcapIndexEntry);
+      header.intervalNs = m_indexInterval;
+      m_index.Write (&header, sizeof (header));
+    }
+  m_snapLen = snapLen;
+  uint32_t magic = 0xa1b2c3d4;
+  uint16_t major = 2, minor = 4;
+  int32_t zone = 0;
+  uint32_t sigFigs = 0;
+  m_file.Write (&magic, 4);
+  m_file.Write (&major, 2);
+  m_file.Write (&minor, 2);
+  m_file.Write (&zone, 4);
+  m_file.Write (&sigFigs, 4);
+  m_file.Write (&snapLen, 4);
+  m_file.Write (&linkType, 4);
+  return true;
+}
+
+inline bool
+PcapWriter::IsOpen (void) const
+{
+  return m_file.IsOpen ();
+}
+
+inline uint32_t
+PcapWriter::GetSnapLen (void) const
+{
+  return m_snapLen;
+}
+
+inline void
+PcapWriter::Write (uint64_t timeNs, const uint8_t *prefix, uint32_t prefixLength,
+                   const uint8_t *data, uint32_t dataLength, uint32_t originalLength, uint64_t uid)
+{
+  if (m_indexInterval > 0 && timeNs >= m_nextIndex)
+    {
+      PcapIndexEntry entry;
+      entry.timeNs = timeNs;
+      entry.uid = uid;
+      entry.offset = m_file.GetOffset ();
+      m_index.Write (&entry, sizeof (entry));
+      m_nextIndex = (timeNs / m_indexInterval + 1) * m_indexInterval;
+    }
+  if (prefixLength > m_snapLen)
+    {
+      prefixLength = m_snapLen;
+    }
+  if (dataLength > m_snapLen - prefixLength)
+    {
+      dataLength = m_snapLen - prefixLength;
+    }
+  uint32_t record[4];
+  record[0] = timeNs / 1000000000;
+  record[1] = (timeNs / 1000) % 1000000;
+  record[2] = prefixLength + dataLength;
+  record[3] = originalLength;
+  m_file.Write (record, sizeof (record));
+  m_file.Write (prefix, prefixLength);
+  m_file.Write (data, dataLength);
+}
+
+inline void
+PcapWriter::Flush (void)
+{
+  m_file.Flush ();
+  m_index.Flush ();
+}
+
+inline void
+PcapWriter::Close (void)
+{
+  m_file.Close ();
+  m_index.Close ();
+}
+
+#endif /* PCAP_WRITER_H */
@@ -0,0 +1,214 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PCAPNG_WRITER_H
+#define PCAPNG_WRITER_H
+
+/*
+ * One pcapng file for many devices, on top of an AsyncTraceFile.
+ *
+ *     Section Header Block
+ *     Interface Description Block per device: link type, snaplen,
+ *         if_name, if_tsresol = 9 (nanosecond timestamps)
+ *     Enhanced Packet Block per frame: interface id, timestamp, lengths,
+ *         data, then the options
+ *           epb_packetid (5) : the ns-3 packet uid, uint64_t
+ *           opt_comment (1)  : "node=<id>", the node the device is on
+ *
+ * Host byte order, as the byte-order magic of the section header says.
+ * Wireshark, tshark and tcpdump read it; trace-reader.h reads it back.
+ *
+ * This file does not depend on ns-3.
+ */
+
+#include "trace-io.h"
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum PcapngBlockType
+{
+  PCAPNG_SECTION_HEADER = 0x0a0d0d0a,
+  PCAPNG_INTERFACE_DESCRIPTION = 1,
+  PCAPNG_ENHANCED_PACKET = 6
+};
+
+enum PcapngOptionCode
+{
+  PCAPNG_OPT_END = 0,
+  PCAPNG_OPT_COMMENT = 1,
+  PCAPNG_IF_NAME = 2,
+  PCAPNG_IF_TSRESOL = 9,
+  PCAPNG_EPB_PACKETID = 5
+};
+
+/**
+ * \brief Writes a pcapng file through the trace I/O thread.
+ */
+class PcapngWriter
+{
+public:
+  PcapngWriter ();
+
+  bool Open (std::string filename, TraceIoThread *io);
+  bool IsOpen (void) const;
+  /**
+   * Describe an interface (write its IDB) before its first packet.
+   * \returns the interface id for Write ()
+   */
+  uint32_t AddInterface (uint32_t linkType, uint32_t snapLen, std::string name);
+  /**
+   * Write one Enhanced Packet Block: prefix (may be empty) followed by
+   * data, truncated to the snaplen of the interface.
+   */
+  void Write (uint32_t interface, uint64_t timeNs, const uint8_t *prefix, uint32_t prefixLength,
+              const uint8_t *data, uint32_t dataLength, uint32_t originalLength,
+              uint64_t packetId, uint32_t nodeId);
+  void Flush (void);
+  void Close (void);
+
+private:
+  void WriteOption (uint16_t code, const void *value, uint16_t length);
+  void Pad (uint32_t length);
+
+  AsyncTraceFile m_file;
+  std::vector<uint32_t> m_snapLens;     //!< per interface
+};
+
+
+inline
+PcapngWriter::PcapngWriter ()
+{
+}
+
+inline bool
+PcapngWriter::Open (std::string filename, TraceIoThread *io)
+{
+  if (!m_file.Open (filename, io))
+    {
+      return false;
+    }
+  m_snapLens.clear ();
+  uint32_t type = PCAPNG_SECTION_HEADER;
+  uint32_t length = 28;
+  uint32_t magic = 0x1a2b3c4d;
+  uint16_t version[2] = { 1, 0 };
+  int64_t sectionLength = -1;       // not known
+  m_file.Write (&type, 4);
+  m_file.Write (&length, 4);
+  m_file.Write (&magic, 4);
+  m_file.Write (version, 4);
+  m_file.Write (&sectionLength, 8);
+  m_file.Write (&length, 4);
+  return true;
+}
+
+inline bool
+PcapngWriter::IsOpen (void) const
+{
+  return m_file.IsOpen ();
+}
+
+inline void
+PcapngWriter::Pad (uint32_t length)
+{
+  static const uint8_t zeros[4] = { 0, 0, 0, 0 };
+  m_file.Write (zeros, (4 - length % 4) % 4);
+}
+
+inline void
+PcapngWriter::WriteOption (uint16_t code, const void *value, uint16_t length)
+{
+  m_file.Write (&code, 2);
+  m_file.Write (&length, 2);
+  m_file.Write (value, length);
+  Pad (length);
+}
+
+inline uint32_t
+PcapngWriter::AddInterface (uint32_t linkType, uint32_t snapLen, std::string name)
+{
+  if (name.size () > 0xffff)
+    {
+      name.resize (0xffff);
+    }
+  uint32_t nameLength = (name.size () + 3) / 4 * 4;
+  uint32_t type = PCAPNG_INTERFACE_DESCRIPTION;
+  /* header, link type + reserved, snaplen, if_name, if_tsresol, end, trailer */
+  uint32_t length = 8 + 4 + 4 + (4 + nameLength) + (4 + 4) + 4 + 4;
+  uint16_t link[2] = { static_cast<uint16_t> (linkType), 0 };
+  uint8_t resolution = 9;
+  m_file.Write (&type, 4);
+  m_file.Write (&length, 4);
+  m_file.Write (link, 4);
+  m_file.Write (&snapLen, 4);
+  WriteOption (PCAPNG_IF_NAME, name.data (), name.size ());
+  WriteOption (PCAPNG_IF_TSRESOL, &resolution, 1);
+  WriteOption (PCAPNG_OPT_END, 0, 0);
+  m_file.Write (&length, 4);
+  m_snapLens.push_back (snapLen);
+  return m_snapLens.size () - 1;
+}
+
+inline void
+PcapngWriter::Write (uint32_t interface, uint64_t timeNs, const uint8_t *prefix, uint32_t prefixLength,
+                     const uint8_t *data, uint32_t dataLength, uint32_t originalLength,
+                     uint64_t packetId, uint32_t nodeId)
+{
+  uint32_t snapLen = m_snapLens[interface];
+  if (prefixLength > snapLen)
+    {
+      prefixLength = snapLen;
+    }
+  if (dataLength > snapLen - prefixLength)
+    {
+      dataLength = snapLen - prefixLength;
+    }
+  char comment[16];
+  uint16_t commentLength = std::snprintf (comment, sizeof (comment), "node=%u", nodeId);
+  uint32_t captured = prefixLength + dataLength;
+  uint32_t padded = (captured + 3) / 4 * 4;
+  uint32_t type = PCAPNG_ENHANCED_PACKET;
+  /* header, interface, timestamp, lengths, data, packet id, comment, end, trailer */
+  uint32_t length = 8 + 4 + 8 + 8 + padded + (4 + 8) + (4 + (commentLength + 3) / 4 * 4) + 4 + 4;
+  uint32_t block[7] = { type, length, interface,
+                        static_cast<uint32_t> (timeNs >> 32), static_cast<uint32_t> (timeNs),
+                        captured, originalLength };
+  m_file.Write (block, sizeof (block));
+  m_file.Write (prefix, prefixLength);
+  m_file.Write (data, dataLength);
+  Pad (captured);
+  WriteOption (PCAPNG_EPB_PACKETID, &packetId, 8);
+  WriteOption (PCAPNG_OPT_COMMENT, comment, commentLength);
+  WriteOption (PCAPNG_OPT_END, 0, 0);
+  m_file.Write (&length, 4);
+}
+
+inline void
+PcapngWriter::Flush (void)
+{
+  m_file.Flush ();
+}
+
+inline void
+PcapngWriter::Close (void)
+{
+  m_file.Close ();
+}
+
+#endif /* PCAPNG_WRITER_H */
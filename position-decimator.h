@@ -0,0 +1,185 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef POSITION_DECIMATOR_H
+#define POSITION_DECIMATOR_H
+
+/*
+ * The decimation of the node positions in the animation trace.
+ *
+ * Every course change and every mobility poll offers the position of a
+ * node; the decimator keeps the last one written per node and lets a new
+ * one through only when it is far enough from where the viewer already
+ * puts the node, and not too soon after the last one.
+ *
+ * Without linear compression the viewer keeps a node where it was last
+ * put.  With it, it moves the node on at the velocity written with the
+ * position (ANIM_MOTION, tools/anim-to-xml interpolates), so a node going
+ * straight costs one record per segment, whatever the number of polls and
+ * course changes along it.
+ *
+ * This file does not depend on ns-3.
+ */
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+
+/**
+ * \brief Which position updates of the nodes are worth writing.
+ */
+class PositionDecimator
+{
+public:
+  PositionDecimator ();
+
+  /// No update of a node within interval of its last one; zero by default.
+  void SetMinInterval (int64_t intervalNs);
+  /// No update closer than distance to where the node already is; zero by default.
+  void SetMinDistance (double distance);
+  /**
+   * Linear-segment compression: a node moves on at its last written
+   * velocity, and an update is only written once the node is more than
+   * tolerance away from there, or its velocity changed.  Negative (the
+   * default) turns it off.
+   */
+  void SetTolerance (double tolerance);
+  /// Whether the velocity goes with the positions (SetTolerance () >= 0).
+  bool IsLinear (void) const;
+
+  /**
+   * Whether the position is to be written; when it is, it becomes the last
+   * one of the node.  The first position of a node is always written.
+   */
+  bool Accept (uint32_t node, int64_t timeNs, double x, double y, double vx = 0, double vy = 0);
+  /// Forget the last positions, so that the next one of each node is written.
+  void Reset (void);
+
+  uint64_t GetAccepted (void) const;
+  uint64_t GetDropped (void) const;
+
+private:
+  struct Last
+  {
+    bool valid;
+    int64_t timeNs;
+    double x, y;
+    double vx, vy;
+  };
+
+  int64_t m_minInterval;
+  double m_minDistance;
+  double m_tolerance;
+  std::vector<Last> m_last;
+  uint64_t m_accepted;
+  uint64_t m_dropped;
+};
+
+
+inline
+PositionDecimator::PositionDecimator ()
+  : m_minInterval (0),
+    m_minDistance (0),
+    m_tolerance (-1),
+    m_accepted (0),
+    m_dropped (0)
+{
+}
+
+inline void
+PositionDecimator::SetMinInterval (int64_t intervalNs)
+{
+  m_minInterval = intervalNs;
+}
+
+inline void
+PositionDecimator::SetMinDistance (double distance)
+{
+  m_minDistance = distance;
+}
+
+inline void
+PositionDecimator::SetTolerance (double tolerance)
+{
+  m_tolerance = tolerance;
+}
+
+inline bool
+PositionDecimator::IsLinear (void) const
+{
+  return m_tolerance >= 0;
+}
+
+inline bool
+PositionDecimator::Accept (uint32_t node, int64_t timeNs, double x, double y, double vx, double vy)
+{
+  if (node >= m_last.size ())
+    {
+      Last none = { false, 0, 0, 0, 0, 0 };
+      m_last.resize (node + 1, none);
+    }
+  Last &last = m_last[node];
+  if (last.valid)
+    {
+      if (timeNs - last.timeNs < m_minInterval)
+        {
+          m_dropped++;
+          return false;
+        }
+      /* where the viewer has the node now */
+      double seconds = (timeNs - last.timeNs) / 1e9;
+      double dx = x - (last.x + last.vx * seconds);
+      double dy = y - (last.y + last.vy * seconds);
+      double deviation = std::sqrt (dx * dx + dy * dy);
+      /* a course change where the node stands (a new leg, a pause, a
+       * reflection) deviates by nothing yet, but the viewer needs the new
+       * velocity or it keeps the node on the old line */
+      bool turned = IsLinear () && (vx != last.vx || vy != last.vy);
+      if (!turned && (deviation == 0 || deviation < m_minDistance || (IsLinear () && deviation <= m_tolerance)))
+        {
+          m_dropped++;
+          return false;
+        }
+    }
+  last.valid = true;
+  last.timeNs = timeNs;
+  last.x = x;
+  last.y = y;
+  last.vx = IsLinear () ? vx : 0;
+  last.vy = IsLinear () ? vy : 0;
+  m_accepted++;
+  return true;
+}
+
+inline void
+PositionDecimator::Reset (void)
+{
+  m_last.clear ();
+}
+
+inline uint64_t
+PositionDecimator::GetAccepted (void) const
+{
+  return m_accepted;
+}
+
+inline uint64_t
+PositionDecimator::GetDropped (void) const
+{
+  return m_dropped;
+}
+
+#endif /* POSITION_DECIMATOR_H */
@@ -0,0 +1,320 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STEADY_STATE_H
+#define STEADY_STATE_H
+
+#include "ns3/core-module.h"
+
+#include "flow-sampler.h"
+
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Steady-state test of one series of window values.
+ *
+ * The warm-up is removed with MSER-5: the series is cut in batches of 5
+ * observations and the truncation point is the number of leading batches
+ * whose removal minimizes the standard error of the remaining mean, searched
+ * in the first half of the series only (a minimum on the boundary means the
+ * series is still drifting).  The remaining observations are then split in
+ * 10 batch means, which gives a 95% confidence interval on the mean.
+ */
+class SteadyStateSeries
+{
+public:
+  SteadyStateSeries ();
+
+  void Add (double time, double value);
+  uint32_t GetN (void) const;
+  /**
+   * Run the test; true when the series is past its warm-up and the
+   * half-width of the confidence interval is at most precision * |mean|.
+   */
+  bool Test (double precision, uint32_t minObservations);
+
+  double GetMean (void) const;
+  double GetHalfWidth (void) const;
+  /// Time of the first observation kept after the warm-up.
+  double GetWarmupEnd (void) const;
+
+private:
+  static const uint32_t MSER_BATCH = 5;
+  static const uint32_t BATCHES = 10;
+
+  std::vector<double> m_times;
+  std::vector<double> m_values;
+  double m_mean;
+  double m_halfWidth;
+  double m_warmupEnd;
+};
+
+/**
+ * \brief Stops the simulation once every watched flow reached steady state.
+ *
+ * A FlowSampleSink: it follows the window throughput and the window delay
+ * of every flow the sampler watches, runs the steady-state test on both
+ * series every checkInterval, and calls Simulator::Stop () as soon as all
+ * of them are within the precision target.  Print () gives the stopping
+ * time with the estimates, to go with the final report.
+ */
+class SteadyStateStopper : public FlowSampleSink
+{
+public:
+  /**
+   * \param precision target relative half-width of the 95% confidence intervals
+   * \param checkInterval time between two tests
+   * \param minObservations windows needed before the first test
+   */
+  SteadyStateStopper (double precision = 0.05, Time checkInterval = Seconds (1), uint32_t minObservations = 50);
+
+  virtual void Record (const FlowSample &sample);
+  virtual void EndOfPass (Time now);
+
+  /// True if the run was stopped early.
+  bool IsStopped (void) const;
+  Time GetStopTime (void) const;
+  void Print (std::ostream &os) const;
+
+private:
+  struct Flow
+  {
+    SteadyStateSeries throughput;
+    SteadyStateSeries delay;
+  };
+
+  double m_precision;
+  Time m_checkInterval;
+  uint32_t m_minObservations;
+  Time m_nextCheck;
+  bool m_stopped;
+  bool m_over;         //!< got the samples FlowSampler::Finish () takes
+  Time m_stopTime;
+  std::map<FlowId, Flow> m_flows;
+};
+
+
+inline
+SteadyStateSeries::SteadyStateSeries ()
+  : m_mean (0),
+    m_halfWidth (0),
+    m_warmupEnd (0)
+{
+}
+
+inline void
+SteadyStateSeries::Add (double time, double value)
+{
+  m_times.push_back (time);
+  m_values.push_back (value);
+}
+
+inline uint32_t
+SteadyStateSeries::GetN (void) const
+{
+  return m_values.size ();
+}
+
+inline bool
+SteadyStateSeries::Test (double precision, uint32_t minObservations)
+{
+  uint32_t m = m_values.size () / MSER_BATCH;
+  if (m_values.size () < minObservations || m < 2 * BATCHES)
+    {
+      return false;
+    }
+
+  /* MSER-5: batch means, then the truncation d <= m / 2 minimizing
+   * sum_{j >= d} (b_j - mean_d)^2 / (m - d)^2, from the end backwards so
+   * that the suffix sums come for free */
+  std::vector<double> b (m);
+  for (uint32_t j = 0; j < m; j++)
+    {
+      double sum = 0;
+      for (uint32_t k = 0; k < MSER_BATCH; k++)
+        {
+          sum += m_values[j * MSER_BATCH + k];
+        }
+      b[j] = sum / MSER_BATCH;
+    }
+  double sum = 0, sumOfSquares = 0, best = 0;
+  uint32_t truncation = m;
+  for (uint32_t d = m; d-- > 0; )
+    {
+      sum += b[d];
+      sumOfSquares += b[d] * b[d];
+      if (d > m / 2)
+        {
+          continue;
+        }
+      double n = m - d;
+      double mser = (sumOfSquares - sum * sum / n) / (n * n);
+      if (truncation == m || mser <= best)
+        {
+          best = mser;
+          truncation = d;
+        }
+    }
+  if (truncation == m / 2)
+    {
+      return false;
+    }
+
+  /* batch means on what is left; the windows that do not fill a batch are
+   * taken from its start, the latest ones count most for stopping */
+  uint32_t first = truncation * MSER_BATCH;
+  m_warmupEnd = m_times[first];
+  uint32_t size = (m_values.size () - first) / BATCHES;
+  first = m_values.size () - size * BATCHES;
+  double means[BATCHES];
+  double total = 0;
+  for (uint32_t k = 0; k < BATCHES; k++)
+    {
+      double s = 0;
+      for (uint32_t i = 0; i < size; i++)
+        {
+          s += m_values[first + k * size + i];
+        }
+      means[k] = s / size;
+      total += means[k];
+    }
+  m_mean = total / BATCHES;
+  double variance = 0;
+  for (uint32_t k = 0; k < BATCHES; k++)
+    {
+      variance += (means[k] - m_mean) * (means[k] - m_mean);
+    }
+  variance /= BATCHES - 1;
+  /* Student's t, 9 degrees of freedom, 97.5% */
+  m_halfWidth = 2.262 * std::sqrt (variance / BATCHES);
+  return m_halfWidth <= precision * std::fabs (m_mean);
+}
+
+inline double
+SteadyStateSeries::GetMean (void) const
+{
+  return m_mean;
+}
+
+inline double
+SteadyStateSeries::GetHalfWidth (void) const
+{
+  return m_halfWidth;
+}
+
+inline double
+SteadyStateSeries::GetWarmupEnd (void) const
+{
+  return m_warmupEnd;
+}
+
+
+inline
+SteadyStateStopper::SteadyStateStopper (double precision, Time checkInterval, uint32_t minObservations)
+  : m_precision (precision),
+    m_checkInterval (checkInterval),
+    m_minObservations (minObservations),
+    m_stopped (false),
+    m_over (false)
+{
+  NS_ASSERT_MSG (precision > 0, "Steady-state precision must be positive");
+}
+
+inline void
+SteadyStateStopper::Record (const FlowSample &sample)
+{
+  m_over = m_over || sample.last;
+  if (m_stopped || sample.window.duration.IsZero () || sample.stats->txPackets == 0)
+    {
+      /* nothing sent yet: not part of the series */
+      return;
+    }
+  Flow &flow = m_flows[sample.flowId];
+  double now = sample.time.GetSeconds ();
+  flow.throughput.Add (now, sample.window.throughput);
+  /* an empty window has no delay */
+  if (sample.window.rxPackets > 0)
+    {
+      flow.delay.Add (now, sample.window.delay);
+    }
+}
+
+inline void
+SteadyStateStopper::EndOfPass (Time now)
+{
+  if (m_stopped || m_over || now < m_nextCheck || m_flows.empty ())
+    {
+      return;
+    }
+  m_nextCheck = now + m_checkInterval;
+  bool steady = true;
+  for (std::map<FlowId, Flow>::iterator f = m_flows.begin (); f != m_flows.end (); ++f)
+    {
+      /* run both tests, so that Print () has current estimates */
+      bool throughput = f->second.throughput.Test (m_precision, m_minObservations);
+      bool delay = f->second.delay.Test (m_precision, m_minObservations);
+      steady = steady && throughput && delay;
+    }
+  if (steady)
+    {
+      m_stopped = true;
+      m_stopTime = now;
+      Simulator::Stop ();
+    }
+}
+
+inline bool
+SteadyStateStopper::IsStopped (void) const
+{
+  return m_stopped;
+}
+
+inline Time
+SteadyStateStopper::GetStopTime (void) const
+{
+  return m_stopTime;
+}
+
+inline void
+SteadyStateStopper::Print (std::ostream &os) const
+{
+  if (m_stopped)
+    {
+      os << "Steady state reached, simulation stopped at " << m_stopTime.GetSeconds () << " s" << std::endl;
+    }
+  else
+    {
+      os << "Steady state not reached (precision " << m_precision * 100 << "%), ran to the end" << std::endl;
+    }
+  for (std::map<FlowId, Flow>::const_iterator f = m_flows.begin (); f != m_flows.end (); ++f)
+    {
+      const SteadyStateSeries &t = f->second.throughput;
+      const SteadyStateSeries &d = f->second.delay;
+      os << "  Flow " << f->first << ": warm-up until " << t.GetWarmupEnd () << " s, "
+         << "throughput " << t.GetMean () << " +- " << t.GetHalfWidth () << " Kbps, "
+         << "delay " << d.GetMean () << " +- " << d.GetHalfWidth () << " s "
+         << "(" << t.GetN () << " windows)" << std::endl;
+    }
+}
+
+} // namespace ns3
+
+#endif /* STEADY_STATE_H */
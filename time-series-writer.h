@@ -0,0 +1,271 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TIME_SERIES_WRITER_H
+#define TIME_SERIES_WRITER_H
+
+/*
+ * Binary time-series file written while the simulation runs.
+ *
+ * Layout (host byte order, the reader checks the magic):
+ *
+ *     header : char magic[4] = "NSTS", uint16_t version, uint16_t recordSize
+ *     records: TimeSeriesRecord, recordSize bytes each, until EOF
+ *
+ * The records are buffered and written a whole chunk at a time, so memory
+ * stays flat and a crashed run keeps everything up to the last chunk.
+ * This file does not depend on ns-3 so that tools/ts-export.cc can use it.
+ */
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * \brief The metrics stored in a time-series file.
+ */
+enum TimeSeriesMetric
+{
+  TS_THROUGHPUT = 0,         //!< Kbps since the first tx packet
+  TS_DELAY,                  //!< delaySum, s
+  TS_LOST_PACKETS,           //!< lostPackets
+  TS_JITTER,                 //!< jitterSum, s
+  TS_WINDOW_THROUGHPUT,      //!< Kbps in the last window
+  TS_WINDOW_DELAY,           //!< mean delay per packet in the last window, s
+  TS_WINDOW_LOST_PACKETS,    //!< packets lost in the last window
+  TS_WINDOW_JITTER,          //!< mean jitter per packet in the last window, s
+  TS_WINDOW_DELAY_P50,       //!< median packet delay in the last window, s
+  TS_WINDOW_DELAY_P90,       //!< 90th percentile packet delay in the last window, s
+  TS_WINDOW_DELAY_P99,       //!< 99th percentile packet delay in the last window, s
+  TS_WINDOW_DELAY_P999,      //!< 99.9th percentile packet delay in the last window, s
+  TS_NET_GOODPUT,            //!< Kbps received by all flows in the last window (flow 0)
+  TS_NET_FAIRNESS,           //!< Jain's index of the active flows (flow 0)
+  TS_NET_DELAY,              //!< mean delay per packet of all flows in the last window, s (flow 0)
+  TS_NET_LOST_PACKETS,       //!< packets of all flows lost in the last window (flow 0)
+  TS_NET_ACTIVE_FLOWS,       //!< flows that sent packets in the last window (flow 0)
+  TS_CELL_GOODPUT,           //!< as TS_NET_GOODPUT for one cell, the "flow" is the cell index
+  TS_CELL_FAIRNESS,          //!< as TS_NET_FAIRNESS for one cell
+  TS_CELL_LOST_PACKETS,      //!< as TS_NET_LOST_PACKETS for one cell
+  TS_METRIC_COUNT
+};
+
+/// Name of a metric, as used by the export tool ("Throughput", "WindowDelay", ...).
+inline const char *
+TimeSeriesMetricName (uint32_t metric)
+{
+  static const char *names[TS_METRIC_COUNT] = {
+    "Throughput", "Delay", "LostPackets", "Jitter",
+    "WindowThroughput", "WindowDelay", "WindowLostPackets", "WindowJitter",
+    "WindowDelayP50", "WindowDelayP90", "WindowDelayP99", "WindowDelayP999",
+    "NetGoodput", "NetFairness", "NetDelay", "NetLostPackets", "NetActiveFlows",
+    "CellGoodput", "CellFairness", "CellLostPackets"
+  };
+  return metric < TS_METRIC_COUNT ? names[metric] : "Unknown";
+}
+
+/**
+ * \brief One sample of one metric of one flow.
+ */
+struct TimeSeriesRecord
+{
+  double time;        //!< simulation time, in seconds
+  uint32_t flowId;
+  uint32_t metric;    //!< a TimeSeriesMetric
+  double value;
+};
+
+static const char TIME_SERIES_MAGIC[4] = { 'N', 'S', 'T', 'S' };
+static const uint16_t TIME_SERIES_VERSION = 1;
+
+/**
+ * \brief Appends TimeSeriesRecords to a file in fixed-size chunks.
+ */
+class TimeSeriesWriter
+{
+public:
+  /// chunkRecords records are buffered before each write.
+  TimeSeriesWriter (std::string filename, uint32_t chunkRecords = 4096);
+  ~TimeSeriesWriter ();
+
+  bool IsOpen (void) const;
+  void Write (double time, uint32_t flowId, uint32_t metric, double value);
+  /// Write out the buffered records and flush the stdio buffer.
+  void Flush (void);
+  void Close (void);
+
+private:
+  TimeSeriesWriter (const TimeSeriesWriter &);
+  TimeSeriesWriter &operator= (const TimeSeriesWriter &);
+
+  FILE *m_file;
+  std::vector<TimeSeriesRecord> m_chunk;
+  uint32_t m_used;
+};
+
+
+inline
+TimeSeriesWriter::TimeSeriesWriter (std::string filename, uint32_t chunkRecords)
+  : m_chunk (chunkRecords > 0 ? chunkRecords : 1),
+    m_used (0)
+{
+  m_file = std::fopen (filename.c_str (), "wb");
+  if (m_file == 0)
+    {
+      return;
+    }
+  uint16_t version = TIME_SERIES_VERSION;
+  uint16_t recordSize = sizeof (TimeSeriesRecord);
+  std::fwrite (TIME_SERIES_MAGIC, 1, sizeof (TIME_SERIES_MAGIC), m_file);
+  std::fwrite (&version, sizeof (version), 1, m_file);
+  std::fwrite (&recordSize, sizeof (recordSize), 1, m_file);
+  std::fflush (m_file);
+}
+
+inline
+TimeSeriesWriter::~TimeSeriesWriter ()
+{
+  Close ();
+}
+
+inline bool
+TimeSeriesWriter::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline void
+TimeSeriesWriter::Write (double time, uint32_t flowId, uint32_t metric, double value)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  TimeSeriesRecord &r = m_chunk[m_used++];
+  r.time = time;
+  r.flowId = flowId;
+  r.metric = metric;
+  r.value = value;
+  if (m_used == m_chunk.size ())
+    {
+      Flush ();
+    }
+}
+
+inline void
+TimeSeriesWriter::Flush (void)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  if (m_used > 0)
+    {
+      std::fwrite (&m_chunk[0], sizeof (TimeSeriesRecord), m_used, m_file);
+      m_used = 0;
+    }
+  std::fflush (m_file);
+}
+
+inline void
+TimeSeriesWriter::Close (void)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  Flush ();
+  std::fclose (m_file);
+  m_file = 0;
+}
+
+/**
+ * \brief Reads back the records of a time-series file.
+ */
+class TimeSeriesReader
+{
+public:
+  TimeSeriesReader (std::string filename);
+  ~TimeSeriesReader ();
+
+  /// False if the file could not be opened or is not a time-series file.
+  bool IsOpen (void) const;
+  /// Read the next record; false at the end of the file.
+  bool Next (TimeSeriesRecord &record);
+
+private:
+  TimeSeriesReader (const TimeSeriesReader &);
+  TimeSeriesReader &operator= (const TimeSeriesReader &);
+
+  FILE *m_file;
+  uint16_t m_recordSize;
+};
+
+
+inline
+TimeSeriesReader::TimeSeriesReader (std::string filename)
+  : m_recordSize (0)
+{
+  m_file = std::fopen (filename.c_str (), "rb");
+  if (m_file == 0)
+    {
+      return;
+    }
+  char magic[4];
+  uint16_t version;
+  if (std::fread (magic, 1, sizeof (magic), m_file) != sizeof (magic)
+      || std::memcmp (magic, TIME_SERIES_MAGIC, sizeof (magic)) != 0
+      || std::fread (&version, sizeof (version), 1, m_file) != 1
+      || std::fread (&m_recordSize, sizeof (m_recordSize), 1, m_file) != 1
+      || m_recordSize < sizeof (TimeSeriesRecord))
+    {
+      std::fclose (m_file);
+      m_file = 0;
+    }
+}
+
+inline
+TimeSeriesReader::~TimeSeriesReader ()
+{
+  if (m_file != 0)
+    {
+      std::fclose (m_file);
+    }
+}
+
+inline bool
+TimeSeriesReader::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline bool
+TimeSeriesReader::Next (TimeSeriesRecord &record)
+{
+  if (m_file == 0 || std::fread (&record, sizeof (record), 1, m_file) != 1)
+    {
+      return false;
+    }
+  /* skip the fields a newer version may have appended */
+  if (m_recordSize > sizeof (record))
+    {
+      std::fseek (m_file, m_recordSize - sizeof (record), SEEK_CUR);
+    }
+  return true;
+}
+
+#endif /* TIME_SERIES_WRITER_H */
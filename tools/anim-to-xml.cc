@@ -0,0 +1,268 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Turn a binary animation trace (--AnimFormat=binary) into the XML NetAnim
+// loads, element for element what AnimationInterface would have written.
+//
+//   g++ -O2 -DHAVE_ZLIB -o anim-to-xml tools/anim-to-xml.cc -lz
+//
+//   anim-to-xml goal-topo.anim.gz [goal-topo.xml|- [step]]
+//       the XML on stdout, or into the file when given
+//
+// NetAnim does not move a node between two of its positions, so the nodes
+// written with linear compression (--AnimPositionTolerance) get a position
+// every step seconds (0.25 by default, as the mobility poll) along their
+// segments; a step of 0 writes only the segment ends.
+//
+// The trace is decompressed and converted as it is read, never as a whole.
+// A trace split by BinaryAnimation::SetRotation () is converted a file at a
+// time; each one starts with the whole setup, and name.index tells which
+// file covers which times.
+
+#include "../trace-reader.h"
+
+#include <inttypes.h>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+/// s with the characters XML does not allow in an attribute escaped.
+static std::string
+Escape (const std::string &s)
+{
+  std::string out;
+  out.reserve (s.size ());
+  for (std::string::size_type i = 0; i < s.size (); i++)
+    {
+      switch (s[i])
+        {
+        case '&': out += "&amp;"; break;
+        case '<': out += "&lt;"; break;
+        case '>': out += "&gt;"; break;
+        case '"': out += "&quot;"; break;
+        case '\'': out += "&apos;"; break;
+        default: out += s[i];
+        }
+    }
+  return out;
+}
+
+/// A time in seconds, as AnimationInterface prints it.
+static double
+Seconds (int64_t timeNs)
+{
+  return timeNs / 1e9;
+}
+
+static void
+Write (FILE *out, const AnimRecord &r)
+{
+  double t = Seconds (r.timeNs);
+  switch (r.type)
+    {
+    case ANIM_NODE:
+      std::fprintf (out, "<node id=\"%u\" sysId=\"%u\" locX=\"%.10g\" locY=\"%.10g\" />\n", r.id, r.to, r.x, r.y);
+      break;
+    case ANIM_LINK:
+      std::fprintf (out, "<link fromId=\"%u\" toId=\"%u\" fd=\"%s\" td=\"%s\" ld=\"%s\" />\n", r.id, r.to,
+                    Escape (r.text).c_str (), Escape (r.text2).c_str (), Escape (r.text3).c_str ());
+      break;
+    case ANIM_NONP2P_LINK:
+      std::fprintf (out, "<nonp2plinkproperties id=\"%u\" ipv4Address=\"%s\" channelType=\"%s\" />\n", r.id,
+                    Escape (r.text).c_str (), Escape (r.text2).c_str ());
+      break;
+    case ANIM_RESOURCE:
+      std::fprintf (out, "<res rid=\"%u\" p=\"%s\" />\n", r.id, Escape (r.text).c_str ());
+      break;
+    case ANIM_COUNTER:
+      std::fprintf (out, "<ncs ncId=\"%u\" n=\"%s\" t=\"%s\" />\n", r.id, Escape (r.text).c_str (),
+                    r.counterType == ANIM_COUNTER_UINT32 ? "UINT32" : "DOUBLE");
+      break;
+    case ANIM_POSITION:
+    case ANIM_MOTION:
+      std::fprintf (out, "<nu p=\"p\" t=\"%.10g\" id=\"%u\" x=\"%.10g\" y=\"%.10g\" />\n", t, r.id, r.x, r.y);
+      break;
+    case ANIM_COLOR:
+      std::fprintf (out, "<nu p=\"c\" t=\"%.10g\" id=\"%u\" r=\"%u\" g=\"%u\" b=\"%u\" />\n", t, r.id, r.r, r.g, r.b);
+      break;
+    case ANIM_SIZE:
+      std::fprintf (out, "<nu p=\"s\" t=\"%.10g\" id=\"%u\" w=\"%.10g\" h=\"%.10g\" />\n", t, r.id, r.x, r.y);
+      break;
+    case ANIM_DESCRIPTION:
+      std::fprintf (out, "<nu p=\"d\" t=\"%.10g\" id=\"%u\" descr=\"%s\" />\n", t, r.id, Escape (r.text).c_str ());
+      break;
+    case ANIM_IMAGE:
+      std::fprintf (out, "<nu p=\"i\" t=\"%.10g\" id=\"%u\" rid=\"%u\" />\n", t, r.id, r.to);
+      break;
+    case ANIM_COUNTER_VALUE:
+      std::fprintf (out, "<nc c=\"%u\" i=\"%u\" t=\"%.10g\" v=\"%.10g\" />\n", r.id, r.to, t, r.x);
+      break;
+    case ANIM_LINK_DESCRIPTION:
+      std::fprintf (out, "<linkupdate t=\"%.10g\" fromId=\"%u\" toId=\"%u\" ld=\"%s\" />\n", t, r.id, r.to,
+                    Escape (r.text).c_str ());
+      break;
+    case ANIM_PACKET:
+      std::fprintf (out, "<p fId=\"%u\" fbTx=\"%.10g\" lbTx=\"%.10g\" ", r.id, Seconds (r.fbTx), Seconds (r.lbTx));
+      if (!r.text.empty ())
+        {
+          std::fprintf (out, "meta-info=\"%s\" ", Escape (r.text).c_str ());
+        }
+      std::fprintf (out, "tId=\"%u\" fbRx=\"%.10g\" lbRx=\"%.10g\" />\n", r.to, Seconds (r.fbRx), Seconds (r.lbRx));
+      break;
+    case ANIM_WIFI_TX:
+      std::fprintf (out, "<pr uId=\"%" PRIu64 "\" fId=\"%u\" fbTx=\"%.10g\" ", r.uid, r.id, Seconds (r.fbTx));
+      if (!r.text.empty ())
+        {
+          std::fprintf (out, "meta-info=\"%s\" ", Escape (r.text).c_str ());
+        }
+      std::fprintf (out, "/>\n");
+      break;
+    case ANIM_WIFI_RX:
+      std::fprintf (out, "<wpr uId=\"%" PRIu64 "\" tId=\"%u\" fbRx=\"%.10g\" lbRx=\"0\" />\n", r.uid, r.to,
+                    Seconds (r.fbRx));
+      break;
+    }
+}
+
+/**
+ * The nodes moving along a segment, and the next position written for each.
+ */
+class Interpolator
+{
+public:
+  Interpolator (int64_t stepNs)
+    : m_step (stepNs)
+  {
+  }
+
+  /// A record about to be written: a new segment, or the end of one.
+  void Update (const AnimRecord &r)
+  {
+    if (m_step <= 0 || (r.type != ANIM_POSITION && r.type != ANIM_MOTION))
+      {
+        return;
+      }
+    if (r.id >= m_segments.size ())
+      {
+        m_segments.resize (r.id + 1);
+      }
+    Segment &s = m_segments[r.id];
+    s.timeNs = r.timeNs;
+    s.x = r.x;
+    s.y = r.y;
+    s.moving = r.type == ANIM_MOTION && (r.vx != 0 || r.vy != 0);
+    s.vx = r.vx;
+    s.vy = r.vy;
+    s.nextNs = r.timeNs + m_step;
+    s.generation++;
+    if (s.moving)
+      {
+        m_queue.push (Entry (s.nextNs, r.id, s.generation));
+      }
+  }
+
+  /// Write the positions along the segments before untilNs.
+  void Flush (FILE *out, int64_t untilNs)
+  {
+    while (!m_queue.empty () && m_queue.top ().timeNs < untilNs)
+      {
+        Entry next = m_queue.top ();
+        m_queue.pop ();
+        Segment &s = m_segments[next.node];
+        if (next.generation != s.generation)
+          {
+            continue;             // a later record ended or replaced the segment
+          }
+        double seconds = (s.nextNs - s.timeNs) / 1e9;
+        std::fprintf (out, "<nu p=\"p\" t=\"%.10g\" id=\"%u\" x=\"%.10g\" y=\"%.10g\" />\n",
+                      Seconds (s.nextNs), next.node, s.x + s.vx * seconds, s.y + s.vy * seconds);
+        s.nextNs += m_step;
+        m_queue.push (Entry (s.nextNs, next.node, s.generation));
+      }
+  }
+
+private:
+  struct Segment
+  {
+    Segment () : timeNs (0), nextNs (0), x (0), y (0), vx (0), vy (0), moving (false), generation (0) {}
+    int64_t timeNs;
+    int64_t nextNs;
+    double x, y;
+    double vx, vy;
+    bool moving;
+    uint64_t generation;        //!< of the record that started the segment
+  };
+
+  struct Entry
+  {
+    Entry (int64_t t, uint32_t n, uint64_t g) : timeNs (t), node (n), generation (g) {}
+    bool operator> (const Entry &o) const { return timeNs > o.timeNs || (timeNs == o.timeNs && node > o.node); }
+    int64_t timeNs;
+    uint32_t node;
+    uint64_t generation;
+  };
+
+  int64_t m_step;
+  std::vector<Segment> m_segments;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > m_queue;
+};
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::fprintf (stderr, "usage: %s <animation trace> [out.xml|- [step]]\n", argv[0]);
+      return 2;
+    }
+  AnimStreamReader reader;
+  if (!reader.Open (argv[1]))
+    {
+      std::fprintf (stderr, "%s: not an animation trace\n", argv[1]);
+      return 1;
+    }
+  FILE *out = stdout;
+  if (argc > 2 && std::string (argv[2]) != "-")
+    {
+      out = std::fopen (argv[2], "w");
+      if (out == 0)
+        {
+          std::fprintf (stderr, "%s: cannot open\n", argv[2]);
+          return 1;
+        }
+    }
+  std::fprintf (out, "<anim ver=\"netanim-3.106\" filetype=\"animation\" >\n");
+  Interpolator interpolator (argc > 3 ? std::atof (argv[3]) * 1e9 : 250000000);
+  AnimRecord r;
+  while (reader.Next (r))
+    {
+      if (r.type >= ANIM_POSITION)
+        {
+          interpolator.Flush (out, r.timeNs);
+        }
+      interpolator.Update (r);
+      Write (out, r);
+    }
+  std::fprintf (out, "</anim>\n");
+  if (out != stdout)
+    {
+      std::fclose (out);
+    }
+  return 0;
+}
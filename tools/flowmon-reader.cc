@@ -0,0 +1,331 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Read the binary FlowMonitor export written by FlowMonitorExporter.
+//
+//   g++ -O2 -DHAVE_ZLIB -o flowmon-reader tools/flowmon-reader.cc -lz
+//
+//   flowmon-reader goal-topo.nsfm.gz [summary]
+//       one line per flow: five-tuple, packets, throughput, mean delay/jitter, losses
+//
+//   flowmon-reader goal-topo.nsfm.gz csv [out.csv]
+//       the final stats of every flow, one line per flow
+//
+//   flowmon-reader goal-topo.nsfm.gz checkpoints [out.csv]
+//       every flow record of every checkpoint, to follow the flows over time
+//
+//   flowmon-reader goal-topo.nsfm.gz xml [out.xml]
+//       the same document FlowMonitor::SerializeToXmlFile () writes, for the
+//       scripts that parse it (e.g. flowmon-parse-results.py)
+//
+// Only the last record of each flow is kept, so memory grows with the
+// number of flows, not with the number of checkpoints.
+
+#include "../flowmon-stream.h"
+
+#include <inttypes.h>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+
+typedef std::map<uint32_t, FlowmonFlowRecord> FlowMap;
+typedef std::map<std::pair<uint32_t, uint32_t>, FlowmonProbeRecord> ProbeMap;
+
+static std::string
+AddressToString (uint32_t a)
+{
+  char buf[16];
+  std::snprintf (buf, sizeof (buf), "%u.%u.%u.%u", (a >> 24) & 0xff, (a >> 16) & 0xff, (a >> 8) & 0xff, a & 0xff);
+  return buf;
+}
+
+static FILE *
+OpenOutput (const char *out)
+{
+  FILE *f = out ? std::fopen (out, "w") : stdout;
+  if (f == 0)
+    {
+      std::fprintf (stderr, "cannot open %s\n", out);
+    }
+  return f;
+}
+
+static void
+CloseOutput (FILE *f)
+{
+  if (f != stdout)
+    {
+      std::fclose (f);
+    }
+}
+
+/// Keep the last record of every flow and probe; false if the file was cut short.
+static bool
+Load (FlowmonStreamReader &reader, FlowMap &flows, ProbeMap &probes, double &time)
+{
+  FlowmonRecordType type;
+  bool final = false;
+  while (reader.Next (type))
+    {
+      switch (type)
+        {
+        case FLOWMON_CHECKPOINT:
+          time = reader.GetTime ();
+          final = reader.IsFinal ();
+          break;
+        case FLOWMON_FLOW:
+          flows[reader.GetFlow ().flowId] = reader.GetFlow ();
+          break;
+        case FLOWMON_PROBE:
+          probes[std::make_pair (reader.GetProbe ().probe, reader.GetProbe ().flowId)] = reader.GetProbe ();
+          break;
+        default:
+          break;
+        }
+    }
+  return final;
+}
+
+static void
+PrintCsvHeader (FILE *f, bool withTime)
+{
+  std::fprintf (f, "%sflow,src,dst,proto,sport,dport,txPackets,rxPackets,txBytes,rxBytes,lostPackets,"
+                "timesForwarded,timeFirstTxPacket,timeLastRxPacket,delaySum,jitterSum,throughputKbps\n",
+                withTime ? "time," : "");
+}
+
+static void
+PrintCsvLine (FILE *f, const FlowmonFlowRecord &r)
+{
+  double duration = (r.timeLastRxPacket - r.timeFirstTxPacket) / 1e9;
+  std::fprintf (f, "%u,%s,%s,%u,%u,%u,%u,%u,%" PRIu64 ",%" PRIu64 ",%u,%u,%.9f,%.9f,%.9f,%.9f,%.3f\n",
+                r.flowId, AddressToString (r.sourceAddress).c_str (), AddressToString (r.destinationAddress).c_str (),
+                r.protocol, r.sourcePort, r.destinationPort, r.txPackets, r.rxPackets, r.txBytes, r.rxBytes,
+                r.lostPackets, r.timesForwarded, r.timeFirstTxPacket / 1e9, r.timeLastRxPacket / 1e9,
+                r.delaySum / 1e9, r.jitterSum / 1e9, duration > 0 ? r.rxBytes * 8.0 / duration / 1024 : 0.0);
+}
+
+static int
+Summary (FlowmonStreamReader &reader)
+{
+  FlowMap flows;
+  ProbeMap probes;
+  double time = 0;
+  bool complete = Load (reader, flows, probes, time);
+  std::printf ("%s at %.3f s, %u flows\n", complete ? "final stats" : "last checkpoint (run did not finish)",
+               time, (uint32_t) flows.size ());
+  for (FlowMap::const_iterator i = flows.begin (); i != flows.end (); ++i)
+    {
+      const FlowmonFlowRecord &r = i->second;
+      double duration = (r.timeLastRxPacket - r.timeFirstTxPacket) / 1e9;
+      std::printf ("Flow %u (%s:%u -> %s:%u, proto %u)\n", r.flowId,
+                   AddressToString (r.sourceAddress).c_str (), r.sourcePort,
+                   AddressToString (r.destinationAddress).c_str (), r.destinationPort, r.protocol);
+      std::printf ("  Tx Packets = %u, Rx Packets = %u, Lost Packets = %u\n", r.txPackets, r.rxPackets, r.lostPackets);
+      std::printf ("  Throughput: %.3f Kbps\n", duration > 0 ? r.rxBytes * 8.0 / duration / 1024 : 0.0);
+      if (r.rxPackets > 0)
+        {
+          std::printf ("  Mean delay: %.6f s, mean jitter: %.6f s\n",
+                       r.delaySum / 1e9 / r.rxPackets, r.rxPackets > 1 ? r.jitterSum / 1e9 / (r.rxPackets - 1) : 0.0);
+        }
+    }
+  return 0;
+}
+
+static int
+ExportCsv (FlowmonStreamReader &reader, const char *out)
+{
+  FlowMap flows;
+  ProbeMap probes;
+  double time = 0;
+  Load (reader, flows, probes, time);
+  FILE *f = OpenOutput (out);
+  if (f == 0)
+    {
+      return 1;
+    }
+  PrintCsvHeader (f, false);
+  for (FlowMap::const_iterator i = flows.begin (); i != flows.end (); ++i)
+    {
+      PrintCsvLine (f, i->second);
+    }
+  CloseOutput (f);
+  return 0;
+}
+
+static int
+ExportCheckpoints (FlowmonStreamReader &reader, const char *out)
+{
+  FILE *f = OpenOutput (out);
+  if (f == 0)
+    {
+      return 1;
+    }
+  PrintCsvHeader (f, true);
+  FlowmonRecordType type;
+  double time = 0;
+  while (reader.Next (type))
+    {
+      if (type == FLOWMON_CHECKPOINT)
+        {
+          time = reader.GetTime ();
+        }
+      else if (type == FLOWMON_FLOW)
+        {
+          std::fprintf (f, "%.9g,", time);
+          PrintCsvLine (f, reader.GetFlow ());
+        }
+    }
+  CloseOutput (f);
+  return 0;
+}
+
+static void
+PrintXmlHistogram (FILE *f, const char *name, const FlowmonHistogram &h)
+{
+  std::fprintf (f, "      <%s nBins=\"%u\" >\n", name, h.nBins);
+  for (std::vector<std::pair<uint32_t, uint32_t> >::const_iterator b = h.bins.begin (); b != h.bins.end (); ++b)
+    {
+      std::fprintf (f, "        <bin index=\"%u\" start=\"%g\" width=\"%g\" count=\"%u\" />\n",
+                    b->first, b->first * h.width, h.width, b->second);
+    }
+  std::fprintf (f, "      </%s>\n", name);
+}
+
+static void
+PrintXmlDrops (FILE *f, const char *indent, const std::vector<uint32_t> &packets, const std::vector<uint64_t> &bytes)
+{
+  for (uint32_t reason = 0; reason < packets.size (); reason++)
+    {
+      std::fprintf (f, "%s<packetsDropped reasonCode=\"%u\" number=\"%u\" />\n", indent, reason, packets[reason]);
+    }
+  for (uint32_t reason = 0; reason < bytes.size (); reason++)
+    {
+      std::fprintf (f, "%s<bytesDropped reasonCode=\"%u\" bytes=\"%" PRIu64 "\" />\n", indent, reason, bytes[reason]);
+    }
+}
+
+static int
+ExportXml (FlowmonStreamReader &reader, const char *out)
+{
+  FlowMap flows;
+  ProbeMap probes;
+  double time = 0;
+  Load (reader, flows, probes, time);
+  FILE *f = OpenOutput (out);
+  if (f == 0)
+    {
+      return 1;
+    }
+  bool histograms = reader.GetFlags () & FLOWMON_HISTOGRAMS;
+
+  std::fprintf (f, "<?xml version=\"1.0\" ?>\n<FlowMonitor>\n  <FlowStats>\n");
+  for (FlowMap::const_iterator i = flows.begin (); i != flows.end (); ++i)
+    {
+      const FlowmonFlowRecord &r = i->second;
+      std::fprintf (f, "    <Flow flowId=\"%u\" timeFirstTxPacket=\"%+" PRId64 ".0ns\" timeFirstRxPacket=\"%+" PRId64 ".0ns\""
+                    " timeLastTxPacket=\"%+" PRId64 ".0ns\" timeLastRxPacket=\"%+" PRId64 ".0ns\""
+                    " delaySum=\"%+" PRId64 ".0ns\" jitterSum=\"%+" PRId64 ".0ns\" lastDelay=\"%+" PRId64 ".0ns\""
+                    " txBytes=\"%" PRIu64 "\" rxBytes=\"%" PRIu64 "\" txPackets=\"%u\" rxPackets=\"%u\""
+                    " lostPackets=\"%u\" timesForwarded=\"%u\">\n",
+                    r.flowId, r.timeFirstTxPacket, r.timeFirstRxPacket, r.timeLastTxPacket, r.timeLastRxPacket,
+                    r.delaySum, r.jitterSum, r.lastDelay, r.txBytes, r.rxBytes, r.txPackets, r.rxPackets,
+                    r.lostPackets, r.timesForwarded);
+      PrintXmlDrops (f, "      ", r.packetsDropped, r.bytesDropped);
+      if (histograms)
+        {
+          PrintXmlHistogram (f, "delayHistogram", r.delayHistogram);
+          PrintXmlHistogram (f, "jitterHistogram", r.jitterHistogram);
+          PrintXmlHistogram (f, "packetSizeHistogram", r.packetSizeHistogram);
+          PrintXmlHistogram (f, "flowInterruptionsHistogram", r.flowInterruptionsHistogram);
+        }
+      std::fprintf (f, "    </Flow>\n");
+    }
+  std::fprintf (f, "  </FlowStats>\n  <Ipv4FlowClassifier>\n");
+  for (FlowMap::const_iterator i = flows.begin (); i != flows.end (); ++i)
+    {
+      const FlowmonFlowRecord &r = i->second;
+      std::fprintf (f, "    <Flow flowId=\"%u\" sourceAddress=\"%s\" destinationAddress=\"%s\" protocol=\"%u\""
+                    " sourcePort=\"%u\" destinationPort=\"%u\" />\n",
+                    r.flowId, AddressToString (r.sourceAddress).c_str (), AddressToString (r.destinationAddress).c_str (),
+                    r.protocol, r.sourcePort, r.destinationPort);
+    }
+  std::fprintf (f, "  </Ipv4FlowClassifier>\n  <Ipv6FlowClassifier>\n  </Ipv6FlowClassifier>\n");
+
+  if (reader.GetFlags () & FLOWMON_PROBES)
+    {
+      std::fprintf (f, "  <FlowProbes>\n");
+      /* only the probes that saw a flow are in the binary file */
+      for (ProbeMap::const_iterator i = probes.begin (); i != probes.end (); )
+        {
+          uint32_t probe = i->first.first;
+          std::fprintf (f, "    <FlowProbe index=\"%u\">\n", probe);
+          for (; i != probes.end () && i->first.first == probe; ++i)
+            {
+              const FlowmonProbeRecord &p = i->second;
+              std::fprintf (f, "      <FlowStats  flowId=\"%u\" packets=\"%u\" bytes=\"%" PRIu64 "\""
+                            " delayFromFirstProbeSum=\"%+" PRId64 ".0ns\" >\n",
+                            p.flowId, p.packets, p.bytes, p.delayFromFirstProbeSum);
+              PrintXmlDrops (f, "        ", p.packetsDropped, p.bytesDropped);
+              std::fprintf (f, "      </FlowStats>\n");
+            }
+          std::fprintf (f, "    </FlowProbe>\n");
+        }
+      std::fprintf (f, "  </FlowProbes>\n");
+    }
+  std::fprintf (f, "</FlowMonitor>\n");
+  CloseOutput (f);
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::fprintf (stderr, "usage: %s <file> [summary]\n"
+                    "       %s <file> csv|checkpoints|xml [out]\n", argv[0], argv[0]);
+      return 1;
+    }
+  FlowmonStreamReader reader (argv[1]);
+  if (!reader.IsOpen ())
+    {
+      std::fprintf (stderr, "%s is not a FlowMonitor export\n", argv[1]);
+      return 1;
+    }
+  const char *mode = argc > 2 ? argv[2] : "summary";
+  const char *out = argc > 3 ? argv[3] : 0;
+  if (std::strcmp (mode, "summary") == 0)
+    {
+      return Summary (reader);
+    }
+  if (std::strcmp (mode, "csv") == 0)
+    {
+      return ExportCsv (reader, out);
+    }
+  if (std::strcmp (mode, "checkpoints") == 0)
+    {
+      return ExportCheckpoints (reader, out);
+    }
+  if (std::strcmp (mode, "xml") == 0)
+    {
+      return ExportXml (reader, out);
+    }
+  std::fprintf (stderr, "unknown mode %s\n", mode);
+  return 1;
+}
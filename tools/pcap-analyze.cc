@@ -0,0 +1,608 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Per-link and per-flow throughput, delay and loss from the pcap files of
+// a trace directory, offline.
+//
+//   g++ -O2 -std=c++11 -pthread -DHAVE_ZLIB -o pcap-analyze tools/pcap-analyze.cc -lz
+//
+//   pcap-analyze trace/udp-server-client-applicaiton [interval [prefix [lifetime]]]
+//       every link (pcap file) and every flow, summed up on stdout; with a
+//       prefix, also <prefix>links.csv and <prefix>flows.csv, one line per
+//       link or flow and interval (1 s by default)
+//
+// Every .pcap file is memory-mapped and parsed by a worker of its own, as
+// many at once as there are cores (.pcap.gz files are streamed through
+// PcapReader instead).  The packets are then matched across the files by
+// a second set of workers, one per share of the flows.
+//
+// A packet is the same on every hop when its five-tuple and IPv4
+// identification are, and it is seen within lifetime seconds (1 s by
+// default; less than the time the identification takes to wrap around).  Its delay is from the
+// first to the last time it is seen; a flow is delivered on the link where
+// most of its packets are last seen, and the packets never seen there are
+// lost.  The throughput counts the IP bytes, over the time from the first
+// packet sent to the last one delivered, as FlowMonitor does; the link
+// throughput counts the frames on the wire.
+
+#include "../pcap-writer.h"
+#include "../trace-reader.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// One IPv4 packet seen on one link.
+struct Sighting
+{
+  int64_t timeNs;
+  uint32_t source;
+  uint32_t destination;
+  uint16_t sourcePort;
+  uint16_t destinationPort;
+  uint16_t identification;
+  uint16_t totalLength;
+  uint16_t link;
+  uint8_t protocol;
+};
+
+/// Frames and bytes of one interval.
+struct Bin
+{
+  uint64_t frames;
+  uint64_t bytes;
+};
+
+struct Link
+{
+  std::string path;
+  std::string name;             //!< file name without .pcap[.gz]
+  uint32_t linkType;
+  uint64_t frames;
+  uint64_t bytes;
+  int64_t first;
+  int64_t last;
+  std::vector<Bin> bins;
+  std::vector<Sighting> sightings;
+  std::string error;            //!< empty when the file was read
+};
+
+struct FlowKey
+{
+  uint32_t source;
+  uint32_t destination;
+  uint8_t protocol;
+  uint16_t sourcePort;
+  uint16_t destinationPort;
+
+  bool operator< (const FlowKey &o) const
+  {
+    if (source != o.source) return source < o.source;
+    if (destination != o.destination) return destination < o.destination;
+    if (protocol != o.protocol) return protocol < o.protocol;
+    if (sourcePort != o.sourcePort) return sourcePort < o.sourcePort;
+    return destinationPort < o.destinationPort;
+  }
+};
+
+/// One flow interval.
+struct FlowBin
+{
+  uint32_t txPackets;
+  uint32_t rxPackets;
+  uint32_t lostPackets;
+  uint64_t rxBytes;
+  int64_t delaySum;
+};
+
+struct Flow
+{
+  FlowKey key;
+  uint32_t txPackets;
+  uint32_t rxPackets;
+  uint64_t rxBytes;
+  int64_t delaySum;
+  int64_t firstTx;
+  int64_t lastRx;
+  uint16_t egress;              //!< the link where it is delivered
+  std::vector<FlowBin> bins;
+};
+
+static std::string
+AddressToString (uint32_t a)
+{
+  char buf[16];
+  std::snprintf (buf, sizeof (buf), "%u.%u.%u.%u", (a >> 24) & 0xff, (a >> 16) & 0xff, (a >> 8) & 0xff, a & 0xff);
+  return buf;
+}
+
+template <typename T>
+static T &
+BinAt (std::vector<T> &bins, int64_t timeNs, int64_t intervalNs)
+{
+  uint64_t i = timeNs / intervalNs;
+  if (bins.size () <= i)
+    {
+      bins.resize (i + 1, T ());
+    }
+  return bins[i];
+}
+
+static void
+AddRecord (Link &link, uint16_t index, int64_t intervalNs, int64_t timeNs,
+           const uint8_t *data, uint32_t captured, uint32_t original)
+{
+  uint32_t frameType = link.linkType;
+  if (frameType == PCAP_LINK_IEEE802_11_RADIO)
+    {
+      /* skip the radiotap header, its length is little endian */
+      uint32_t length = captured >= 4 ? data[2] | (data[3] << 8) : captured;
+      length = length < captured ? length : captured;
+      data += length;
+      captured -= length;
+      original = original > length ? original - length : 0;
+      frameType = PCAP_LINK_IEEE802_11;
+    }
+  if (link.frames == 0)
+    {
+      link.first = timeNs;
+    }
+  link.last = timeNs;
+  link.frames++;
+  link.bytes += original;
+  Bin &bin = BinAt (link.bins, timeNs, intervalNs);
+  bin.frames++;
+  bin.bytes += original;
+
+  PcapFrameInfo info;
+  if (!PcapParseFrame (frameType, data, captured, original, info))
+    {
+      return;
+    }
+  Sighting s;
+  s.timeNs = timeNs;
+  s.source = info.sourceAddress;
+  s.destination = info.destinationAddress;
+  s.sourcePort = info.sourcePort;
+  s.destinationPort = info.destinationPort;
+  s.identification = info.identification;
+  s.totalLength = info.totalLength;
+  s.link = index;
+  s.protocol = info.protocol;
+  link.sightings.push_back (s);
+}
+
+static uint32_t
+Swap32 (uint32_t value, bool swapped)
+{
+  return swapped ? __builtin_bswap32 (value) : value;
+}
+
+/// Parse a plain pcap file through mmap ().
+static void
+ReadMapped (Link &link, uint16_t index, int64_t intervalNs)
+{
+  int fd = open (link.path.c_str (), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat (fd, &st) != 0)
+    {
+      link.error = "cannot open";
+      if (fd >= 0)
+        {
+          close (fd);
+        }
+      return;
+    }
+  size_t size = st.st_size;
+  if (size < 24)
+    {
+      link.error = "not a pcap file";
+      close (fd);
+      return;
+    }
+  const uint8_t *map = static_cast<const uint8_t *> (mmap (0, size, PROT_READ, MAP_PRIVATE, fd, 0));
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      link.error = "cannot map";
+      return;
+    }
+  madvise (const_cast<uint8_t *> (map), size, MADV_SEQUENTIAL);
+
+  uint32_t header[6];
+  std::memcpy (header, map, sizeof (header));
+  bool swapped = header[0] == 0xd4c3b2a1 || header[0] == 0x4d3cb2a1;
+  bool nanoseconds = header[0] == 0xa1b23c4d || header[0] == 0x4d3cb2a1;
+  if (header[0] != 0xa1b2c3d4 && !swapped && !nanoseconds)
+    {
+      link.error = "not a pcap file";
+      munmap (const_cast<uint8_t *> (map), size);
+      return;
+    }
+  link.linkType = Swap32 (header[5], swapped);
+  for (size_t offset = 24; offset + 16 <= size; )
+    {
+      uint32_t record[4];
+      std::memcpy (record, map + offset, sizeof (record));
+      uint64_t seconds = Swap32 (record[0], swapped);
+      uint64_t fraction = Swap32 (record[1], swapped);
+      uint32_t captured = Swap32 (record[2], swapped);
+      uint32_t original = Swap32 (record[3], swapped);
+      offset += 16;
+      if (offset + captured > size)
+        {
+          break;                        // truncated, the run did not finish
+        }
+      int64_t timeNs = seconds * 1000000000 + (nanoseconds ? fraction : fraction * 1000);
+      AddRecord (link, index, intervalNs, timeNs, map + offset, captured, original);
+      offset += captured;
+    }
+  munmap (const_cast<uint8_t *> (map), size);
+}
+
+/// Parse a compressed pcap file as a stream.
+static void
+ReadStream (Link &link, uint16_t index, int64_t intervalNs)
+{
+  PcapReader reader;
+  if (!reader.Open (link.path))
+    {
+      link.error = "not a pcap file";
+      return;
+    }
+  link.linkType = reader.GetLinkType ();
+  PcapRecord r;
+  while (reader.Next (r))
+    {
+      AddRecord (link, index, intervalNs, r.timeNs, r.data.data (), r.capturedLength, r.originalLength);
+    }
+}
+
+static uint64_t
+FlowHash (const Sighting &s)
+{
+  uint64_t x = (uint64_t (s.source) << 32) ^ s.destination ^ (uint64_t (s.protocol) << 16)
+    ^ (uint64_t (s.sourcePort) << 40) ^ (uint64_t (s.destinationPort) << 24);
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  return x ^ (x >> 33);
+}
+
+/// One packet, as matched across the links so far.
+struct Packet
+{
+  int64_t first;
+  int64_t last;
+  uint16_t lastLink;
+  uint16_t totalLength;
+};
+
+static bool
+FirstSeen (const Packet &a, const Packet &b)
+{
+  return a.first < b.first;
+}
+
+/// Match the packets of the flows of one share, shard out of shards.
+static void
+MatchFlows (const std::vector<Link> &links, uint32_t shard, uint32_t shards, int64_t intervalNs,
+            int64_t lifetimeNs, std::vector<Flow> &flows)
+{
+  typedef std::unordered_map<uint16_t, std::vector<Packet> > Packets;
+  std::map<FlowKey, Packets> matched;
+  for (uint32_t l = 0; l < links.size (); l++)
+    {
+      const std::vector<Sighting> &sightings = links[l].sightings;
+      for (uint32_t k = 0; k < sightings.size (); k++)
+        {
+          const Sighting &s = sightings[k];
+          if (FlowHash (s) % shards != shard)
+            {
+              continue;
+            }
+          FlowKey key = { s.source, s.destination, s.protocol, s.sourcePort, s.destinationPort };
+          /* the identification wraps around: the packet seen closest in
+           * time, the instances being sorted by first sighting */
+          std::vector<Packet> &same = matched[key][s.identification];
+          Packet n = { s.timeNs, s.timeNs, s.link, s.totalLength };
+          std::vector<Packet>::iterator next = std::lower_bound (same.begin (), same.end (), n, FirstSeen);
+          Packet *p = 0;
+          if (next != same.end () && next->first - s.timeNs < lifetimeNs)
+            {
+              p = &*next;
+            }
+          if (next != same.begin () && s.timeNs - (next - 1)->first < lifetimeNs
+              && (p == 0 || s.timeNs - (next - 1)->first < p->first - s.timeNs))
+            {
+              p = &*(next - 1);
+            }
+          if (p == 0)
+            {
+              same.insert (next, n);
+              continue;
+            }
+          p->first = std::min (p->first, s.timeNs);
+          if (s.timeNs >= p->last)
+            {
+              p->last = s.timeNs;
+              p->lastLink = s.link;
+            }
+        }
+    }
+
+  for (std::map<FlowKey, Packets>::const_iterator i = matched.begin (); i != matched.end (); ++i)
+    {
+      /* the egress: where most packets are last seen */
+      std::map<uint16_t, uint32_t> lastLinks;
+      for (Packets::const_iterator j = i->second.begin (); j != i->second.end (); ++j)
+        {
+          for (uint32_t k = 0; k < j->second.size (); k++)
+            {
+              lastLinks[j->second[k].lastLink]++;
+            }
+        }
+      Flow f;
+      f.key = i->first;
+      f.txPackets = 0;
+      f.rxPackets = 0;
+      f.rxBytes = 0;
+      f.delaySum = 0;
+      f.firstTx = INT64_MAX;
+      f.lastRx = 0;
+      f.egress = 0;
+      uint32_t most = 0;
+      for (std::map<uint16_t, uint32_t>::const_iterator l = lastLinks.begin (); l != lastLinks.end (); ++l)
+        {
+          if (l->second > most)
+            {
+              most = l->second;
+              f.egress = l->first;
+            }
+        }
+      for (Packets::const_iterator j = i->second.begin (); j != i->second.end (); ++j)
+        {
+          for (uint32_t k = 0; k < j->second.size (); k++)
+            {
+              const Packet &p = j->second[k];
+              f.txPackets++;
+              f.firstTx = std::min (f.firstTx, p.first);
+              BinAt (f.bins, p.first, intervalNs).txPackets++;
+              if (p.lastLink != f.egress)
+                {
+                  BinAt (f.bins, p.first, intervalNs).lostPackets++;
+                  continue;
+                }
+              f.rxPackets++;
+              f.rxBytes += p.totalLength;
+              f.delaySum += p.last - p.first;
+              f.lastRx = std::max (f.lastRx, p.last);
+              FlowBin &bin = BinAt (f.bins, p.last, intervalNs);
+              bin.rxPackets++;
+              bin.rxBytes += p.totalLength;
+              bin.delaySum += p.last - p.first;
+            }
+        }
+      flows.push_back (f);
+    }
+}
+
+static bool
+FirstSent (const Flow &a, const Flow &b)
+{
+  return a.firstTx < b.firstTx;
+}
+
+static bool
+HasSuffix (const std::string &s, const char *suffix)
+{
+  size_t n = std::strlen (suffix);
+  return s.size () > n && s.compare (s.size () - n, n, suffix) == 0;
+}
+
+/// Run work (i) for i in [0, n) on up to threads threads.
+template <typename F>
+static void
+Parallel (uint32_t n, uint32_t threads, F work)
+{
+  std::atomic<uint32_t> next (0);
+  std::vector<std::thread> pool;
+  for (uint32_t t = 0; t < std::min (n, threads); t++)
+    {
+      pool.push_back (std::thread ([&] ()
+        {
+          for (uint32_t i = next++; i < n; i = next++)
+            {
+              work (i);
+            }
+        }));
+    }
+  for (uint32_t t = 0; t < pool.size (); t++)
+    {
+      pool[t].join ();
+    }
+}
+
+static int
+WriteCsv (const std::string &prefix, const std::vector<Link> &links, const std::vector<Flow> &flows,
+          int64_t intervalNs)
+{
+  double interval = intervalNs / 1e9;
+  std::string name = prefix + "links.csv";
+  FILE *f = std::fopen (name.c_str (), "w");
+  if (f == 0)
+    {
+      std::fprintf (stderr, "cannot open %s\n", name.c_str ());
+      return 1;
+    }
+  std::fprintf (f, "time,link,frames,bytes,throughputKbps\n");
+  for (uint32_t l = 0; l < links.size (); l++)
+    {
+      for (uint32_t b = 0; b < links[l].bins.size (); b++)
+        {
+          const Bin &bin = links[l].bins[b];
+          std::fprintf (f, "%.9g,%s,%" PRIu64 ",%" PRIu64 ",%.3f\n", b * interval, links[l].name.c_str (),
+                        bin.frames, bin.bytes, bin.bytes * 8.0 / interval / 1024);
+        }
+    }
+  std::fclose (f);
+
+  name = prefix + "flows.csv";
+  f = std::fopen (name.c_str (), "w");
+  if (f == 0)
+    {
+      std::fprintf (stderr, "cannot open %s\n", name.c_str ());
+      return 1;
+    }
+  std::fprintf (f, "time,flow,txPackets,rxPackets,lostPackets,throughputKbps,meanDelay\n");
+  for (uint32_t i = 0; i < flows.size (); i++)
+    {
+      for (uint32_t b = 0; b < flows[i].bins.size (); b++)
+        {
+          const FlowBin &bin = flows[i].bins[b];
+          std::fprintf (f, "%.9g,%u,%u,%u,%u,%.3f,%.9f\n", b * interval, i + 1, bin.txPackets, bin.rxPackets,
+                        bin.lostPackets, bin.rxBytes * 8.0 / interval / 1024,
+                        bin.rxPackets > 0 ? bin.delaySum / 1e9 / bin.rxPackets : 0.0);
+        }
+    }
+  std::fclose (f);
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::fprintf (stderr, "usage: %s <trace directory> [interval [prefix [lifetime]]]\n", argv[0]);
+      return 2;
+    }
+  std::string directory = argv[1];
+  int64_t intervalNs = (argc > 2 ? std::atof (argv[2]) : 1.0) * 1e9;
+  int64_t lifetimeNs = (argc > 4 ? std::atof (argv[4]) : 1.0) * 1e9;
+  if (intervalNs <= 0 || lifetimeNs <= 0)
+    {
+      std::fprintf (stderr, "bad interval or lifetime\n");
+      return 2;
+    }
+
+  std::vector<std::string> names;
+  DIR *dir = opendir (directory.c_str ());
+  if (dir == 0)
+    {
+      std::fprintf (stderr, "cannot open %s\n", directory.c_str ());
+      return 1;
+    }
+  for (struct dirent *e = readdir (dir); e != 0; e = readdir (dir))
+    {
+      std::string name = e->d_name;
+      if (HasSuffix (name, ".pcap") || HasSuffix (name, ".pcap.gz"))
+        {
+          names.push_back (name);
+        }
+    }
+  closedir (dir);
+  std::sort (names.begin (), names.end ());
+  if (names.size () > 0xffff)
+    {
+      names.resize (0xffff);
+    }
+
+  std::vector<Link> links (names.size ());
+  for (uint32_t l = 0; l < names.size (); l++)
+    {
+      links[l].path = directory + "/" + names[l];
+      links[l].name = names[l].substr (0, names[l].rfind (".pcap"));
+      links[l].linkType = 0;
+      links[l].frames = 0;
+      links[l].bytes = 0;
+      links[l].first = 0;
+      links[l].last = 0;
+    }
+  uint32_t threads = std::max (1u, std::thread::hardware_concurrency ());
+  Parallel (links.size (), threads, [&] (uint32_t l)
+    {
+      if (HasSuffix (links[l].path, ".gz"))
+        {
+          ReadStream (links[l], l, intervalNs);
+        }
+      else
+        {
+          ReadMapped (links[l], l, intervalNs);
+        }
+    });
+
+  std::vector<std::vector<Flow> > shares (threads);
+  Parallel (threads, threads, [&] (uint32_t shard)
+    {
+      MatchFlows (links, shard, threads, intervalNs, lifetimeNs, shares[shard]);
+    });
+  std::vector<Flow> flows;
+  for (uint32_t t = 0; t < threads; t++)
+    {
+      flows.insert (flows.end (), shares[t].begin (), shares[t].end ());
+    }
+  std::sort (flows.begin (), flows.end (), FirstSent);
+
+  std::printf ("%u links, %u flows\n", (uint32_t) links.size (), (uint32_t) flows.size ());
+  for (uint32_t l = 0; l < links.size (); l++)
+    {
+      const Link &k = links[l];
+      if (!k.error.empty ())
+        {
+          std::printf ("Link %s: %s\n", k.name.c_str (), k.error.c_str ());
+          continue;
+        }
+      double duration = (k.last - k.first) / 1e9;
+      std::printf ("Link %s (link type %u)\n", k.name.c_str (), k.linkType);
+      std::printf ("  Frames = %" PRIu64 ", Bytes = %" PRIu64 ", from %.6f s to %.6f s\n",
+                   k.frames, k.bytes, k.first / 1e9, k.last / 1e9);
+      std::printf ("  Throughput: %.3f Kbps\n", duration > 0 ? k.bytes * 8.0 / duration / 1024 : 0.0);
+    }
+  for (uint32_t i = 0; i < flows.size (); i++)
+    {
+      const Flow &f = flows[i];
+      double duration = (f.lastRx - f.firstTx) / 1e9;
+      std::printf ("Flow %u (%s:%u -> %s:%u, proto %u), delivered on %s\n", i + 1,
+                   AddressToString (f.key.source).c_str (), f.key.sourcePort,
+                   AddressToString (f.key.destination).c_str (), f.key.destinationPort, f.key.protocol,
+                   links[f.egress].name.c_str ());
+      std::printf ("  Tx Packets = %u, Rx Packets = %u, Lost Packets = %u\n",
+                   f.txPackets, f.rxPackets, f.txPackets - f.rxPackets);
+      std::printf ("  Throughput: %.3f Kbps\n", duration > 0 ? f.rxBytes * 8.0 / duration / 1024 : 0.0);
+      if (f.rxPackets > 0)
+        {
+          std::printf ("  Mean delay: %.6f s\n", f.delaySum / 1e9 / f.rxPackets);
+        }
+    }
+
+  if (argc > 3)
+    {
+      return WriteCsv (argv[3], links, flows, intervalNs);
+    }
+  return 0;
+}
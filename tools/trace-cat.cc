@@ -0,0 +1,201 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Stream the (compressed) trace files written with --TraceCompress.
+//
+//   g++ -O2 -DHAVE_ZLIB -o trace-cat tools/trace-cat.cc -lz
+//
+//   trace-cat goal-topo-ap1-wifi-2-2.pcap.gz [pcap [from [to]]] | tcpdump -nn -tt -r -
+//       the records as a plain pcap on stdout, only those from "from" to
+//       "to" seconds when given; with a time index (--PcapIndex) the
+//       records before "from" are not even read
+//
+//   trace-cat goal-topo-ap1-wifi-2-2.pcap.gz summary
+//       link type, records, captured and original bytes, first and last time
+//
+//   trace-cat goal-topo.tr.gz lines
+//       the lines of an ascii trace
+//
+//   trace-cat goal-topo.evl tr
+//       the binary event log (--TraceFormat=binary) as .tr lines: event,
+//       time and context as in the ascii trace, then the packet uid, size
+//       and the queue depth instead of the packet print
+//
+//   trace-cat goal-topo.pcapng packets
+//       one line per packet of a pcapng file (--Pcapng): time, interface,
+//       uid, comment (the node), captured and original length
+//
+// The file is decompressed as it is read, never as a whole.
+
+#include "../trace-reader.h"
+
+#include <inttypes.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static int
+Pcap (const char *filename, double from, double to)
+{
+  PcapReader reader;
+  if (!reader.Open (filename))
+    {
+      std::fprintf (stderr, "%s: not a pcap file\n", filename);
+      return 1;
+    }
+  uint32_t magic = 0xa1b23c4d;
+  uint16_t version[2] = { 2, 4 };
+  uint32_t header[4] = { 0, 0, reader.GetSnapLen (), reader.GetLinkType () };
+  std::fwrite (&magic, 4, 1, stdout);
+  std::fwrite (version, 2, 2, stdout);
+  std::fwrite (header, 4, 4, stdout);
+  if (from > 0 && !reader.SeekTime (from * 1e9))
+    {
+      std::fprintf (stderr, "%s: cannot seek\n", filename);
+      return 1;
+    }
+  PcapRecord r;
+  while (reader.Next (r) && r.timeNs <= to * 1e9)
+    {
+      uint32_t record[4] = { static_cast<uint32_t> (r.timeNs / 1000000000),
+                             static_cast<uint32_t> (r.timeNs % 1000000000),
+                             r.capturedLength, r.originalLength };
+      std::fwrite (record, 4, 4, stdout);
+      std::fwrite (r.data.data (), 1, r.capturedLength, stdout);
+    }
+  return 0;
+}
+
+static int
+Summary (const char *filename)
+{
+  PcapReader reader;
+  if (!reader.Open (filename))
+    {
+      std::fprintf (stderr, "%s: not a pcap file\n", filename);
+      return 1;
+    }
+  PcapRecord r;
+  uint64_t records = 0, captured = 0, original = 0, first = 0, last = 0;
+  while (reader.Next (r))
+    {
+      if (records == 0)
+        {
+          first = r.timeNs;
+        }
+      last = r.timeNs;
+      records++;
+      captured += r.capturedLength;
+      original += r.originalLength;
+    }
+  std::printf ("%s: link type %u, snaplen %u\n", filename, reader.GetLinkType (), reader.GetSnapLen ());
+  std::printf ("  %" PRIu64 " records, %" PRIu64 " bytes captured, %" PRIu64 " bytes on the wire\n",
+               records, captured, original);
+  std::printf ("  from %.6f s to %.6f s\n", first / 1e9, last / 1e9);
+  return 0;
+}
+
+static int
+Lines (const char *filename)
+{
+  TraceLineReader reader;
+  if (!reader.Open (filename))
+    {
+      std::fprintf (stderr, "%s: cannot open\n", filename);
+      return 1;
+    }
+  std::string line;
+  while (reader.Next (line))
+    {
+      std::fwrite (line.data (), 1, line.size (), stdout);
+      std::fputc ('\n', stdout);
+    }
+  return 0;
+}
+
+static int
+Tr (const char *filename)
+{
+  EventLogReader reader;
+  if (!reader.Open (filename))
+    {
+      std::fprintf (stderr, "%s: not an event log\n", filename);
+      return 1;
+    }
+  EventLogRecord r;
+  while (reader.Next (r))
+    {
+      /* %g is how the ascii trace prints the time in seconds */
+      std::printf ("%c %g /NodeList/%u/DeviceList/%u/$ns3::CsmaNetDevice/%s uid=%" PRIu64 " size=%u queue=%u\n",
+                   EventLogSymbol (r.type), r.timeNs / 1e9, r.node, r.device, EventLogSource (r.type),
+                   r.uid, r.size, r.queueDepth);
+    }
+  return 0;
+}
+
+static int
+Packets (const char *filename)
+{
+  PcapngReader reader;
+  if (!reader.Open (filename))
+    {
+      std::fprintf (stderr, "%s: not a pcapng file\n", filename);
+      return 1;
+    }
+  PcapngRecord r;
+  while (reader.Next (r))
+    {
+      const PcapngInterface &i = reader.GetInterface (r.interface);
+      std::printf ("%.9f %s uid=%" PRIu64 " %s %u/%u\n", r.timeNs / 1e9,
+                   i.name.empty () ? "-" : i.name.c_str (), r.packetId,
+                   r.comment.empty () ? "-" : r.comment.c_str (), r.capturedLength, r.originalLength);
+    }
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::fprintf (stderr, "usage: %s <trace file> [pcap [from [to]]|summary|lines|tr|packets]\n", argv[0]);
+      return 2;
+    }
+  std::string mode = argc > 2 ? argv[2] : "pcap";
+  if (mode == "pcap")
+    {
+      return Pcap (argv[1], argc > 3 ? std::atof (argv[3]) : 0, argc > 4 ? std::atof (argv[4]) : 1e18);
+    }
+  if (mode == "summary")
+    {
+      return Summary (argv[1]);
+    }
+  if (mode == "lines")
+    {
+      return Lines (argv[1]);
+    }
+  if (mode == "tr")
+    {
+      return Tr (argv[1]);
+    }
+  if (mode == "packets")
+    {
+      return Packets (argv[1]);
+    }
+  std::fprintf (stderr, "unknown mode %s\n", mode.c_str ());
+  return 2;
+}
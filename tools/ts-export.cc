@@ -0,0 +1,143 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Export the binary time series written by TimeSeriesSampleSink.
+//
+//   g++ -O2 -o ts-export tools/ts-export.cc
+//
+//   ts-export goal-topo-SDN__TimeSeries.bin csv [out.csv]
+//       one "time,flow,metric,value" line per record (stdout by default)
+//
+//   ts-export goal-topo-SDN__TimeSeries.bin gnuplot goal-topo-SDN__
+//       goal-topo-SDN__ThroughputVSTime.plt/.dat, goal-topo-SDN__DelayVSTime.plt/.dat, ...
+//       then `gnuplot goal-topo-SDN__ThroughputVSTime.plt` gives the png as before
+//
+// Both modes stream the records, memory does not depend on the run length.
+
+#include "../time-series-writer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+
+static int
+ExportCsv (TimeSeriesReader &reader, const char *out)
+{
+  FILE *f = out ? std::fopen (out, "w") : stdout;
+  if (f == 0)
+    {
+      std::fprintf (stderr, "cannot open %s\n", out);
+      return 1;
+    }
+  std::fprintf (f, "time,flow,metric,value\n");
+  TimeSeriesRecord r;
+  while (reader.Next (r))
+    {
+      std::fprintf (f, "%.9g,%u,%s,%.9g\n", r.time, r.flowId, TimeSeriesMetricName (r.metric), r.value);
+    }
+  if (out)
+    {
+      std::fclose (f);
+    }
+  return 0;
+}
+
+static int
+ExportGnuplot (TimeSeriesReader &reader, std::string base)
+{
+  FILE *dat[TS_METRIC_COUNT];
+  std::set<uint32_t> flows[TS_METRIC_COUNT];
+  for (uint32_t m = 0; m < TS_METRIC_COUNT; m++)
+    {
+      std::string file = base + TimeSeriesMetricName (m) + "VSTime.dat";
+      dat[m] = std::fopen (file.c_str (), "w");
+      if (dat[m] == 0)
+        {
+          std::fprintf (stderr, "cannot open %s\n", file.c_str ());
+          return 1;
+        }
+    }
+
+  TimeSeriesRecord r;
+  while (reader.Next (r))
+    {
+      if (r.metric >= TS_METRIC_COUNT)
+        {
+          continue;
+        }
+      std::fprintf (dat[r.metric], "%.9g %u %.9g\n", r.time, r.flowId, r.value);
+      flows[r.metric].insert (r.flowId);
+    }
+
+  for (uint32_t m = 0; m < TS_METRIC_COUNT; m++)
+    {
+      std::fclose (dat[m]);
+      std::string name = TimeSeriesMetricName (m);
+      std::string file = base + name + "VSTime";
+      FILE *plt = std::fopen ((file + ".plt").c_str (), "w");
+      if (plt == 0)
+        {
+          std::fprintf (stderr, "cannot open %s.plt\n", file.c_str ());
+          return 1;
+        }
+      std::fprintf (plt, "set terminal png\n");
+      std::fprintf (plt, "set output \"%s.png\"\n", file.c_str ());
+      std::fprintf (plt, "set title \"%s vs Time\"\n", name.c_str ());
+      std::fprintf (plt, "set xlabel \"Time\"\n");
+      std::fprintf (plt, "set ylabel \"%s\"\n", name.c_str ());
+      std::fprintf (plt, "plot");
+      for (std::set<uint32_t>::const_iterator f = flows[m].begin (); f != flows[m].end (); ++f)
+        {
+          std::fprintf (plt, "%s \"%sVSTime.dat\" using 1:($2 == %u ? $3 : NaN) title \"%s flow %u\" with linespoints",
+                        f == flows[m].begin () ? "" : ",", (base + name).c_str (), *f, name.c_str (), *f);
+        }
+      if (flows[m].empty ())
+        {
+          std::fprintf (plt, " NaN notitle");
+        }
+      std::fprintf (plt, "\n");
+      std::fclose (plt);
+    }
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 3)
+    {
+      std::fprintf (stderr, "usage: %s <file.bin> csv [out.csv]\n"
+                    "       %s <file.bin> gnuplot <prefix>\n", argv[0], argv[0]);
+      return 1;
+    }
+  TimeSeriesReader reader (argv[1]);
+  if (!reader.IsOpen ())
+    {
+      std::fprintf (stderr, "%s is not a time-series file\n", argv[1]);
+      return 1;
+    }
+  if (std::strcmp (argv[2], "csv") == 0)
+    {
+      return ExportCsv (reader, argc > 3 ? argv[3] : 0);
+    }
+  if (std::strcmp (argv[2], "gnuplot") == 0 && argc > 3)
+    {
+      return ExportGnuplot (reader, argv[3]);
+    }
+  std::fprintf (stderr, "unknown mode %s\n", argv[2]);
+  return 1;
+}
@@ -0,0 +1,1161 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TRACE_CAPTURE_H
+#define TRACE_CAPTURE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/wifi-module.h"
+
+#include "event-log.h"
+#include "pcap-writer.h"
+#include "pcapng-writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief Pcap capture of csma and wifi devices with buffered, asynchronous writes.
+ *
+ * Takes the place of CsmaHelper::EnablePcap () and
+ * YansWifiPhyHelper::EnablePcap (): same trace sources, same file names
+ * (prefix-<node>-<device>.pcap), same link types, but every record is
+ * appended to a per-file buffer and the full buffers are written by a
+ * background thread, so the simulator thread never waits on the disk.
+ *
+ * The wifi records are taken from the MonitorSnifferTx/Rx sources and get the
+ * radiotap fields YansWifiPhyHelper writes: TSFT, flags, rate, channel, the
+ * antenna signal and noise of the received frames, and the MCS, A-MPDU status
+ * and VHT fields of the 802.11n/ac frames.
+ *
+ * EnableCsmaAsciiAll () does the same for CsmaHelper::EnableAsciiAll (): the
+ * same "+ - d r" lines, written through the same threads.  With
+ * SetCompression () every file gets a ".gz" suffix and its buffers are
+ * compressed by several threads; trace-reader.h reads them back as a stream.
+ *
+ * EnableCsmaEventLog () logs the same events as fixed-size binary records
+ * (event-log.h) with the queue depth, and no text formatting or packet
+ * printing on the simulator thread; "trace-cat <file> tr" writes the .tr
+ * lines back from it.
+ *
+ * SetSnapLen () cuts the pcap records like tcpdump -s does, the original
+ * length staying in the record; SNAPLEN_HEADERS keeps the headers up to the
+ * transport header of each frame and drops the payload, which is then never
+ * copied out of the packet.
+ *
+ * SetSampling () keeps one packet in N, per device, in the pcap files and
+ * in the ascii trace alike.  The choice is a hash of the five-tuple and the
+ * uid of the packet, both the same at every hop, so a packet kept on one
+ * device is kept on every device sampled at the same or a higher rate.
+ *
+ * SetFlightRecorder () keeps the last frames of each device in memory
+ * instead of writing them: they reach the pcap files only when Trigger ()
+ * is called, by a PHY RX or MAC TX drop on a traced device or from outside
+ * (see flight-recorder.h), plus what is captured for a while after it.  The
+ * ascii trace is not affected.
+ *
+ * SetPcapIndex () writes a time index next to every pcap file
+ * (pcap-index.h), which PcapReader::SeekTime () uses to start reading at a
+ * given time without scanning the file.
+ *
+ * SetPcapng () writes every device to one pcapng file instead of a pcap
+ * file each: an interface per device, named as its pcap file would be,
+ * the records in simulation time order, each with the packet uid
+ * (epb_packetid) and the node id (an opt_comment "node=<id>").
+ *
+ * AddWindow () limits the capture to time windows: every trace sink is
+ * connected at the start of a window and disconnected at its end, so
+ * nothing is called, copied or written outside of them.
+ *
+ * The files are closed from Simulator::Destroy (), so the object must live
+ * until then (declare it in main () before Simulator::Run ()).
+ */
+class TraceCapture
+{
+public:
+  TraceCapture ();
+  ~TraceCapture ();
+
+  /// Write all the devices to this pcapng file (empty: a pcap file each); set before the Enable calls.
+  void SetPcapng (std::string filename);
+  /// Index every pcap file, an entry per interval (zero: no index); set before the Enable calls.
+  void SetPcapIndex (Time interval);
+  /// Size of each per-file buffer, in bytes; set before the first Enable call.
+  void SetBufferSize (uint32_t bytes);
+  /// Write gzip files, compressed by threads threads; set before the first Enable call.
+  void SetCompression (bool enable, uint32_t threads = 2);
+  /// Bytes kept of each frame (radiotap included), or SNAPLEN_HEADERS; set before the first Enable call.
+  void SetSnapLen (uint32_t snapLen);
+
+  /// Snaplen keeping the link, IP and transport headers of every frame.
+  static const uint32_t SNAPLEN_HEADERS = 0;
+
+  /// Keep one packet in oneIn on every device; set before the Enable calls.
+  void SetSampling (uint32_t oneIn);
+  /// Keep one packet in oneIn on device ifIndex of node nodeId; set before the Enable calls.
+  void SetSampling (uint32_t nodeId, uint32_t ifIndex, uint32_t oneIn);
+  /**
+   * Per-device rates as on the command line, "node/device=N" separated by
+   * commas (e.g. "0/1=10,2/2=100"); false on a malformed entry.
+   */
+  bool ParseSampling (std::string spec);
+
+  /// The drops of the traced devices that call Trigger () in flight-recorder mode.
+  enum Triggers
+  {
+    TRIGGER_PHY_RX_DROP = 1,    //!< PhyRxDrop of a csma device or wifi PHY
+    TRIGGER_MAC_TX_DROP = 2     //!< MacTxDrop of a csma device or wifi MAC (queue full)
+  };
+
+  /**
+   * Flight-recorder mode; set before the Enable calls.
+   * \param packets frames kept per device (0: off, every frame is written)
+   * \param window only the frames of the last window are written (zero: all of them)
+   * \param after frames are written as they come for that long after a trigger
+   */
+  void SetFlightRecorder (uint32_t packets, Time window = Seconds (0), Time after = Seconds (0));
+  /// A mask of Triggers, all of them by default; set before the Enable calls.
+  void SetTriggers (uint32_t triggers);
+  /// Write what the devices hold; reason is only counted.
+  void Trigger (std::string reason);
+  /// How many times each trigger fired.
+  void PrintTriggers (std::ostream &os) const;
+
+  /**
+   * Capture from start to stop only (zero stop: to the end of the run);
+   * call it again for more windows, in time order and not overlapping.
+   * Without a window the capture goes on for the whole run.  Before the
+   * Enable calls.
+   */
+  void AddWindow (Time start, Time stop);
+  /**
+   * Windows as on the command line, "start-stop" in seconds separated by
+   * commas (e.g. "2-5,10-12"); false on a malformed entry or windows out of
+   * order.
+   */
+  bool ParseWindows (std::string spec);
+
+  /// Same as CsmaHelper::EnablePcap ().
+  void EnableCsma (std::string prefix, Ptr<NetDevice> device, bool promiscuous = false);
+  void EnableCsma (std::string prefix, NetDeviceContainer devices, bool promiscuous = false);
+  /// Same as YansWifiPhyHelper::EnablePcap () with DLT_IEEE802_11_RADIO.
+  void EnableWifi (std::string prefix, Ptr<NetDevice> device);
+  void EnableWifi (std::string prefix, NetDeviceContainer devices);
+  /// Same as CsmaHelper::EnableAsciiAll () on a file stream.
+  void EnableCsmaAsciiAll (std::string filename);
+  /// The events of EnableCsmaAsciiAll () as a binary event log.
+  void EnableCsmaEventLog (std::string filename);
+
+  /// Write everything out and close the files.
+  void Close (void);
+
+private:
+  TraceCapture (const TraceCapture &);
+  TraceCapture &operator= (const TraceCapture &);
+
+  /// A frame held in flight-recorder mode.
+  struct RingRecord
+  {
+    int64_t timeNs;
+    uint32_t originalLength;
+    uint64_t uid;
+    std::vector<uint8_t> bytes;   //!< what the pcap record keeps
+  };
+
+  struct Device
+  {
+    TraceCapture *capture;
+    Ptr<NetDevice> device;
+    uint32_t frameType;       //!< the link type of the frame, after the radiotap header
+    uint64_t threshold;       //!< sampling, see PcapSampleThreshold ()
+    PcapWriter pcap;          //!< not open with SetPcapng ()
+    uint32_t interface;       //!< in the pcapng file
+    uint32_t nodeId;
+    std::vector<RingRecord> ring;
+    uint32_t ringHead;        //!< oldest record
+    uint32_t ringCount;
+  };
+
+  /// A ring record to write on a trigger: its time, device and record.
+  typedef std::pair<int64_t, std::pair<Device *, const RingRecord *> > HeldRecord;
+  static bool LessTime (const HeldRecord &a, const HeldRecord &b);
+
+  /// One event type of one ascii file.
+  struct AsciiSink
+  {
+    TraceCapture *capture;
+    AsyncTraceFile *file;
+    char event;
+    uint64_t threshold;
+  };
+
+  /// One event type of one csma device in the event log.
+  struct EventSink
+  {
+    TraceCapture *capture;
+    AsyncTraceFile *file;
+    Ptr<Queue> queue;
+    EventLogRecord record;    //!< node, device and type filled in
+    uint64_t threshold;
+  };
+
+  /// A trace sink, connected within the windows.
+  struct Connection
+  {
+    Ptr<Object> object;
+    std::string name;
+    std::string context;      //!< empty: connected without a context
+    CallbackBase callback;
+  };
+
+  /// Connect a trace source of object now, or at the start of the next window.
+  void Connect (Ptr<Object> object, std::string name, std::string context, const CallbackBase &callback);
+  void ConnectAll (void);
+  void DisconnectAll (void);
+
+  TraceIoThread *GetIo (void);
+  std::string GetFilename (std::string filename) const;
+  uint64_t GetThreshold (uint32_t nodeId, uint32_t ifIndex) const;
+  bool IsSampled (uint64_t threshold, uint32_t frameType, Ptr<const Packet> packet);
+  Device *Add (std::string prefix, Ptr<NetDevice> device, uint32_t linkType, uint32_t frameType);
+  void Capture (Device *device, Ptr<const Packet> packet, const uint8_t *prefix, uint32_t prefixLength);
+  void Record (Device *device, int64_t timeNs, const uint8_t *prefix, uint32_t prefixLength,
+               const uint8_t *data, uint32_t dataLength, uint32_t originalLength, uint64_t uid);
+  /// Write one record to the pcap file of the device or to the pcapng file.
+  void Write (Device *device, int64_t timeNs, const uint8_t *prefix, uint32_t prefixLength,
+              const uint8_t *data, uint32_t dataLength, uint32_t originalLength, uint64_t uid);
+  void ConnectTriggers (Device *device, Ptr<Object> phy, Ptr<Object> mac);
+
+  static void CsmaSniffer (Device *device, Ptr<const Packet> packet);
+  static void WifiSnifferTx (Device *device, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                             uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                             WifiTxVector txVector, struct mpduInfo aMpdu);
+  static void WifiSnifferRx (Device *device, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                             uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                             WifiTxVector txVector, struct mpduInfo aMpdu,
+                             struct signalNoiseDbm signalNoise);
+  /// The radiotap header of YansWifiPhyHelper's pcap sinks; no signal and noise when signalNoise is 0.
+  static void WifiSniffer (Device *device, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                           uint32_t rate, WifiPreamble preamble, const WifiTxVector &txVector,
+                           const struct mpduInfo &aMpdu, const struct signalNoiseDbm *signalNoise);
+  /// Append a little endian radiotap field of size bytes, aligned on its size.
+  static void RadiotapPut (uint8_t *radiotap, uint32_t &length, uint64_t value, uint32_t size);
+  static void AsciiEvent (AsciiSink *sink, std::string context, Ptr<const Packet> packet);
+  static void LogEvent (EventSink *sink, Ptr<const Packet> packet);
+  static void PhyRxDrop (TraceCapture *capture, Ptr<const Packet> packet);
+  static void MacTxDrop (TraceCapture *capture, Ptr<const Packet> packet);
+
+  static const uint32_t RADIOTAP_MAX_LENGTH = 64;
+
+  uint32_t m_bufferSize;
+  bool m_compress;
+  uint32_t m_threads;
+  uint32_t m_snapLen;
+  uint32_t m_sampling;
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> m_deviceSampling;
+  Time m_pcapIndex;
+  std::string m_pcapngFilename;
+  PcapngWriter m_pcapng;
+  TraceIoThread *m_io;
+  bool m_closed;
+  uint32_t m_ringPackets;
+  Time m_ringWindow;
+  Time m_ringAfter;
+  uint32_t m_triggerMask;
+  Time m_writeThrough;              //!< frames are written as they come until then
+  std::map<std::string, uint64_t> m_triggers;
+  std::vector<Device *> m_devices;
+  std::vector<AsyncTraceFile *> m_asciiFiles;
+  std::vector<AsciiSink *> m_asciiSinks;
+  std::vector<EventSink *> m_eventSinks;
+  std::vector<Connection> m_connections;
+  bool m_connected;                 //!< within a window, or no window
+  Time m_lastStop;                  //!< of the last window, zero: to the end
+  bool m_windows;
+  std::vector<uint8_t> m_scratch;
+  std::ostringstream m_line;
+};
+
+
+inline
+TraceCapture::TraceCapture ()
+  : m_bufferSize (1 << 20),
+    m_compress (false),
+    m_threads (1),
+    m_snapLen (65535),
+    m_sampling (1),
+    m_io (0),
+    m_closed (false),
+    m_ringPackets (0),
+    m_triggerMask (TRIGGER_PHY_RX_DROP | TRIGGER_MAC_TX_DROP),
+    m_connected (true),
+    m_windows (false)
+{
+}
+
+inline
+TraceCapture::~TraceCapture ()
+{
+  Close ();
+  for (std::vector<Device *>::iterator i = m_devices.begin (); i != m_devices.end (); ++i)
+    {
+      delete *i;
+    }
+  for (std::vector<AsyncTraceFile *>::iterator i = m_asciiFiles.begin (); i != m_asciiFiles.end (); ++i)
+    {
+      delete *i;
+    }
+  for (std::vector<AsciiSink *>::iterator i = m_asciiSinks.begin (); i != m_asciiSinks.end (); ++i)
+    {
+      delete *i;
+    }
+  for (std::vector<EventSink *>::iterator i = m_eventSinks.begin (); i != m_eventSinks.end (); ++i)
+    {
+      delete *i;
+    }
+}
+
+inline void
+TraceCapture::SetPcapng (std::string filename)
+{
+  NS_ASSERT_MSG (m_devices.empty (), "TraceCapture::SetPcapng () after an Enable call");
+  m_pcapngFilename = filename;
+}
+
+inline void
+TraceCapture::SetPcapIndex (Time interval)
+{
+  NS_ASSERT_MSG (m_devices.empty (), "TraceCapture::SetPcapIndex () after an Enable call");
+  m_pcapIndex = interval;
+}
+
+inline void
+TraceCapture::SetBufferSize (uint32_t bytes)
+{
+  NS_ASSERT_MSG (m_io == 0, "TraceCapture::SetBufferSize () after the first Enable call");
+  m_bufferSize = bytes;
+}
+
+inline void
+TraceCapture::SetCompression (bool enable, uint32_t threads)
+{
+  NS_ASSERT_MSG (m_io == 0, "TraceCapture::SetCompression () after the first Enable call");
+#ifndef HAVE_ZLIB
+  NS_ABORT_MSG_IF (enable, "TraceCapture::SetCompression () needs zlib: build with -DHAVE_ZLIB and -lz");
+#endif
+  m_compress = enable;
+  m_threads = threads > 0 ? threads : 1;
+}
+
+inline void
+TraceCapture::SetSnapLen (uint32_t snapLen)
+{
+  NS_ASSERT_MSG (m_io == 0, "TraceCapture::SetSnapLen () after the first Enable call");
+  m_snapLen = snapLen;
+}
+
+inline void
+TraceCapture::SetSampling (uint32_t oneIn)
+{
+  m_sampling = oneIn;
+}
+
+inline void
+TraceCapture::SetSampling (uint32_t nodeId, uint32_t ifIndex, uint32_t oneIn)
+{
+  m_deviceSampling[std::make_pair (nodeId, ifIndex)] = oneIn;
+}
+
+inline bool
+TraceCapture::ParseSampling (std::string spec)
+{
+  std::istringstream is (spec);
+  std::string entry;
+  while (std::getline (is, entry, ','))
+    {
+      if (entry.empty ())
+        {
+          continue;
+        }
+      unsigned nodeId, ifIndex, oneIn;
+      char slash, equal, extra;
+      std::istringstream es (entry);
+      if (!(es >> nodeId >> slash >> ifIndex >> equal >> oneIn) || slash != '/' || equal != '=' || (es >> extra))
+        {
+          return false;
+        }
+      SetSampling (nodeId, ifIndex, oneIn);
+    }
+  return true;
+}
+
+inline uint64_t
+TraceCapture::GetThreshold (uint32_t nodeId, uint32_t ifIndex) const
+{
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t>::const_iterator i =
+    m_deviceSampling.find (std::make_pair (nodeId, ifIndex));
+  return PcapSampleThreshold (i != m_deviceSampling.end () ? i->second : m_sampling);
+}
+
+inline void
+TraceCapture::SetFlightRecorder (uint32_t packets, Time window, Time after)
+{
+  NS_ASSERT_MSG (m_devices.empty (), "TraceCapture::SetFlightRecorder () after an Enable call");
+  m_ringPackets = packets;
+  m_ringWindow = window;
+  m_ringAfter = after;
+}
+
+inline void
+TraceCapture::SetTriggers (uint32_t triggers)
+{
+  m_triggerMask = triggers;
+}
+
+inline void
+TraceCapture::AddWindow (Time start, Time stop)
+{
+  NS_ASSERT_MSG (m_connections.empty (), "TraceCapture::AddWindow () after an Enable call");
+  NS_ASSERT_MSG (!m_windows || (!m_lastStop.IsZero () && start >= m_lastStop), "TraceCapture::AddWindow () out of order");
+  NS_ASSERT_MSG (stop.IsZero () || stop > start, "TraceCapture::AddWindow () ends before it starts");
+  m_windows = true;
+  m_connected = false;
+  m_lastStop = stop;
+  Simulator::Schedule (start - Simulator::Now (), &TraceCapture::ConnectAll, this);
+  if (!stop.IsZero ())
+    {
+      Simulator::Schedule (stop - Simulator::Now (), &TraceCapture::DisconnectAll, this);
+    }
+}
+
+inline bool
+TraceCapture::ParseWindows (std::string spec)
+{
+  std::vector<std::pair<double, double> > windows;
+  std::istringstream is (spec);
+  std::string entry;
+  double last = 0;
+  while (std::getline (is, entry, ','))
+    {
+      if (entry.empty ())
+        {
+          continue;
+        }
+      double start, stop;
+      char dash, extra;
+      std::istringstream es (entry);
+      if (!(es >> start >> dash >> stop) || dash != '-' || (es >> extra)
+          || start < last || (!windows.empty () && windows.back ().second == 0)
+          || (stop != 0 && stop <= start))
+        {
+          return false;
+        }
+      windows.push_back (std::make_pair (start, stop));
+      last = stop;
+    }
+  for (uint32_t i = 0; i < windows.size (); i++)
+    {
+      AddWindow (Seconds (windows[i].first), Seconds (windows[i].second));
+    }
+  return true;
+}
+
+inline void
+TraceCapture::Connect (Ptr<Object> object, std::string name, std::string context, const CallbackBase &callback)
+{
+  Connection c;
+  c.object = object;
+  c.name = name;
+  c.context = context;
+  c.callback = callback;
+  m_connections.push_back (c);
+  if (m_connected)
+    {
+      if (context.empty ())
+        {
+          object->TraceConnectWithoutContext (name, callback);
+        }
+      else
+        {
+          object->TraceConnect (name, context, callback);
+        }
+    }
+}
+
+inline void
+TraceCapture::ConnectAll (void)
+{
+  if (m_connected)
+    {
+      return;
+    }
+  m_connected = true;
+  for (std::vector<Connection>::const_iterator i = m_connections.begin (); i != m_connections.end (); ++i)
+    {
+      if (i->context.empty ())
+        {
+          i->object->TraceConnectWithoutContext (i->name, i->callback);
+        }
+      else
+        {
+          i->object->TraceConnect (i->name, i->context, i->callback);
+        }
+    }
+}
+
+inline void
+TraceCapture::DisconnectAll (void)
+{
+  if (!m_connected)
+    {
+      return;
+    }
+  m_connected = false;
+  for (std::vector<Connection>::const_iterator i = m_connections.begin (); i != m_connections.end (); ++i)
+    {
+      if (i->context.empty ())
+        {
+          i->object->TraceDisconnectWithoutContext (i->name, i->callback);
+        }
+      else
+        {
+          i->object->TraceDisconnect (i->name, i->context, i->callback);
+        }
+    }
+}
+
+inline void
+TraceCapture::ConnectTriggers (Device *device, Ptr<Object> phy, Ptr<Object> mac)
+{
+  if (m_ringPackets == 0)
+    {
+      return;
+    }
+  device->ring.resize (m_ringPackets);
+  if (m_triggerMask & TRIGGER_PHY_RX_DROP)
+    {
+      Connect (phy, "PhyRxDrop", "", MakeBoundCallback (&TraceCapture::PhyRxDrop, this));
+    }
+  if (m_triggerMask & TRIGGER_MAC_TX_DROP)
+    {
+      Connect (mac, "MacTxDrop", "", MakeBoundCallback (&TraceCapture::MacTxDrop, this));
+    }
+}
+
+inline void
+TraceCapture::Trigger (std::string reason)
+{
+  m_triggers[reason]++;
+  if (m_ringPackets == 0 || m_closed)
+    {
+      return;
+    }
+  Time now = Simulator::Now ();
+  int64_t oldest = m_ringWindow.IsStrictlyPositive () ? (now - m_ringWindow).GetNanoSeconds () : 0;
+  /* merge the rings, so that the records of a single pcapng file stay in
+   * time order; each ring already is */
+  std::vector<HeldRecord> held;
+  for (std::vector<Device *>::iterator i = m_devices.begin (); i != m_devices.end (); ++i)
+    {
+      Device *d = *i;
+      for (uint32_t k = 0; k < d->ringCount; k++)
+        {
+          const RingRecord &r = d->ring[(d->ringHead + k) % m_ringPackets];
+          if (r.timeNs >= oldest)
+            {
+              held.push_back (std::make_pair (r.timeNs, std::make_pair (d, &r)));
+            }
+        }
+    }
+  std::stable_sort (held.begin (), held.end (), LessTime);
+  for (uint32_t k = 0; k < held.size (); k++)
+    {
+      const RingRecord &r = *held[k].second.second;
+      Write (held[k].second.first, r.timeNs, r.bytes.data (), r.bytes.size (), 0, 0, r.originalLength, r.uid);
+    }
+  for (std::vector<Device *>::iterator i = m_devices.begin (); i != m_devices.end (); ++i)
+    {
+      (*i)->ringHead = 0;
+      (*i)->ringCount = 0;
+    }
+  if (now + m_ringAfter > m_writeThrough)
+    {
+      m_writeThrough = now + m_ringAfter;
+    }
+}
+
+inline bool
+TraceCapture::LessTime (const HeldRecord &a, const HeldRecord &b)
+{
+  return a.first < b.first;
+}
+
+inline void
+TraceCapture::PrintTriggers (std::ostream &os) const
+{
+  if (m_ringPackets == 0)
+    {
+      return;
+    }
+  os << "Flight recorder triggers:";
+  if (m_triggers.empty ())
+    {
+      os << " none";
+    }
+  for (std::map<std::string, uint64_t>::const_iterator i = m_triggers.begin (); i != m_triggers.end (); ++i)
+    {
+      os << " " << i->first << " x" << i->second;
+    }
+  os << std::endl;
+}
+
+inline void
+TraceCapture::PhyRxDrop (TraceCapture *capture, Ptr<const Packet> packet)
+{
+  capture->Trigger ("phy-rx-drop");
+}
+
+inline void
+TraceCapture::MacTxDrop (TraceCapture *capture, Ptr<const Packet> packet)
+{
+  capture->Trigger ("mac-tx-drop");
+}
+
+inline TraceIoThread *
+TraceCapture::GetIo (void)
+{
+  if (m_io == 0)
+    {
+      uint32_t pending = 2 * m_threads > 16 ? 2 * m_threads : 16;
+      m_io = new TraceIoThread (m_bufferSize, pending, m_compress ? m_threads : 1);
+      Simulator::ScheduleDestroy (&TraceCapture::Close, this);
+    }
+  return m_io;
+}
+
+inline std::string
+TraceCapture::GetFilename (std::string filename) const
+{
+  bool gz = filename.size () > 3 && filename.compare (filename.size () - 3, 3, ".gz") == 0;
+  return (m_compress && !gz) ? filename + ".gz" : filename;
+}
+
+inline TraceCapture::Device *
+TraceCapture::Add (std::string prefix, Ptr<NetDevice> device, uint32_t linkType, uint32_t frameType)
+{
+  std::ostringstream oss;
+  oss << prefix << "-" << device->GetNode ()->GetId () << "-" << device->GetIfIndex ();
+  uint32_t snapLen = m_snapLen == SNAPLEN_HEADERS ? 65535 : m_snapLen;
+  Device *d = new Device;
+  d->capture = this;
+  d->device = device;
+  d->frameType = frameType;
+  d->threshold = GetThreshold (device->GetNode ()->GetId (), device->GetIfIndex ());
+  d->interface = 0;
+  d->nodeId = device->GetNode ()->GetId ();
+  d->ringHead = 0;
+  d->ringCount = 0;
+  if (!m_pcapngFilename.empty ())
+    {
+      std::string filename = GetFilename (m_pcapngFilename);
+      if (!m_pcapng.IsOpen () && !m_pcapng.Open (filename, GetIo ()))
+        {
+          NS_FATAL_ERROR ("Cannot open " << filename);
+        }
+      /* the name of the pcap file it replaces, without the directory */
+      std::string name = oss.str ();
+      d->interface = m_pcapng.AddInterface (linkType, snapLen, name.substr (name.find_last_of ('/') + 1));
+    }
+  else
+    {
+      std::string filename = GetFilename (oss.str () + ".pcap");
+      uint64_t index = m_pcapIndex.IsStrictlyPositive () ? m_pcapIndex.GetNanoSeconds () : 0;
+      if (!d->pcap.Open (filename, linkType, snapLen, GetIo (), index))
+        {
+          NS_FATAL_ERROR ("Cannot open " << filename);
+        }
+    }
+  m_devices.push_back (d);
+  return d;
+}
+
+inline void
+TraceCapture::EnableCsma (std::string prefix, Ptr<NetDevice> device, bool promiscuous)
+{
+  NS_ABORT_MSG_IF (DynamicCast<CsmaNetDevice> (device) == 0, "TraceCapture::EnableCsma () on a device that is not a CsmaNetDevice");
+  Device *d = Add (prefix, device, PCAP_LINK_EN10MB, PCAP_LINK_EN10MB);
+  Connect (device, promiscuous ? "PromiscSniffer" : "Sniffer", "", MakeBoundCallback (&TraceCapture::CsmaSniffer, d));
+  ConnectTriggers (d, device, device);
+}
+
+inline void
+TraceCapture::EnableCsma (std::string prefix, NetDeviceContainer devices, bool promiscuous)
+{
+  for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); ++i)
+    {
+      EnableCsma (prefix, *i, promiscuous);
+    }
+}
+
+inline void
+TraceCapture::EnableWifi (std::string prefix, Ptr<NetDevice> device)
+{
+  Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice> (device);
+  NS_ABORT_MSG_IF (wifi == 0, "TraceCapture::EnableWifi () on a device that is not a WifiNetDevice");
+  Device *d = Add (prefix, device, PCAP_LINK_IEEE802_11_RADIO, PCAP_LINK_IEEE802_11);
+  Ptr<WifiPhy> phy = wifi->GetPhy ();
+  Connect (phy, "MonitorSnifferTx", "", MakeBoundCallback (&TraceCapture::WifiSnifferTx, d));
+  Connect (phy, "MonitorSnifferRx", "", MakeBoundCallback (&TraceCapture::WifiSnifferRx, d));
+  ConnectTriggers (d, phy, wifi->GetMac ());
+}
+
+inline void
+TraceCapture::EnableWifi (std::string prefix, NetDeviceContainer devices)
+{
+  for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); ++i)
+    {
+      EnableWifi (prefix, *i);
+    }
+}
+
+inline void
+TraceCapture::EnableCsmaAsciiAll (std::string filename)
+{
+  filename = GetFilename (filename);
+  AsyncTraceFile *file = new AsyncTraceFile;
+  if (!file->Open (filename, GetIo ()))
+    {
+      delete file;
+      NS_FATAL_ERROR ("Cannot open " << filename);
+    }
+  m_asciiFiles.push_back (file);
+
+  /* the sources CsmaHelper connects, with the context of its paths, so
+   * that the lines are the same */
+  static const char *sources[] = { "MacRx", "Enqueue", "Dequeue", "Drop" };
+  static const char *paths[] = { "MacRx", "TxQueue/Enqueue", "TxQueue/Dequeue", "TxQueue/Drop" };
+  static const char events[] = { 'r', '+', '-', 'd' };
+  for (uint32_t n = 0; n < NodeList::GetNNodes (); n++)
+    {
+      Ptr<Node> node = NodeList::GetNode (n);
+      for (uint32_t i = 0; i < node->GetNDevices (); i++)
+        {
+          Ptr<CsmaNetDevice> device = DynamicCast<CsmaNetDevice> (node->GetDevice (i));
+          if (device == 0)
+            {
+              continue;
+            }
+          for (uint32_t s = 0; s < 4; s++)
+            {
+              AsciiSink *sink = new AsciiSink;
+              sink->capture = this;
+              sink->file = file;
+              sink->event = events[s];
+              sink->threshold = GetThreshold (n, i);
+              m_asciiSinks.push_back (sink);
+              std::ostringstream path;
+              path << "/NodeList/" << n << "/DeviceList/" << i << "/$ns3::CsmaNetDevice/" << paths[s];
+              Ptr<Object> source = s == 0 ? Ptr<Object> (device) : Ptr<Object> (device->GetQueue ());
+              Connect (source, sources[s], path.str (), MakeBoundCallback (&TraceCapture::AsciiEvent, sink));
+            }
+        }
+    }
+}
+
+inline void
+TraceCapture::EnableCsmaEventLog (std::string filename)
+{
+  filename = GetFilename (filename);
+  AsyncTraceFile *file = new AsyncTraceFile;
+  if (!file->Open (filename, GetIo ()))
+    {
+      delete file;
+      NS_FATAL_ERROR ("Cannot open " << filename);
+    }
+  m_asciiFiles.push_back (file);
+  EventLogHeader header;
+  std::memcpy (header.magic, "NS3EVLOG", 8);
+  header.version = EVENT_LOG_VERSION;
+  header.recordSize = sizeof (EventLogRecord);
+  file->Write (&header, sizeof (header));
+
+  /* the sources of EnableCsmaAsciiAll (), connected without a context */
+  static const char *sources[] = { "Enqueue", "Dequeue", "Drop", "MacRx" };
+  for (uint32_t n = 0; n < NodeList::GetNNodes (); n++)
+    {
+      Ptr<Node> node = NodeList::GetNode (n);
+      for (uint32_t i = 0; i < node->GetNDevices (); i++)
+        {
+          Ptr<CsmaNetDevice> device = DynamicCast<CsmaNetDevice> (node->GetDevice (i));
+          if (device == 0)
+            {
+              continue;
+            }
+          for (uint8_t type = EVENT_LOG_ENQUEUE; type <= EVENT_LOG_RECEIVE; type++)
+            {
+              EventSink *sink = new EventSink;
+              sink->capture = this;
+              sink->file = file;
+              sink->queue = device->GetQueue ();
+              std::memset (&sink->record, 0, sizeof (sink->record));
+              sink->record.node = n;
+              sink->record.device = i;
+              sink->record.type = type;
+              sink->threshold = GetThreshold (n, i);
+              m_eventSinks.push_back (sink);
+              Ptr<Object> source = type == EVENT_LOG_RECEIVE ? Ptr<Object> (device) : Ptr<Object> (sink->queue);
+              Connect (source, sources[type], "", MakeBoundCallback (&TraceCapture::LogEvent, sink));
+            }
+        }
+    }
+}
+
+inline void
+TraceCapture::Close (void)
+{
+  if (m_closed || m_io == 0)
+    {
+      return;
+    }
+  m_closed = true;
+  for (std::vector<Device *>::iterator i = m_devices.begin (); i != m_devices.end (); ++i)
+    {
+      (*i)->pcap.Close ();
+    }
+  m_pcapng.Close ();
+  for (std::vector<AsyncTraceFile *>::iterator i = m_asciiFiles.begin (); i != m_asciiFiles.end (); ++i)
+    {
+      (*i)->Close ();
+    }
+  m_io->Close ();
+  delete m_io;
+  m_io = 0;
+}
+
+inline bool
+TraceCapture::IsSampled (uint64_t threshold, uint32_t frameType, Ptr<const Packet> packet)
+{
+  if (threshold == PcapSampleThreshold (1))
+    {
+      return true;
+    }
+  uint32_t size = packet->GetSize ();
+  uint32_t peek = size < PCAP_MAX_HEADERS ? size : PCAP_MAX_HEADERS;
+  if (m_scratch.size () < peek)
+    {
+      m_scratch.resize (peek);
+    }
+  packet->CopyData (m_scratch.data (), peek);
+  PcapFrameInfo info;
+  PcapParseFrame (frameType, m_scratch.data (), peek, size, info);
+  return PcapSampleHash (info, packet->GetUid ()) < threshold;
+}
+
+inline void
+TraceCapture::Capture (Device *device, Ptr<const Packet> packet, const uint8_t *prefix, uint32_t prefixLength)
+{
+  if (!IsSampled (device->threshold, device->frameType, packet))
+    {
+      return;
+    }
+  uint32_t size = packet->GetSize ();
+  /* only copy what the record keeps */
+  uint32_t copy = size;
+  if (m_snapLen == SNAPLEN_HEADERS)
+    {
+      copy = size < PCAP_MAX_HEADERS ? size : PCAP_MAX_HEADERS;
+    }
+  else if (m_snapLen < prefixLength + size)
+    {
+      copy = m_snapLen > prefixLength ? m_snapLen - prefixLength : 0;
+    }
+  if (m_scratch.size () < copy)
+    {
+      m_scratch.resize (copy);
+    }
+  packet->CopyData (m_scratch.data (), copy);
+  if (m_snapLen == SNAPLEN_HEADERS)
+    {
+      PcapFrameInfo info;
+      PcapParseFrame (device->frameType, m_scratch.data (), copy, size, info);
+      copy = info.headersLength < copy ? info.headersLength : copy;
+    }
+  Record (device, Simulator::Now ().GetNanoSeconds (), prefix, prefixLength,
+          m_scratch.data (), copy, prefixLength + size, packet->GetUid ());
+}
+
+inline void
+TraceCapture::Write (Device *device, int64_t timeNs, const uint8_t *prefix, uint32_t prefixLength,
+                     const uint8_t *data, uint32_t dataLength, uint32_t originalLength, uint64_t uid)
+{
+  if (m_pcapng.IsOpen ())
+    {
+      m_pcapng.Write (device->interface, timeNs, prefix, prefixLength, data, dataLength,
+                      originalLength, uid, device->nodeId);
+    }
+  else
+    {
+      device->pcap.Write (timeNs, prefix, prefixLength, data, dataLength, originalLength, uid);
+    }
+}
+
+inline void
+TraceCapture::Record (Device *device, int64_t timeNs, const uint8_t *prefix, uint32_t prefixLength,
+                      const uint8_t *data, uint32_t dataLength, uint32_t originalLength, uint64_t uid)
+{
+  if (m_ringPackets == 0 || Simulator::Now () < m_writeThrough)
+    {
+      Write (device, timeNs, prefix, prefixLength, data, dataLength, originalLength, uid);
+      return;
+    }
+  /* overwrite the oldest record once the ring is full; the vectors keep
+   * their capacity, so a full ring allocates nothing */
+  uint32_t slot = (device->ringHead + device->ringCount) % m_ringPackets;
+  if (device->ringCount == m_ringPackets)
+    {
+      device->ringHead = (device->ringHead + 1) % m_ringPackets;
+    }
+  else
+    {
+      device->ringCount++;
+    }
+  RingRecord &r = device->ring[slot];
+  r.timeNs = timeNs;
+  r.originalLength = originalLength;
+  r.uid = uid;
+  r.bytes.assign (prefix, prefix + prefixLength);
+  r.bytes.insert (r.bytes.end (), data, data + dataLength);
+}
+
+inline void
+TraceCapture::CsmaSniffer (Device *device, Ptr<const Packet> packet)
+{
+  device->capture->Capture (device, packet, 0, 0);
+}
+
+inline void
+TraceCapture::WifiSnifferTx (Device *device, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                             uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                             WifiTxVector txVector, struct mpduInfo aMpdu)
+{
+  WifiSniffer (device, packet, channelFreqMhz, rate, preamble, txVector, aMpdu, 0);
+}
+
+inline void
+TraceCapture::WifiSnifferRx (Device *device, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                             uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                             WifiTxVector txVector, struct mpduInfo aMpdu,
+                             struct signalNoiseDbm signalNoise)
+{
+  WifiSniffer (device, packet, channelFreqMhz, rate, preamble, txVector, aMpdu, &signalNoise);
+}
+
+inline void
+TraceCapture::RadiotapPut (uint8_t *radiotap, uint32_t &length, uint64_t value, uint32_t size)
+{
+  while (length % size != 0)
+    {
+      radiotap[length++] = 0;
+    }
+  for (uint32_t i = 0; i < size; i++)
+    {
+      radiotap[length++] = (value >> (8 * i)) & 0xff;
+    }
+}
+
+inline void
+TraceCapture::WifiSniffer (Device *device, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                           uint32_t rate, WifiPreamble preamble, const WifiTxVector &txVector,
+                           const struct mpduInfo &aMpdu, const struct signalNoiseDbm *signalNoise)
+{
+  /* the fields, bits and values of RadiotapHeader as YansWifiPhyHelper sets
+   * them, in the order of their present bits; rate is in 500 kb/s, and
+   * 128 + the MCS index for the HT and VHT frames */
+  uint8_t radiotap[RADIOTAP_MAX_LENGTH];
+  uint32_t length = 8;
+  uint32_t present = 0x0f;                  // TSFT, flags, rate, channel
+  RadiotapPut (radiotap, length, Simulator::Now ().GetMicroSeconds (), 8);
+
+  uint8_t frameFlags = 0x10;                // the frame includes its FCS
+  if (preamble == WIFI_PREAMBLE_SHORT)
+    {
+      frameFlags |= 0x02;
+    }
+  if (txVector.IsShortGuardInterval ())
+    {
+      frameFlags |= 0x80;
+    }
+  RadiotapPut (radiotap, length, frameFlags, 1);
+  RadiotapPut (radiotap, length, rate, 1);
+
+  /* 1, 2, 5.5 and 11 Mb/s are CCK, the rest OFDM */
+  uint16_t channelFlags = (rate == 2 || rate == 4 || rate == 11 || rate == 22) ? 0x0020 : 0x0040;
+  channelFlags |= channelFreqMhz < 2500 ? 0x0080 : 0x0100;
+  RadiotapPut (radiotap, length, channelFreqMhz, 2);
+  RadiotapPut (radiotap, length, channelFlags, 2);
+
+  if (signalNoise != 0)
+    {
+      present |= 0x60;                      // antenna signal and noise, dBm
+      RadiotapPut (radiotap, length, static_cast<int8_t> (std::floor (signalNoise->signal + 0.5)) & 0xff, 1);
+      RadiotapPut (radiotap, length, static_cast<int8_t> (std::floor (signalNoise->noise + 0.5)) & 0xff, 1);
+    }
+
+  if (preamble == WIFI_PREAMBLE_HT_MF || preamble == WIFI_PREAMBLE_HT_GF || preamble == WIFI_PREAMBLE_NONE)
+    {
+      /* known: bandwidth, index, guard interval, HT format, FEC type, STBC, Ness */
+      uint8_t mcsKnown = 0x7f;
+      uint8_t mcsFlags = 0;
+      if (txVector.GetChannelWidth () == 40)
+        {
+          mcsFlags |= 0x01;
+        }
+      if (txVector.IsShortGuardInterval ())
+        {
+          mcsFlags |= 0x04;
+        }
+      if (preamble == WIFI_PREAMBLE_HT_GF)
+        {
+          mcsFlags |= 0x08;
+        }
+      if (txVector.GetNess () & 0x01)
+        {
+          mcsFlags |= 0x80;
+        }
+      if (txVector.GetNess () & 0x02)
+        {
+          mcsKnown |= 0x80;
+        }
+      if (txVector.IsStbc ())
+        {
+          mcsFlags |= 0x20;
+        }
+      present |= 1 << 19;
+      RadiotapPut (radiotap, length, mcsKnown, 1);
+      RadiotapPut (radiotap, length, mcsFlags, 1);
+      RadiotapPut (radiotap, length, rate - 128, 1);
+    }
+
+  if (txVector.IsAggregation ())
+    {
+      /* the subframe delimiter and padding are not part of the capture */
+      Ptr<Packet> p = packet->Copy ();
+      AmpduSubframeHeader hdr;
+      p->RemoveHeader (hdr);
+      packet = p->CreateFragment (0, hdr.GetLength ());
+      uint16_t ampduFlags = 0x0024;         // delimiter CRC known, last known
+      if (aMpdu.type == LAST_MPDU_IN_AGGREGATE || (hdr.GetEof () && hdr.GetLength () > 0))
+        {
+          ampduFlags |= 0x0008;
+        }
+      present |= 1 << 20;
+      RadiotapPut (radiotap, length, aMpdu.mpduRefNumber, 4);
+      RadiotapPut (radiotap, length, ampduFlags, 2);
+      RadiotapPut (radiotap, length, hdr.GetCrc (), 1);
+      RadiotapPut (radiotap, length, 0, 1);
+    }
+
+  if (preamble == WIFI_PREAMBLE_VHT)
+    {
+      /* known: STBC, guard interval, beamformed, bandwidth; SU PPDUs only */
+      uint16_t vhtKnown = 0x0065;
+      uint8_t vhtFlags = 0;
+      uint8_t vhtBandwidth = 0;
+      if (txVector.IsStbc ())
+        {
+          vhtFlags |= 0x01;
+        }
+      if (txVector.IsShortGuardInterval ())
+        {
+          vhtFlags |= 0x04;
+        }
+      switch (txVector.GetChannelWidth ())
+        {
+        case 40:
+          vhtBandwidth = 1;
+          break;
+        case 80:
+          vhtBandwidth = 4;
+          break;
+        case 160:
+          vhtBandwidth = 11;
+          break;
+        }
+      present |= 1 << 21;
+      RadiotapPut (radiotap, length, vhtKnown, 2);
+      RadiotapPut (radiotap, length, vhtFlags, 1);
+      RadiotapPut (radiotap, length, vhtBandwidth, 1);
+      RadiotapPut (radiotap, length, (((rate - 128) << 4) & 0xf0) | (txVector.GetNss () & 0x0f), 1);
+      for (uint32_t user = 1; user < 4; user++)
+        {
+          RadiotapPut (radiotap, length, 0, 1);
+        }
+      RadiotapPut (radiotap, length, 0, 1);   // coding
+      RadiotapPut (radiotap, length, 0, 1);   // group id
+      RadiotapPut (radiotap, length, 0, 2);   // partial AID
+    }
+
+  /* version, pad, length, present */
+  uint32_t header = 0;
+  RadiotapPut (radiotap, header, 0, 2);
+  RadiotapPut (radiotap, header, length, 2);
+  RadiotapPut (radiotap, header, present, 4);
+  device->capture->Capture (device, packet, radiotap, length);
+}
+
+inline void
+TraceCapture::AsciiEvent (AsciiSink *sink, std::string context, Ptr<const Packet> packet)
+{
+  if (!sink->capture->IsSampled (sink->threshold, PCAP_LINK_EN10MB, packet))
+    {
+      return;
+    }
+  /* the line AsciiTraceHelper's default sinks write */
+  std::ostringstream &line = sink->capture->m_line;
+  line.str ("");
+  line << sink->event << " " << Simulator::Now ().GetSeconds () << " " << context << " " << *packet << std::endl;
+  const std::string &text = line.str ();
+  sink->file->Write (text.data (), text.size ());
+}
+
+inline void
+TraceCapture::LogEvent (EventSink *sink, Ptr<const Packet> packet)
+{
+  if (!sink->capture->IsSampled (sink->threshold, PCAP_LINK_EN10MB, packet))
+    {
+      return;
+    }
+  EventLogRecord &r = sink->record;
+  r.timeNs = Simulator::Now ().GetNanoSeconds ();
+  r.uid = packet->GetUid ();
+  r.size = packet->GetSize ();
+  r.queueDepth = sink->queue->GetNPackets ();
+  sink->file->Write (&r, sizeof (r));
+}
+
+} // namespace ns3
+
+#endif /* TRACE_CAPTURE_H */
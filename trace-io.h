@@ -0,0 +1,427 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TRACE_IO_H
+#define TRACE_IO_H
+
+/*
+ * Buffered trace files written by a background thread.
+ *
+ * Each AsyncTraceFile appends to its own large buffer on the simulator
+ * thread; a full buffer is handed to the TraceIoThread, which does the
+ * fwrite () while the simulation goes on.  Buffers are recycled, so once
+ * the run is going no memory is allocated per buffer.
+ *
+ * A file whose name ends in ".gz" is compressed: every buffer becomes an
+ * independent gzip member, so the buffers compress in parallel and the
+ * file is still one valid gzip stream (zcat, gzread () and trace-reader.h
+ * read it as a whole).
+ *
+ * This file does not depend on ns-3.  The ".gz" files need zlib: build with
+ * -DHAVE_ZLIB and link with -lz; without it only the plain files open.
+ */
+
+#include <stdint.h>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/**
+ * \brief The background threads that compress and write the full trace buffers.
+ *
+ * One pool serves every file.  The threads compress concurrently, but the
+ * buffers are written in the order they were submitted, so the buffers of a
+ * file stay in order.  At most maxPending buffers wait in the queue: past
+ * that Submit () blocks, which bounds the memory when the disk cannot keep
+ * up.
+ */
+class TraceIoThread
+{
+public:
+  /**
+   * \param bufferSize size of the buffers, in bytes
+   * \param maxPending buffers queued before Submit () blocks
+   * \param threads threads compressing (and writing) the buffers
+   * \param level zlib compression level of the ".gz" files
+   */
+  TraceIoThread (uint32_t bufferSize = 1 << 20, uint32_t maxPending = 16, uint32_t threads = 1, int level = 6);
+  ~TraceIoThread ();
+
+  uint32_t GetBufferSize (void) const;
+  /// An empty buffer with at least GetBufferSize () bytes reserved.
+  void GetBuffer (std::vector<char> &buffer);
+  /**
+   * Queue buffer for writing to file; buffer is left empty.  With compress,
+   * the buffer is written as one gzip member.  With close, the file is
+   * closed once the buffer is written.
+   */
+  void Submit (FILE *file, std::vector<char> &buffer, bool compress, bool close);
+  /// Wait until every queued buffer is written.
+  void Sync (void);
+  /// Write what is queued and stop the threads.
+  void Close (void);
+
+private:
+  TraceIoThread (const TraceIoThread &);
+  TraceIoThread &operator= (const TraceIoThread &);
+
+  struct Job
+  {
+    FILE *file;
+    std::vector<char> data;
+    bool compress;
+    bool close;
+  };
+
+  void Run (void);
+#ifdef HAVE_ZLIB
+  bool Compress (z_stream &z, const std::vector<char> &in, std::vector<char> &out);
+#endif
+
+  uint32_t m_bufferSize;
+  uint32_t m_maxPending;
+  int m_level;
+  std::mutex m_mutex;
+  std::condition_variable m_work;    //!< a job was queued, or closing
+  std::condition_variable m_done;    //!< a job was written
+  std::deque<Job> m_jobs;
+  std::vector<std::vector<char> > m_spare;
+  uint64_t m_taken;                  //!< jobs taken by a thread
+  uint64_t m_written;                //!< jobs written, in submission order
+  bool m_closing;
+  std::vector<std::thread> m_threads;
+};
+
+/**
+ * \brief A file written through a TraceIoThread.
+ *
+ * Write () only copies into the current buffer; the buffer goes to the
+ * I/O thread when it is full, on Flush () and on Close ().
+ */
+class AsyncTraceFile
+{
+public:
+  AsyncTraceFile ();
+  ~AsyncTraceFile ();
+
+  bool Open (std::string filename, TraceIoThread *io);
+  bool IsOpen (void) const;
+  void Write (const void *data, size_t size);
+  /// Hand the current buffer to the I/O thread.
+  void Flush (void);
+  void Close (void);
+  /// Bytes written to the file so far, buffered or not (before compression).
+  uint64_t GetOffset (void) const;
+
+private:
+  AsyncTraceFile (const AsyncTraceFile &);
+  AsyncTraceFile &operator= (const AsyncTraceFile &);
+
+  TraceIoThread *m_io;
+  FILE *m_file;
+  bool m_compress;
+  std::vector<char> m_buffer;
+  uint64_t m_offset;
+};
+
+
+inline
+TraceIoThread::TraceIoThread (uint32_t bufferSize, uint32_t maxPending, uint32_t threads, int level)
+  : m_bufferSize (bufferSize > 0 ? bufferSize : 1),
+    m_maxPending (maxPending > 0 ? maxPending : 1),
+    m_level (level),
+    m_taken (0),
+    m_written (0),
+    m_closing (false)
+{
+  for (uint32_t i = 0; i < (threads > 0 ? threads : 1); i++)
+    {
+      m_threads.push_back (std::thread (&TraceIoThread::Run, this));
+    }
+}
+
+inline
+TraceIoThread::~TraceIoThread ()
+{
+  Close ();
+}
+
+inline uint32_t
+TraceIoThread::GetBufferSize (void) const
+{
+  return m_bufferSize;
+}
+
+inline void
+TraceIoThread::GetBuffer (std::vector<char> &buffer)
+{
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    if (!m_spare.empty ())
+      {
+        buffer.swap (m_spare.back ());
+        m_spare.pop_back ();
+      }
+  }
+  buffer.clear ();
+  buffer.reserve (m_bufferSize);
+}
+
+inline void
+TraceIoThread::Submit (FILE *file, std::vector<char> &buffer, bool compress, bool close)
+{
+  std::unique_lock<std::mutex> lock (m_mutex);
+  while (m_jobs.size () >= m_maxPending)
+    {
+      m_done.wait (lock);
+    }
+  m_jobs.push_back (Job ());
+  Job &job = m_jobs.back ();
+  job.file = file;
+  job.data.swap (buffer);
+  job.compress = compress;
+  job.close = close;
+  m_work.notify_one ();
+}
+
+inline void
+TraceIoThread::Sync (void)
+{
+  std::unique_lock<std::mutex> lock (m_mutex);
+  while (!m_jobs.empty () || m_written != m_taken)
+    {
+      m_done.wait (lock);
+    }
+}
+
+inline void
+TraceIoThread::Close (void)
+{
+  if (m_threads.empty ())
+    {
+      return;
+    }
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_closing = true;
+    m_work.notify_all ();
+  }
+  for (std::vector<std::thread>::iterator t = m_threads.begin (); t != m_threads.end (); ++t)
+    {
+      t->join ();
+    }
+  m_threads.clear ();
+}
+
+#ifdef HAVE_ZLIB
+inline bool
+TraceIoThread::Compress (z_stream &z, const std::vector<char> &in, std::vector<char> &out)
+{
+  /* windowBits 15 + 16: a complete gzip member (header and trailer) */
+  if (deflateReset (&z) != Z_OK)
+    {
+      return false;
+    }
+  out.resize (deflateBound (&z, in.size ()));
+  z.next_in = reinterpret_cast<Bytef *> (const_cast<char *> (in.data ()));
+  z.avail_in = in.size ();
+  z.next_out = reinterpret_cast<Bytef *> (&out[0]);
+  z.avail_out = out.size ();
+  if (deflate (&z, Z_FINISH) != Z_STREAM_END)
+    {
+      return false;
+    }
+  out.resize (out.size () - z.avail_out);
+  return true;
+}
+#endif
+
+inline void
+TraceIoThread::Run (void)
+{
+#ifdef HAVE_ZLIB
+  z_stream z;
+  std::memset (&z, 0, sizeof (z));
+  bool zlib = deflateInit2 (&z, m_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+#endif
+  std::vector<char> compressed;
+
+  Job job;
+  std::unique_lock<std::mutex> lock (m_mutex);
+  while (true)
+    {
+      while (m_jobs.empty () && !m_closing)
+        {
+          m_work.wait (lock);
+        }
+      if (m_jobs.empty ())
+        {
+          break;
+        }
+      job.file = m_jobs.front ().file;
+      job.compress = m_jobs.front ().compress;
+      job.close = m_jobs.front ().close;
+      job.data.swap (m_jobs.front ().data);
+      m_jobs.pop_front ();
+      uint64_t ticket = m_taken++;
+      /* room in the queue: let a blocked Submit () go on */
+      m_done.notify_all ();
+      lock.unlock ();
+
+      const std::vector<char> *out = &job.data;
+#ifdef HAVE_ZLIB
+      if (job.compress && !job.data.empty ())
+        {
+          if (!zlib || !Compress (z, job.data, compressed))
+            {
+              std::fprintf (stderr, "TraceIoThread: compression failed, a trace file is corrupt\n");
+              compressed.clear ();
+            }
+          out = &compressed;
+        }
+#endif
+
+      /* write in submission order */
+      lock.lock ();
+      while (m_written != ticket)
+        {
+          m_done.wait (lock);
+        }
+      lock.unlock ();
+      if (!out->empty ())
+        {
+          std::fwrite (out->data (), 1, out->size (), job.file);
+        }
+      if (job.close)
+        {
+          std::fclose (job.file);
+        }
+      job.data.clear ();
+
+      lock.lock ();
+      m_written++;
+      m_spare.push_back (std::vector<char> ());
+      m_spare.back ().swap (job.data);
+      m_done.notify_all ();
+    }
+  lock.unlock ();
+#ifdef HAVE_ZLIB
+  if (zlib)
+    {
+      deflateEnd (&z);
+    }
+#endif
+}
+
+
+inline
+AsyncTraceFile::AsyncTraceFile ()
+  : m_io (0),
+    m_file (0),
+    m_compress (false),
+    m_offset (0)
+{
+}
+
+inline
+AsyncTraceFile::~AsyncTraceFile ()
+{
+  Close ();
+}
+
+inline bool
+AsyncTraceFile::Open (std::string filename, TraceIoThread *io)
+{
+  Close ();
+  bool compress = filename.size () > 3 && filename.compare (filename.size () - 3, 3, ".gz") == 0;
+#ifndef HAVE_ZLIB
+  if (compress)
+    {
+      std::fprintf (stderr, "AsyncTraceFile: %s needs zlib, build with -DHAVE_ZLIB and -lz\n", filename.c_str ());
+      return false;
+    }
+#endif
+  m_file = std::fopen (filename.c_str (), "wb");
+  if (m_file == 0)
+    {
+      return false;
+    }
+  m_io = io;
+  m_compress = compress;
+  m_offset = 0;
+  m_io->GetBuffer (m_buffer);
+  return true;
+}
+
+inline bool
+AsyncTraceFile::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline void
+AsyncTraceFile::Write (const void *data, size_t size)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  if (!m_buffer.empty () && m_buffer.size () + size > m_io->GetBufferSize ())
+    {
+      Flush ();
+    }
+  const char *bytes = static_cast<const char *> (data);
+  m_buffer.insert (m_buffer.end (), bytes, bytes + size);
+  m_offset += size;
+}
+
+inline void
+AsyncTraceFile::Flush (void)
+{
+  if (m_file == 0 || m_buffer.empty ())
+    {
+      return;
+    }
+  m_io->Submit (m_file, m_buffer, m_compress, false);
+  m_io->GetBuffer (m_buffer);
+}
+
+inline void
+AsyncTraceFile::Close (void)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  m_io->Submit (m_file, m_buffer, m_compress, true);
+  m_file = 0;
+}
+
+inline uint64_t
+AsyncTraceFile::GetOffset (void) const
+{
+  return m_offset;
+}
+
+#endif /* TRACE_IO_H */
@@ -0,0 +1,1146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+/*
+ * Streaming readers for the trace files, compressed or not: pcap, pcapng
+ * (as PcapngWriter writes it), the binary event log, the binary animation
+ * trace and text.
+ *
+ * Both go through zlib's gzread (), which decompresses on the fly and reads
+ * plain files as they are, so the same code reads "x.pcap" and
+ * "x.pcap.gz" (one gzip member per buffer, as TraceIoThread writes them)
+ * without ever decompressing a whole file to disk or to memory.
+ *
+ * This file does not depend on ns-3 but it needs zlib: link with -lz, and build
+ * with -DHAVE_ZLIB so that the writers it includes (trace-io.h) have it too.
+ */
+
+#include "anim-stream.h"
+#include "event-log.h"
+#include "pcap-index.h"
+
+#include <stdint.h>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+/**
+ * \brief One pcap record.
+ */
+struct PcapRecord
+{
+  uint64_t timeNs;                //!< timestamp, in nanoseconds
+  uint32_t capturedLength;        //!< bytes in data
+  uint32_t originalLength;        //!< length of the frame on the wire
+  std::vector<uint8_t> data;
+};
+
+/**
+ * \brief Reads a pcap file record by record.
+ *
+ * Both byte orders, microsecond and nanosecond timestamps.  When the file
+ * has a time index ("<file>.idx", see pcap-index.h), SeekTime () jumps
+ * straight to the interval instead of reading the file from the start.
+ */
+class PcapReader
+{
+public:
+  PcapReader ();
+  ~PcapReader ();
+
+  bool Open (std::string filename);
+  bool IsOpen (void) const;
+  uint32_t GetLinkType (void) const;
+  uint32_t GetSnapLen (void) const;
+  /// The next record; false at the end of the file (or on a truncated record).
+  bool Next (PcapRecord &record);
+  /**
+   * Make Next () return the records from timeNs on: through the index when
+   * there is one, from the start of the file otherwise.
+   */
+  bool SeekTime (uint64_t timeNs);
+  /// The entries of the time index, empty without one.
+  const std::vector<PcapIndexEntry> &GetIndex (void) const;
+  void Close (void);
+
+private:
+  PcapReader (const PcapReader &);
+  PcapReader &operator= (const PcapReader &);
+
+  bool Read (void *data, uint32_t size);
+  uint32_t Get32 (uint32_t value) const;
+  void ReadIndex (std::string filename);
+
+  gzFile m_file;
+  bool m_swapped;
+  bool m_nanoseconds;
+  uint32_t m_linkType;
+  uint32_t m_snapLen;
+  std::vector<PcapIndexEntry> m_index;
+  uint64_t m_skipBefore;          //!< Next () skips the records before it
+};
+
+/**
+ * \brief An interface of a pcapng file, from its Interface Description Block.
+ */
+struct PcapngInterface
+{
+  uint32_t linkType;
+  uint32_t snapLen;
+  std::string name;               //!< if_name, empty if none
+  uint64_t unitsPerSecond;        //!< from if_tsresol, 10^6 by default
+};
+
+/**
+ * \brief One Enhanced Packet Block of a pcapng file.
+ */
+struct PcapngRecord
+{
+  uint32_t interface;
+  uint64_t timeNs;
+  uint32_t capturedLength;
+  uint32_t originalLength;
+  std::vector<uint8_t> data;
+  bool hasPacketId;
+  uint64_t packetId;              //!< epb_packetid: the ns-3 packet uid
+  std::string comment;            //!< opt_comment, e.g. "node=3"
+};
+
+/**
+ * \brief Reads a pcapng file block by block.
+ *
+ * Only the sections in host byte order; Enhanced Packet Blocks are
+ * returned, the other blocks are skipped (the interfaces are kept).
+ */
+class PcapngReader
+{
+public:
+  PcapngReader ();
+  ~PcapngReader ();
+
+  bool Open (std::string filename);
+  bool IsOpen (void) const;
+  /// The interfaces described so far.
+  uint32_t GetNInterfaces (void) const;
+  const PcapngInterface &GetInterface (uint32_t interface) const;
+  /// The next packet; false at the end of the file (or on a bad block).
+  bool Next (PcapngRecord &record);
+  void Close (void);
+
+private:
+  PcapngReader (const PcapngReader &);
+  PcapngReader &operator= (const PcapngReader &);
+
+  /// Read one block: its type, and its body in m_block.
+  bool ReadBlock (uint32_t &type);
+  void ParseInterface (void);
+
+  gzFile m_file;
+  std::vector<uint8_t> m_block;
+  std::vector<PcapngInterface> m_interfaces;
+};
+
+/**
+ * \brief Reads a binary event log (event-log.h) record by record.
+ */
+class EventLogReader
+{
+public:
+  EventLogReader ();
+  ~EventLogReader ();
+
+  /// False when the file is not an event log of this version.
+  bool Open (std::string filename);
+  bool IsOpen (void) const;
+  /// The next record; false at the end of the file (or on a truncated record).
+  bool Next (EventLogRecord &record);
+  void Close (void);
+
+private:
+  EventLogReader (const EventLogReader &);
+  EventLogReader &operator= (const EventLogReader &);
+
+  gzFile m_file;
+};
+
+/**
+ * \brief Reads a binary animation trace (anim-stream.h) record by record.
+ *
+ * The string records are handled here: Next () only returns the others,
+ * with their strings resolved.
+ */
+class AnimStreamReader
+{
+public:
+  AnimStreamReader ();
+  ~AnimStreamReader ();
+
+  /// False when the file is not an animation trace of this version.
+  bool Open (std::string filename);
+  bool IsOpen (void) const;
+  /**
+   * The next record; false at the end of the file (or on a bad record).
+   * An ANIM_NODE_UPDATE comes as the records of its fields, one by one,
+   * and an ANIM_DESCRIPTIONS (ANIM_LINK_DESCRIPTIONS) as an
+   * ANIM_DESCRIPTION (ANIM_LINK_DESCRIPTION) per node (link).
+   */
+  bool Next (AnimRecord &record);
+  void Close (void);
+
+private:
+  AnimStreamReader (const AnimStreamReader &);
+  AnimStreamReader &operator= (const AnimStreamReader &);
+
+  bool GetVarint (uint64_t &value);
+  bool GetSigned (int64_t &value);
+  bool GetDouble (double &value);
+  bool GetString (std::string &value);
+  bool GetBytes (uint8_t *bytes, unsigned count);
+
+  /// Split an ANIM_NODE_UPDATE into the records of its fields, in m_split.
+  bool GetNodeUpdate (void);
+  /// Split an ANIM_DESCRIPTIONS or ANIM_LINK_DESCRIPTIONS into a record per target, in m_split.
+  bool GetDescriptions (uint8_t type);
+
+  gzFile m_file;
+  int64_t m_time;
+  std::vector<std::string> m_strings;   //!< m_strings[0] is ""
+  std::deque<AnimRecord> m_split;       //!< the records of a record with several, not yet returned
+};
+
+/**
+ * \brief Reads a text trace (e.g. the ascii .tr) line by line.
+ */
+class TraceLineReader
+{
+public:
+  TraceLineReader ();
+  ~TraceLineReader ();
+
+  bool Open (std::string filename);
+  bool IsOpen (void) const;
+  /// The next line, without its end of line; false at the end of the file.
+  bool Next (std::string &line);
+  void Close (void);
+
+private:
+  TraceLineReader (const TraceLineReader &);
+  TraceLineReader &operator= (const TraceLineReader &);
+
+  gzFile m_file;
+  char m_chunk[4096];
+};
+
+
+inline
+PcapReader::PcapReader ()
+  : m_file (0),
+    m_swapped (false),
+    m_nanoseconds (false),
+    m_linkType (0),
+    m_snapLen (0),
+    m_skipBefore (0)
+{
+}
+
+inline
+PcapReader::~PcapReader ()
+{
+  Close ();
+}
+
+inline bool
+PcapReader::Open (std::string filename)
+{
+  Close ();
+  m_file = gzopen (filename.c_str (), "rb");
+  if (m_file == 0)
+    {
+      return false;
+    }
+  gzbuffer (m_file, 256 * 1024);
+  uint32_t header[6];
+  if (!Read (header, sizeof (header)))
+    {
+      Close ();
+      return false;
+    }
+  switch (header[0])
+    {
+    case 0xa1b2c3d4: m_swapped = false; m_nanoseconds = false; break;
+    case 0xa1b23c4d: m_swapped = false; m_nanoseconds = true; break;
+    case 0xd4c3b2a1: m_swapped = true; m_nanoseconds = false; break;
+    case 0x4d3cb2a1: m_swapped = true; m_nanoseconds = true; break;
+    default:
+      Close ();
+      return false;
+    }
+  m_snapLen = Get32 (header[4]);
+  m_linkType = Get32 (header[5]);
+  ReadIndex (filename + ".idx");
+  return true;
+}
+
+inline void
+PcapReader::ReadIndex (std::string filename)
+{
+  m_index.clear ();
+  gzFile file = gzopen (filename.c_str (), "rb");
+  if (file == 0)
+    {
+      return;
+    }
+  PcapIndexHeader header;
+  if (gzread (file, &header, sizeof (header)) == sizeof (header)
+      && std::memcmp (header.magic, "NS3PIDX", 8) == 0
+      && header.version == PCAP_INDEX_VERSION && header.entrySize == sizeof (PcapIndexEntry))
+    {
+      PcapIndexEntry entry;
+      while (gzread (file, &entry, sizeof (entry)) == sizeof (entry))
+        {
+          m_index.push_back (entry);
+        }
+    }
+  gzclose (file);
+}
+
+inline const std::vector<PcapIndexEntry> &
+PcapReader::GetIndex (void) const
+{
+  return m_index;
+}
+
+inline bool
+PcapReader::SeekTime (uint64_t timeNs)
+{
+  if (m_file == 0)
+    {
+      return false;
+    }
+  /* the last entry at or before timeNs; the records before the first
+   * entry, if any, are at the start of the file */
+  uint64_t offset = 24;
+  std::vector<PcapIndexEntry>::const_iterator lo = m_index.begin (), hi = m_index.end ();
+  while (lo != hi)
+    {
+      std::vector<PcapIndexEntry>::const_iterator mid = lo + (hi - lo) / 2;
+      if (static_cast<uint64_t> (mid->timeNs) <= timeNs)
+        {
+          offset = mid->offset;
+          lo = mid + 1;
+        }
+      else
+        {
+          hi = mid;
+        }
+    }
+  m_skipBefore = timeNs;
+  return gzseek (m_file, offset, SEEK_SET) == static_cast<z_off_t> (offset);
+}
+
+inline bool
+PcapReader::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline uint32_t
+PcapReader::GetLinkType (void) const
+{
+  return m_linkType;
+}
+
+inline uint32_t
+PcapReader::GetSnapLen (void) const
+{
+  return m_snapLen;
+}
+
+inline bool
+PcapReader::Read (void *data, uint32_t size)
+{
+  return size == 0 || gzread (m_file, data, size) == static_cast<int> (size);
+}
+
+inline uint32_t
+PcapReader::Get32 (uint32_t value) const
+{
+  if (!m_swapped)
+    {
+      return value;
+    }
+  return (value >> 24) | ((value >> 8) & 0xff00) | ((value << 8) & 0xff0000) | (value << 24);
+}
+
+inline bool
+PcapReader::Next (PcapRecord &record)
+{
+  do
+    {
+      uint32_t header[4];
+      if (m_file == 0 || !Read (header, sizeof (header)))
+        {
+          return false;
+        }
+      uint64_t seconds = Get32 (header[0]);
+      uint64_t fraction = Get32 (header[1]);
+      record.timeNs = seconds * 1000000000 + (m_nanoseconds ? fraction : fraction * 1000);
+      record.capturedLength = Get32 (header[2]);
+      record.originalLength = Get32 (header[3]);
+      record.data.resize (record.capturedLength);
+      if (!Read (record.data.data (), record.capturedLength))
+        {
+          return false;
+        }
+    }
+  while (record.timeNs < m_skipBefore);
+  m_skipBefore = 0;
+  return true;
+}
+
+inline void
+PcapReader::Close (void)
+{
+  if (m_file != 0)
+    {
+      gzclose (m_file);
+      m_file = 0;
+    }
+  m_index.clear ();
+  m_skipBefore = 0;
+}
+
+
+inline
+PcapngReader::PcapngReader ()
+  : m_file (0)
+{
+}
+
+inline
+PcapngReader::~PcapngReader ()
+{
+  Close ();
+}
+
+inline bool
+PcapngReader::Open (std::string filename)
+{
+  Close ();
+  m_file = gzopen (filename.c_str (), "rb");
+  if (m_file == 0)
+    {
+      return false;
+    }
+  gzbuffer (m_file, 256 * 1024);
+  uint32_t type;
+  if (!ReadBlock (type) || type != 0x0a0d0d0a)
+    {
+      Close ();
+      return false;
+    }
+  return true;
+}
+
+inline bool
+PcapngReader::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline uint32_t
+PcapngReader::GetNInterfaces (void) const
+{
+  return m_interfaces.size ();
+}
+
+inline const PcapngInterface &
+PcapngReader::GetInterface (uint32_t interface) const
+{
+  return m_interfaces[interface];
+}
+
+inline bool
+PcapngReader::ReadBlock (uint32_t &type)
+{
+  uint32_t header[2];
+  if (gzread (m_file, header, sizeof (header)) != sizeof (header) || header[1] < 12 || header[1] % 4 != 0)
+    {
+      return false;
+    }
+  type = header[0];
+  m_block.resize (header[1] - 8);
+  if (gzread (m_file, m_block.data (), m_block.size ()) != static_cast<int> (m_block.size ()))
+    {
+      return false;
+    }
+  m_block.resize (m_block.size () - 4);       // the trailing length
+  if (type == 0x0a0d0d0a)
+    {
+      uint32_t magic;
+      if (m_block.size () < 4)
+        {
+          return false;
+        }
+      std::memcpy (&magic, m_block.data (), 4);
+      if (magic != 0x1a2b3c4d)
+        {
+          return false;         // other byte order
+        }
+      m_interfaces.clear ();
+    }
+  return true;
+}
+
+inline void
+PcapngReader::ParseInterface (void)
+{
+  PcapngInterface i;
+  uint16_t link;
+  std::memcpy (&link, m_block.data (), 2);
+  std::memcpy (&i.snapLen, m_block.data () + 4, 4);
+  i.linkType = link;
+  i.unitsPerSecond = 1000000;
+  for (uint32_t offset = 8; offset + 4 <= m_block.size (); )
+    {
+      uint16_t code, length;
+      std::memcpy (&code, &m_block[offset], 2);
+      std::memcpy (&length, &m_block[offset + 2], 2);
+      offset += 4;
+      if (code == 0 || offset + length > m_block.size ())
+        {
+          break;
+        }
+      if (code == 2)
+        {
+          i.name.assign (reinterpret_cast<const char *> (&m_block[offset]), length);
+        }
+      else if (code == 9 && length >= 1)
+        {
+          uint8_t resolution = m_block[offset];
+          uint64_t base = (resolution & 0x80) ? 2 : 10;
+          i.unitsPerSecond = 1;
+          for (uint8_t k = 0; k < (resolution & 0x7f); k++)
+            {
+              i.unitsPerSecond *= base;
+            }
+        }
+      offset += (length + 3) / 4 * 4;
+    }
+  m_interfaces.push_back (i);
+}
+
+inline bool
+PcapngReader::Next (PcapngRecord &record)
+{
+  uint32_t type;
+  while (m_file != 0 && ReadBlock (type))
+    {
+      if (type == 1 && m_block.size () >= 8)
+        {
+          ParseInterface ();
+          continue;
+        }
+      if (type != 6 || m_block.size () < 20)
+        {
+          continue;
+        }
+      uint32_t fields[5];
+      std::memcpy (fields, m_block.data (), sizeof (fields));
+      if (fields[0] >= m_interfaces.size () || 20 + uint64_t (fields[3]) > m_block.size ())
+        {
+          return false;
+        }
+      record.interface = fields[0];
+      uint64_t units = (uint64_t (fields[1]) << 32) | fields[2];
+      uint64_t perSecond = m_interfaces[fields[0]].unitsPerSecond;
+      record.timeNs = units / perSecond * 1000000000 + units % perSecond * 1000000000 / perSecond;
+      record.capturedLength = fields[3];
+      record.originalLength = fields[4];
+      record.data.assign (m_block.begin () + 20, m_block.begin () + 20 + fields[3]);
+      record.hasPacketId = false;
+      record.packetId = 0;
+      record.comment.clear ();
+      for (uint32_t offset = 20 + (fields[3] + 3) / 4 * 4; offset + 4 <= m_block.size (); )
+        {
+          uint16_t code, length;
+          std::memcpy (&code, &m_block[offset], 2);
+          std::memcpy (&length, &m_block[offset + 2], 2);
+          offset += 4;
+          if (code == 0 || offset + length > m_block.size ())
+            {
+              break;
+            }
+          if (code == 5 && length == 8)
+            {
+              record.hasPacketId = true;
+              std::memcpy (&record.packetId, &m_block[offset], 8);
+            }
+          else if (code == 1)
+            {
+              record.comment.assign (reinterpret_cast<const char *> (&m_block[offset]), length);
+            }
+          offset += (length + 3) / 4 * 4;
+        }
+      return true;
+    }
+  return false;
+}
+
+inline void
+PcapngReader::Close (void)
+{
+  if (m_file != 0)
+    {
+      gzclose (m_file);
+      m_file = 0;
+    }
+  m_interfaces.clear ();
+}
+
+
+inline
+EventLogReader::EventLogReader ()
+  : m_file (0)
+{
+}
+
+inline
+EventLogReader::~EventLogReader ()
+{
+  Close ();
+}
+
+inline bool
+EventLogReader::Open (std::string filename)
+{
+  Close ();
+  m_file = gzopen (filename.c_str (), "rb");
+  if (m_file == 0)
+    {
+      return false;
+    }
+  gzbuffer (m_file, 256 * 1024);
+  EventLogHeader header;
+  if (gzread (m_file, &header, sizeof (header)) != sizeof (header)
+      || std::memcmp (header.magic, "NS3EVLOG", 8) != 0
+      || header.version != EVENT_LOG_VERSION || header.recordSize != sizeof (EventLogRecord))
+    {
+      Close ();
+      return false;
+    }
+  return true;
+}
+
+inline bool
+EventLogReader::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline bool
+EventLogReader::Next (EventLogRecord &record)
+{
+  return m_file != 0 && gzread (m_file, &record, sizeof (record)) == sizeof (record);
+}
+
+inline void
+EventLogReader::Close (void)
+{
+  if (m_file != 0)
+    {
+      gzclose (m_file);
+      m_file = 0;
+    }
+}
+
+
+inline
+AnimStreamReader::AnimStreamReader ()
+  : m_file (0),
+    m_time (0)
+{
+}
+
+inline
+AnimStreamReader::~AnimStreamReader ()
+{
+  Close ();
+}
+
+inline bool
+AnimStreamReader::Open (std::string filename)
+{
+  Close ();
+  m_file = gzopen (filename.c_str (), "rb");
+  if (m_file == 0)
+    {
+      return false;
+    }
+  gzbuffer (m_file, 256 * 1024);
+  AnimStreamHeader header;
+  if (gzread (m_file, &header, sizeof (header)) != sizeof (header)
+      || std::memcmp (header.magic, "NS3ANIM", 8) != 0
+      || header.version != ANIM_STREAM_VERSION)
+    {
+      Close ();
+      return false;
+    }
+  m_time = 0;
+  m_strings.assign (1, std::string ());
+  return true;
+}
+
+inline bool
+AnimStreamReader::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline bool
+AnimStreamReader::GetVarint (uint64_t &value)
+{
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+    {
+      int c = gzgetc (m_file);
+      if (c < 0)
+        {
+          return false;
+        }
+      value |= uint64_t (c & 0x7f) << shift;
+      if ((c & 0x80) == 0)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+inline bool
+AnimStreamReader::GetSigned (int64_t &value)
+{
+  uint64_t zigzag;
+  if (!GetVarint (zigzag))
+    {
+      return false;
+    }
+  value = AnimUnzigzag (zigzag);
+  return true;
+}
+
+inline bool
+AnimStreamReader::GetDouble (double &value)
+{
+  return gzread (m_file, &value, sizeof (double)) == sizeof (double);
+}
+
+inline bool
+AnimStreamReader::GetString (std::string &value)
+{
+  uint64_t id;
+  if (!GetVarint (id) || id >= m_strings.size ())
+    {
+      return false;
+    }
+  value = m_strings[id];
+  return true;
+}
+
+inline bool
+AnimStreamReader::GetBytes (uint8_t *bytes, unsigned count)
+{
+  return gzread (m_file, bytes, count) == int (count);
+}
+
+inline bool
+AnimStreamReader::Next (AnimRecord &record)
+{
+  if (m_file == 0)
+    {
+      return false;
+    }
+  uint64_t a, b;
+  int64_t delta;
+  while (true)
+    {
+      if (!m_split.empty ())
+        {
+          record = m_split.front ();
+          m_split.pop_front ();
+          return true;
+        }
+      int type = gzgetc (m_file);
+      if (type < 0)
+        {
+          return false;
+        }
+      if (type == ANIM_STRING)
+        {
+          if (!GetVarint (a) || a > (1u << 30))
+            {
+              return false;
+            }
+          std::string s (a, '\0');
+          if (a > 0 && gzread (m_file, &s[0], a) != int (a))
+            {
+              return false;
+            }
+          m_strings.push_back (s);
+          continue;
+        }
+      if (type == ANIM_STRING_RESET)
+        {
+          m_strings.resize (1);
+          continue;
+        }
+      record.type = type;
+      if (type >= ANIM_POSITION)
+        {
+          if (!GetSigned (delta))
+            {
+              return false;
+            }
+          m_time += delta;
+        }
+      record.timeNs = m_time;
+      switch (type)
+        {
+        case ANIM_NODE:
+          if (!GetVarint (a) || !GetVarint (b) || !GetDouble (record.x) || !GetDouble (record.y))
+            {
+              return false;
+            }
+          record.id = a;
+          record.to = b;
+          return true;
+        case ANIM_LINK:
+          if (!GetVarint (a) || !GetVarint (b)
+              || !GetString (record.text) || !GetString (record.text2) || !GetString (record.text3))
+            {
+              return false;
+            }
+          record.id = a;
+          record.to = b;
+          return true;
+        case ANIM_NONP2P_LINK:
+          if (!GetVarint (a) || !GetString (record.text) || !GetString (record.text2))
+            {
+              return false;
+            }
+          record.id = a;
+          return true;
+        case ANIM_RESOURCE:
+          if (!GetVarint (a) || !GetString (record.text))
+            {
+              return false;
+            }
+          record.id = a;
+          return true;
+        case ANIM_COUNTER:
+          if (!GetVarint (a) || !GetString (record.text) || !GetBytes (&record.counterType, 1))
+            {
+              return false;
+            }
+          record.id = a;
+          return true;
+        case ANIM_POSITION:
+        case ANIM_SIZE:
+          if (!GetVarint (a) || !GetDouble (record.x) || !GetDouble (record.y))
+            {
+              return false;
+            }
+          record.id = a;
+          return true;
+        case ANIM_MOTION:
+          if (!GetVarint (a) || !GetDouble (record.x) || !GetDouble (record.y)
+              || !GetDouble (record.vx) || !GetDouble (record.vy))
+            {
+              return false;
+            }
+          record.id = a;
+          return true;
+        case ANIM_COLOR:
+          {
+            uint8_t rgb[3];
+            if (!GetVarint (a) || !GetBytes (rgb, 3))
+              {
+                return false;
+              }
+            record.id = a;
+            record.r = rgb[0];
+            record.g = rgb[1];
+            record.b = rgb[2];
+            return true;
+          }
+        case ANIM_DESCRIPTION:
+          if (!GetVarint (a) || !GetString (record.text))
+            {
+              return false;
+            }
+          record.id = a;
+          return true;
+        case ANIM_IMAGE:
+          if (!GetVarint (a) || !GetVarint (b))
+            {
+              return false;
+            }
+          record.id = a;
+          record.to = b;
+          return true;
+        case ANIM_COUNTER_VALUE:
+          if (!GetVarint (a) || !GetVarint (b) || !GetDouble (record.x))
+            {
+              return false;
+            }
+          record.id = a;
+          record.to = b;
+          return true;
+        case ANIM_LINK_DESCRIPTION:
+          if (!GetVarint (a) || !GetVarint (b) || !GetString (record.text))
+            {
+              return false;
+            }
+          record.id = a;
+          record.to = b;
+          return true;
+        case ANIM_PACKET:
+          if (!GetVarint (a) || !GetVarint (b) || !GetSigned (record.fbTx) || !GetSigned (record.lbTx)
+              || !GetSigned (record.fbRx) || !GetSigned (record.lbRx) || !GetString (record.text))
+            {
+              return false;
+            }
+          record.id = a;
+          record.to = b;
+          record.fbTx += m_time;
+          record.lbTx += m_time;
+          record.fbRx += m_time;
+          record.lbRx += m_time;
+          return true;
+        case ANIM_WIFI_TX:
+          if (!GetVarint (record.uid) || !GetVarint (a) || !GetSigned (record.fbTx) || !GetString (record.text))
+            {
+              return false;
+            }
+          record.id = a;
+          record.fbTx += m_time;
+          return true;
+        case ANIM_WIFI_RX:
+          if (!GetVarint (record.uid) || !GetVarint (b) || !GetSigned (record.fbRx))
+            {
+              return false;
+            }
+          record.to = b;
+          record.fbRx += m_time;
+          return true;
+        case ANIM_NODE_UPDATE:
+          if (!GetNodeUpdate ())
+            {
+              return false;
+            }
+          continue;
+        case ANIM_DESCRIPTIONS:
+        case ANIM_LINK_DESCRIPTIONS:
+          if (!GetDescriptions (type))
+            {
+              return false;
+            }
+          continue;
+        default:
+          return false;
+        }
+    }
+}
+
+inline bool
+AnimStreamReader::GetNodeUpdate (void)
+{
+  uint64_t node, count, id;
+  uint8_t fields;
+  if (!GetVarint (node) || !GetBytes (&fields, 1))
+    {
+      return false;
+    }
+  AnimRecord r;
+  r.timeNs = m_time;
+  r.id = node;
+  if (fields & ANIM_FIELD_COLOR)
+    {
+      uint8_t rgb[3];
+      if (!GetBytes (rgb, 3))
+        {
+          return false;
+        }
+      r.type = ANIM_COLOR;
+      r.r = rgb[0];
+      r.g = rgb[1];
+      r.b = rgb[2];
+      m_split.push_back (r);
+    }
+  if (fields & ANIM_FIELD_SIZE)
+    {
+      r.type = ANIM_SIZE;
+      if (!GetDouble (r.x) || !GetDouble (r.y))
+        {
+          return false;
+        }
+      m_split.push_back (r);
+    }
+  if (fields & ANIM_FIELD_DESCRIPTION)
+    {
+      r.type = ANIM_DESCRIPTION;
+      if (!GetString (r.text))
+        {
+          return false;
+        }
+      m_split.push_back (r);
+    }
+  if (fields & ANIM_FIELD_IMAGE)
+    {
+      r.type = ANIM_IMAGE;
+      if (!GetVarint (id))
+        {
+          return false;
+        }
+      r.to = id;
+      m_split.push_back (r);
+    }
+  if (fields & ANIM_FIELD_COUNTERS)
+    {
+      if (!GetVarint (count))
+        {
+          return false;
+        }
+      r.type = ANIM_COUNTER_VALUE;
+      r.to = node;
+      for (uint64_t i = 0; i < count; i++)
+        {
+          if (!GetVarint (id) || !GetDouble (r.x))
+            {
+              return false;
+            }
+          r.id = id;
+          m_split.push_back (r);
+        }
+    }
+  return true;
+}
+
+inline bool
+AnimStreamReader::GetDescriptions (uint8_t type)
+{
+  AnimRecord r;
+  uint64_t count, from, to = 0;
+  if (!GetString (r.text) || !GetVarint (count))
+    {
+      return false;
+    }
+  r.type = type == ANIM_DESCRIPTIONS ? ANIM_DESCRIPTION : ANIM_LINK_DESCRIPTION;
+  r.timeNs = m_time;
+  for (uint64_t i = 0; i < count; i++)
+    {
+      if (!GetVarint (from) || (type == ANIM_LINK_DESCRIPTIONS && !GetVarint (to)))
+        {
+          return false;
+        }
+      r.id = from;
+      r.to = type == ANIM_LINK_DESCRIPTIONS ? to : 0;
+      m_split.push_back (r);
+    }
+  return true;
+}
+
+inline void
+AnimStreamReader::Close (void)
+{
+  if (m_file != 0)
+    {
+      gzclose (m_file);
+      m_file = 0;
+    }
+  m_strings.clear ();
+  m_split.clear ();
+}
+
+
+inline
+TraceLineReader::TraceLineReader ()
+  : m_file (0)
+{
+}
+
+inline
+TraceLineReader::~TraceLineReader ()
+{
+  Close ();
+}
+
+inline bool
+TraceLineReader::Open (std::string filename)
+{
+  Close ();
+  m_file = gzopen (filename.c_str (), "rb");
+  if (m_file != 0)
+    {
+      gzbuffer (m_file, 256 * 1024);
+    }
+  return m_file != 0;
+}
+
+inline bool
+TraceLineReader::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline bool
+TraceLineReader::Next (std::string &line)
+{
+  line.clear ();
+  if (m_file == 0)
+    {
+      return false;
+    }
+  /* a line longer than the chunk comes in several gzgets () */
+  while (gzgets (m_file, m_chunk, sizeof (m_chunk)) != 0)
+    {
+      size_t n = std::strlen (m_chunk);
+      if (n > 0 && m_chunk[n - 1] == '\n')
+        {
+          line.append (m_chunk, n - 1);
+          return true;
+        }
+      line.append (m_chunk, n);
+    }
+  return !line.empty ();
+}
+
+inline void
+TraceLineReader::Close (void)
+{
+  if (m_file != 0)
+    {
+      gzclose (m_file);
+      m_file = 0;
+    }
+}
+
+#endif /* TRACE_READER_H */